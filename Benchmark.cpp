@@ -4,6 +4,7 @@
 #include <omp.h>
 
 #include <MaQrel/QuantumCircuitParallel.h>
+#include <MaQrel/QuantumThreadPool.h>
 #include <MaQrel/QuantumCircuitMPI.h>
 
 using namespace std;
@@ -74,7 +75,10 @@ int main() {
 
     // ---PARALLEL VERSION ---
     cout << "\n--- Running Parallel Benchmark (" << num_threads << " threads) ---\n";
-    QuantumCircuitParallel qc_parallel(num_qubits);
+    QuantumThreadPool::Options pool_options;
+    pool_options.threads = num_threads;
+    QuantumThreadPool pool(pool_options);
+    QuantumCircuitParallel qc_parallel(num_qubits, pool);
     omp_set_num_threads(num_threads);
     
     double start_parallel = omp_get_wtime();
@@ -82,6 +86,7 @@ int main() {
     for (const auto& op : random_circuit) {
         apply_gate_op(qc_parallel, op);
     }
+    qc_parallel.flush();
     
     double end_parallel = omp_get_wtime();
     double parallel_time = end_parallel - start_parallel;
@@ -0,0 +1,438 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <ctime>
+#include <cmath>
+#include <omp.h>
+
+#include <MaQrel/QuantumCircuitParallel.h>
+#include <MaQrel/QuantumCircuitSparse.h>
+#include <MaQrel/QuantumCircuitSoA.h>
+#include <MaQrel/QuantumCircuitMPS.h>
+#include <MaQrel/QuantumProgram.h>
+#include <MaQrel/QuantumThreadPool.h>
+
+using namespace std;
+
+// Non-interactive benchmark sweep. Every option has a default, e.g.
+//   ./bin/Quantum_BenchmarkSuite --qubits 12:24:4 --threads 1,2,4 --json results.json --csv results.csv
+// Interleaved against split real/imaginary layout on every target qubit:
+//   ./bin/Quantum_BenchmarkSuite --backends serial,soa --suites kernels --positions all
+
+struct Options {
+    vector<int> qubits = {10, 14, 18, 22};
+    vector<int> threads = {1, omp_get_max_threads()};
+    vector<string> backends = {"serial", "parallel"};
+    vector<string> suites = {"kernels", "circuits"};
+    vector<string> positions = {"low", "high"}; // target qubits of the kernels
+    int warmup = 1;
+    int reps = 5;
+    int kernel_gates = 20; // applications of a gate per timed kernel run
+    int depth = 10;        // layers of the random circuit
+    unsigned seed = 1234;
+    string json_path;
+    string csv_path;
+};
+
+struct Record {
+    string suite;
+    string name;
+    string backend;
+    string position; // low / high / target qubit for kernels, - for circuits
+    int qubits;
+    int threads;
+    size_t gates;
+    int reps;
+    double time_min;
+    double time_median;
+    double time_mean;
+    double gates_per_sec;
+    double gb_per_sec; // NaN for backends without a dense state vector
+};
+
+// "10,14,18" or "start:stop:step"
+vector<int> parseIntList(const string &text) {
+    vector<int> values;
+    if (text.find(':') != string::npos) {
+        int start, stop, step = 1;
+        char sep;
+        stringstream in(text);
+        if (!(in >> start >> sep >> stop)) throw invalid_argument("Bad range " + text);
+        if (in >> sep && !(in >> step)) throw invalid_argument("Bad range " + text);
+        for (int v = start; v <= stop; v += max(step, 1)) values.push_back(v);
+        return values;
+    }
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) values.push_back(stoi(item));
+    return values;
+}
+
+vector<string> parseList(const string &text) {
+    vector<string> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) values.push_back(item);
+    return values;
+}
+
+void printUsage() {
+    cout << "Usage: Quantum_BenchmarkSuite [options]\n"
+         << "  --qubits LIST      qubit counts, e.g. 10,14,18 or 10:24:2\n"
+         << "  --threads LIST     thread counts for the parallel backend\n"
+         << "  --backends LIST    serial,parallel,soa,sparse,mps\n"
+         << "  --suites LIST      kernels,circuits\n"
+         << "  --positions LIST   kernel targets: low, high, qubit indices or all (default low,high)\n"
+         << "  --warmup N         untimed runs before measuring (default 1)\n"
+         << "  --reps N           timed repetitions (default 5)\n"
+         << "  --kernel-gates N   gate applications per kernel run (default 20)\n"
+         << "  --depth N          layers of the random circuit (default 10)\n"
+         << "  --seed N           seed for the random circuits\n"
+         << "  --json PATH        write the results as JSON\n"
+         << "  --csv PATH         write the results as CSV\n";
+}
+
+// low, high, all or a qubit index
+bool validPosition(const string &position) {
+    if (position == "low" || position == "high" || position == "all") return true;
+    return !position.empty() && all_of(position.begin(), position.end(), [](char c) { return isdigit((unsigned char)c); });
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--help" || arg == "-h") return false;
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        string value = argv[++i];
+        try {
+            if (arg == "--qubits") options.qubits = parseIntList(value);
+            else if (arg == "--threads") options.threads = parseIntList(value);
+            else if (arg == "--backends") options.backends = parseList(value);
+            else if (arg == "--suites") options.suites = parseList(value);
+            else if (arg == "--positions") {
+                options.positions = parseList(value);
+                for (const string &position : options.positions) {
+                    if (!validPosition(position)) throw invalid_argument("Bad position " + position);
+                }
+            }
+            else if (arg == "--warmup") options.warmup = stoi(value);
+            else if (arg == "--reps") options.reps = max(1, stoi(value));
+            else if (arg == "--kernel-gates") options.kernel_gates = max(1, stoi(value));
+            else if (arg == "--depth") options.depth = max(1, stoi(value));
+            else if (arg == "--seed") options.seed = stoul(value);
+            else if (arg == "--json") options.json_path = value;
+            else if (arg == "--csv") options.csv_path = value;
+            else {
+                cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        } catch (const exception &) {
+            // stoi and stoul throw invalid_argument or out_of_range
+            cerr << "Invalid value " << value << " for " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// one persistent pool per thread count, the shared pool cannot be resized
+QuantumThreadPool &poolFor(int threads) {
+    static map<int, unique_ptr<QuantumThreadPool>> pools;
+    auto &pool = pools[threads];
+    if (!pool) {
+        QuantumThreadPool::Options options;
+        options.threads = threads;
+        pool = make_unique<QuantumThreadPool>(options);
+    }
+    return *pool;
+}
+
+unique_ptr<QuantumCircuitBase> makeCircuit(const string &backend, int qubits, int threads) {
+    unique_ptr<QuantumCircuitBase> qc;
+    if (backend == "serial") qc = make_unique<QuantumCircuitBase>(qubits);
+    else if (backend == "parallel") qc = make_unique<QuantumCircuitParallel>(qubits, poolFor(threads));
+    else if (backend == "soa") qc = make_unique<QuantumCircuitSoA>(qubits);
+    else if (backend == "sparse") qc = make_unique<QuantumCircuitSparse>(qubits);
+    else if (backend == "mps") qc = make_unique<QuantumCircuitMPS>(qubits);
+    else throw invalid_argument("Unknown backend " + backend);
+    qc->setDiagramEnabled(false); // the diagram strings would dominate the timings
+    return qc;
+}
+
+// ---Circuit families---
+
+QuantumProgram ghzProgram(int n) {
+    QuantumProgram program(n);
+    program.H(0);
+    for (int i = 1; i < n; i++) program.CX(i - 1, i);
+    return program;
+}
+
+QuantumProgram qftProgram(int n) {
+    QuantumProgram program(n);
+    for (int i = n - 1; i >= 0; i--) {
+        program.H(i);
+        for (int j = i - 1; j >= 0; j--) program.CP(j, i, M_PI / (1 << min(i - j, 30)));
+    }
+    for (int i = 0; i < n / 2; i++) program.SWAP(i, n - 1 - i);
+    return program;
+}
+
+// layers of random single-qubit rotations followed by CX on a random pairing
+QuantumProgram randomProgram(int n, int depth, unsigned seed) {
+    QuantumProgram program(n);
+    mt19937 gen(seed);
+    uniform_real_distribution<double> angle(0.0, 2 * M_PI);
+    vector<int> order(n);
+    iota(order.begin(), order.end(), 0);
+    for (int layer = 0; layer < depth; layer++) {
+        for (int q = 0; q < n; q++) {
+            switch (gen() % 3) {
+                case 0: program.Rx(q, angle(gen)); break;
+                case 1: program.Ry(q, angle(gen)); break;
+                case 2: program.Rz(q, angle(gen)); break;
+            }
+        }
+        shuffle(order.begin(), order.end(), gen);
+        for (int q = 0; q + 1 < n; q += 2) program.CX(order[q], order[q + 1]);
+    }
+    return program;
+}
+
+// the encoder + controlled rotation block of examples/SSM.cpp, chained over all qubits
+QuantumProgram ssmProgram(int n, unsigned seed) {
+    QuantumProgram program(n);
+    mt19937 gen(seed);
+    uniform_real_distribution<double> angle(0.0, 2 * M_PI);
+    for (int q = 0; q < n; q++) {
+        program.H(q);
+        program.Rx(q, angle(gen));
+    }
+    for (int q = 0; q + 1 < n; q++) {
+        program.CRx(q, q + 1, angle(gen));
+        program.CRy(q, q + 1, angle(gen));
+        program.CRz(q, q + 1, angle(gen));
+        program.CRx(q + 1, q, angle(gen));
+        program.CRy(q + 1, q, angle(gen));
+        program.CRz(q + 1, q, angle(gen));
+    }
+    return program;
+}
+
+// ---Timing---
+
+template <class F>
+vector<double> timeRuns(const Options &options, F run) {
+    for (int i = 0; i < options.warmup; i++) run();
+    vector<double> times;
+    for (int i = 0; i < options.reps; i++) {
+        double start = omp_get_wtime();
+        run();
+        times.push_back(omp_get_wtime() - start);
+    }
+    return times;
+}
+
+bool denseBackend(const string &backend) {
+    return backend == "serial" || backend == "parallel" || backend == "soa";
+}
+
+Record makeRecord(const string &suite, const string &name, const string &backend, const string &position,
+                  int qubits, int threads, size_t gates, vector<double> times) {
+    sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    double mean = accumulate(times.begin(), times.end(), 0.0) / times.size();
+    // every gate reads and writes the whole state vector once, which only holds for the dense
+    // backends; the sparse and MPS storage depends on the state, so no bandwidth is reported
+    double gb_per_sec = NAN;
+    if (denseBackend(backend)) gb_per_sec = 2.0 * sizeof(complex<double>) * pow(2.0, qubits) * gates / median / 1e9;
+    return Record{suite, name, backend, position, qubits, threads, gates, (int)times.size(),
+                  times.front(), median, mean, gates / median, gb_per_sec};
+}
+
+void printRecord(const Record &r) {
+    cout << left << setw(9) << r.suite << setw(10) << r.name << setw(10) << r.backend << setw(6) << r.position
+         << right << setw(4) << r.qubits << setw(4) << r.threads << setw(8) << r.gates
+         << fixed << setprecision(6) << setw(12) << r.time_median
+         << setprecision(1) << setw(14) << r.gates_per_sec << setprecision(2) << setw(9);
+    if (isnan(r.gb_per_sec)) cout << "N/A" << "\n";
+    else cout << r.gb_per_sec << "\n";
+}
+
+// (label, target qubit) of every position, "all" expands to every qubit
+vector<pair<string, int>> kernelTargets(const Options &options, int qubits) {
+    vector<pair<string, int>> targets;
+    for (const string &position : options.positions) {
+        if (position == "low") targets.push_back({"low", 0});
+        else if (position == "high") targets.push_back({"high", qubits - 1});
+        else if (position == "all") {
+            for (int q = 0; q < qubits; q++) targets.push_back({"q" + to_string(q), q});
+        } else {
+            int q = stoi(position);
+            if (q < 0 || q >= qubits) throw out_of_range("Position " + position + " is not a qubit of the register.");
+            targets.push_back({"q" + position, q});
+        }
+    }
+    return targets;
+}
+
+vector<Record> kernelSuite(const Options &options, const string &backend, int qubits, int threads) {
+    vector<Record> records;
+    auto qc = makeCircuit(backend, qubits, threads);
+    // a superposition so no amplitude is trivially zero
+    for (int q = 0; q < qubits; q++) qc->H(q);
+
+    vector<GateOp> gates = {
+        {GateKind::H, 0}, {GateKind::X, 0}, {GateKind::Z, 0}, {GateKind::T, 0}, {GateKind::Rx, 0, -1, 0.3},
+        {GateKind::CX, 0, 1}, {GateKind::CZ, 0, 1}, {GateKind::CRy, 0, 1, 0.3}, {GateKind::SWAP, 0, 1}
+    };
+    for (const GateOp &gate : gates) {
+        bool two_qubit = QuantumGateInfo::arity(gate.kind) == 2;
+        if (two_qubit && qubits < 2) continue;
+        for (const auto &[position, target] : kernelTargets(options, qubits)) {
+            // two-qubit gates act on target and its neighbour below, the one above for qubit 0
+            GateOp op = gate;
+            op.qubit_1 = two_qubit ? (target == 0 ? 1 : target - 1) : target;
+            op.qubit_2 = two_qubit ? target : -1;
+            auto times = timeRuns(options, [&]() {
+                for (int k = 0; k < options.kernel_gates; k++) QuantumGateInfo::apply(*qc, op);
+                qc->flush(); // queued gates count too
+            });
+            records.push_back(makeRecord("kernel", QuantumGateInfo::name(op.kind), backend, position,
+                                         qubits, threads, options.kernel_gates, times));
+            printRecord(records.back());
+        }
+    }
+    return records;
+}
+
+vector<Record> circuitSuite(const Options &options, const string &backend, int qubits, int threads) {
+    vector<Record> records;
+    vector<pair<string, QuantumProgram>> families = {
+        {"ghz", ghzProgram(qubits)},
+        {"qft", qftProgram(qubits)},
+        {"random", randomProgram(qubits, options.depth, options.seed)},
+        {"ssm", ssmProgram(qubits, options.seed)}
+    };
+    auto qc = makeCircuit(backend, qubits, threads);
+    for (auto &family : families) {
+        const QuantumProgram &program = family.second;
+        auto times = timeRuns(options, [&]() {
+            qc->resetAll(0);
+            program.applyTo(*qc);
+            qc->flush();
+            if (family.first == "ssm") qc->expectZ({qubits - 1});
+        });
+        records.push_back(makeRecord("circuit", family.first, backend, "-", qubits, threads, program.size(), times));
+        printRecord(records.back());
+    }
+    return records;
+}
+
+// ---Output---
+
+string timestamp() {
+    time_t now = time(nullptr);
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    return buffer;
+}
+
+void writeJson(const string &path, const Options &options, const vector<Record> &records) {
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "Could not open " << path << "\n";
+        return;
+    }
+    out << setprecision(9);
+    out << "{\n";
+    out << "  \"timestamp\": \"" << timestamp() << "\",\n";
+    out << "  \"max_threads\": " << omp_get_max_threads() << ",\n";
+    out << "  \"warmup\": " << options.warmup << ",\n";
+    out << "  \"reps\": " << options.reps << ",\n";
+    out << "  \"seed\": " << options.seed << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < records.size(); i++) {
+        const Record &r = records[i];
+        out << "    {\"suite\": \"" << r.suite << "\", \"name\": \"" << r.name << "\", \"backend\": \"" << r.backend
+            << "\", \"position\": \"" << r.position << "\", \"qubits\": " << r.qubits << ", \"threads\": " << r.threads
+            << ", \"gates\": " << r.gates << ", \"reps\": " << r.reps
+            << ", \"time_min\": " << r.time_min << ", \"time_median\": " << r.time_median << ", \"time_mean\": " << r.time_mean
+            << ", \"gates_per_sec\": " << r.gates_per_sec << ", \"gb_per_sec\": ";
+        if (isnan(r.gb_per_sec)) out << "null";
+        else out << r.gb_per_sec;
+        out << "}" << (i + 1 < records.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+void writeCsv(const string &path, const vector<Record> &records) {
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "Could not open " << path << "\n";
+        return;
+    }
+    out << setprecision(9);
+    out << "suite,name,backend,position,qubits,threads,gates,reps,time_min,time_median,time_mean,gates_per_sec,gb_per_sec\n";
+    for (const Record &r : records) {
+        out << r.suite << ',' << r.name << ',' << r.backend << ',' << r.position << ',' << r.qubits << ',' << r.threads << ','
+            << r.gates << ',' << r.reps << ',' << r.time_min << ',' << r.time_median << ',' << r.time_mean << ','
+            << r.gates_per_sec << ',';
+        // empty field for backends without a bandwidth figure
+        if (!isnan(r.gb_per_sec)) out << r.gb_per_sec;
+        out << "\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    bool kernels = find(options.suites.begin(), options.suites.end(), "kernels") != options.suites.end();
+    bool circuits = find(options.suites.begin(), options.suites.end(), "circuits") != options.suites.end();
+
+    cout << "--- Quantum Simulator Benchmark Suite ---\n";
+    cout << left << setw(9) << "suite" << setw(10) << "name" << setw(10) << "backend" << setw(6) << "pos"
+         << right << setw(4) << "n" << setw(4) << "t" << setw(8) << "gates"
+         << setw(12) << "median[s]" << setw(14) << "gates/s" << setw(9) << "GB/s" << "\n";
+
+    vector<Record> records;
+    for (const string &backend : options.backends) {
+        // only the parallel backend depends on the thread count
+        vector<int> thread_counts = backend == "parallel" ? options.threads : vector<int>{1};
+        for (int threads : thread_counts) {
+            omp_set_num_threads(threads);
+            for (int qubits : options.qubits) {
+                try {
+                    if (kernels) {
+                        auto found = kernelSuite(options, backend, qubits, threads);
+                        records.insert(records.end(), found.begin(), found.end());
+                    }
+                    if (circuits) {
+                        auto found = circuitSuite(options, backend, qubits, threads);
+                        records.insert(records.end(), found.begin(), found.end());
+                    }
+                } catch (const exception &e) {
+                    cerr << "Skipping " << backend << " with " << qubits << " qubits: " << e.what() << "\n";
+                }
+            }
+        }
+    }
+
+    if (!options.json_path.empty()) writeJson(options.json_path, options, records);
+    if (!options.csv_path.empty()) writeCsv(options.csv_path, records);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <omp.h>
+
+#include <MaQrel/QuantumCircuitParallel.h>
+#include <MaQrel/QuantumCircuitSparse.h>
+#include <MaQrel/QuantumCircuitSoA.h>
+#include <MaQrel/QuantumCircuitMPS.h>
+#include <MaQrel/QuantumThreadPool.h>
+#include <MaQrel/QuantumQasm.h>
+#include <MaQrel/QuantumCircuitFile.h>
+
+using namespace std;
+
+// Runs an OpenQASM 2.0 file without prompts, e.g.
+//   ./bin/Quantum_QasmRunner circuit.qasm --backend parallel --shots 1000
+// Binary circuit files (.mqc, see QuantumCircuitFile.h) are replayed from a memory
+// mapping instead, their shots sample all qubits.
+
+struct Options {
+    string path;
+    string backend = "parallel";
+    int threads = omp_get_max_threads();
+    int shots = 1024;
+    unsigned long seed = 1234;
+    int top = 16; // most frequent outcomes printed
+};
+
+void printUsage() {
+    cout << "Usage: Quantum_QasmRunner FILE [options]   (FILE .qasm, .mqc or - for stdin)\n"
+         << "  --backend NAME     serial, parallel, soa, sparse or mps (default parallel)\n"
+         << "  --threads N        threads of the parallel backend\n"
+         << "  --shots N          samples of the final measurements, 0 collapses once (default 1024)\n"
+         << "  --seed N           seed for the samples\n"
+         << "  --top N            outcomes printed, most frequent first (default 16)\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--help" || arg == "-h") return false;
+        if (arg.rfind("--", 0) != 0) {
+            options.path = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        string value = argv[++i];
+        try {
+            if (arg == "--backend") options.backend = value;
+            else if (arg == "--threads") options.threads = max(1, stoi(value));
+            else if (arg == "--shots") options.shots = max(0, stoi(value));
+            else if (arg == "--seed") options.seed = stoul(value);
+            else if (arg == "--top") options.top = max(0, stoi(value));
+            else {
+                cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        } catch (const exception &) {
+            // stoi and stoul throw invalid_argument or out_of_range
+            cerr << "Invalid value " << value << " for " << arg << "\n";
+            return false;
+        }
+    }
+    return !options.path.empty();
+}
+
+unique_ptr<QuantumCircuitBase> makeCircuit(const string &backend, int qubits, QuantumThreadPool &pool) {
+    unique_ptr<QuantumCircuitBase> qc;
+    if (backend == "serial") qc = make_unique<QuantumCircuitBase>(qubits);
+    else if (backend == "parallel") qc = make_unique<QuantumCircuitParallel>(qubits, pool);
+    else if (backend == "soa") qc = make_unique<QuantumCircuitSoA>(qubits);
+    else if (backend == "sparse") qc = make_unique<QuantumCircuitSparse>(qubits);
+    else if (backend == "mps") qc = make_unique<QuantumCircuitMPS>(qubits);
+    else throw invalid_argument("Unknown backend " + backend);
+    // the diagram would grow with every gate of the file
+    qc->setDiagramEnabled(false);
+    return qc;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    bool binary = options.path.size() > 4 && options.path.compare(options.path.size() - 4, 4, ".mqc") == 0;
+    ifstream file;
+    if (options.path != "-" && !binary) {
+        file.open(options.path);
+        if (!file.is_open()) {
+            cerr << "Cannot open " << options.path << "\n";
+            return 1;
+        }
+    }
+    istream &in = options.path == "-" ? cin : file;
+
+    try {
+        QuantumThreadPool::Options pool_options;
+        pool_options.threads = options.threads;
+        QuantumThreadPool pool(pool_options);
+
+        QasmReader::Stats stats;
+        map<string, int> counts;
+        int qubits;
+        if (binary) {
+            auto begin = chrono::steady_clock::now();
+            QuantumCircuitFile::MappedCircuit circuit(options.path);
+            qubits = circuit.qubitCount();
+            auto qc = makeCircuit(options.backend, qubits, pool);
+            auto mapped = chrono::steady_clock::now();
+            circuit.replay(*qc);
+            qc->flush();
+            auto replayed = chrono::steady_clock::now();
+            stats.statements = stats.gates = circuit.size();
+            stats.parse_seconds = chrono::duration<double>(mapped - begin).count();
+            stats.simulate_seconds = chrono::duration<double>(replayed - mapped).count();
+            if (options.shots > 0) counts = qc->run(options.shots);
+            else counts[qc->collapse()] = 1;
+        } else {
+            QasmReader reader(in);
+            qubits = reader.qubitCount();
+            auto qc = makeCircuit(options.backend, qubits, pool);
+            reader.run(*qc);
+            if (options.shots > 0) counts = reader.sampleFinal(*qc, options.shots, options.seed);
+            else {
+                reader.measureFinal(*qc);
+                counts[reader.classicalBits()] = 1;
+            }
+            stats = reader.stats();
+        }
+
+        cout << "--- " << options.path << " ---\n"
+             << "qubits        " << qubits << "\n"
+             << "backend       " << options.backend << (options.backend == "parallel" ? " (" + to_string(pool.size()) + " threads)" : "") << "\n"
+             << "statements    " << stats.statements << "\n"
+             << "gates         " << stats.gates << "\n"
+             << "measurements  " << stats.measurements << "\n"
+             << fixed << setprecision(6)
+             << "parse[s]      " << stats.parse_seconds << "\n"
+             << "simulate[s]   " << stats.simulate_seconds << "\n";
+        if (stats.simulate_seconds > 0)
+            cout << setprecision(0) << "gates/s       " << stats.gates / stats.simulate_seconds << "\n";
+
+        vector<pair<string, int>> sorted(counts.begin(), counts.end());
+        stable_sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+        if (!sorted.empty() && !sorted[0].first.empty()) {
+            cout << "\noutcome counts (" << sorted.size() << " distinct)\n";
+            for (size_t i = 0; i < sorted.size() && i < (size_t)options.top; i++)
+                cout << "  " << sorted[i].first << "  " << sorted[i].second << "\n";
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
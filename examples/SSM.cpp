@@ -1,6 +1,6 @@
 #include<iostream>
 #include<vector>
-#include <MaQrel/QuantumCircuitParallel.h>
+#include <MaQrel/QuantumCircuitFixed.h>
 #include<random>
 #include<omp.h>
 using namespace std;
@@ -19,7 +19,7 @@ void printVector(vector<T> &a){
 double encoder(double x){
     return 2*x*M_PI;
 }
-double singleStep(QuantumCircuitParallel &qc,
+double singleStep(QuantumCircuitFixed<2> &qc,
     vector<double> & params,
     double x)
 {
@@ -40,7 +40,7 @@ double singleStep(QuantumCircuitParallel &qc,
     return e;
 }
 
-double paramShift(QuantumCircuitParallel &qc,
+double paramShift(QuantumCircuitFixed<2> &qc,
                   vector<double> &params,
                   double x,
                   double y,
@@ -92,7 +92,7 @@ int main() {
         values[i] = 0.5 * (1.0 + sin(2 * M_PI * i / n));
     }
 
-    QuantumCircuitParallel qc(2);
+    QuantumCircuitFixed<2> qc;
 
     vector<double> params(6);
     for (auto &p : params) p = dist(gen);
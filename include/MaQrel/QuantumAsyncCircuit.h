@@ -0,0 +1,143 @@
+#ifndef QUANTUMASYNCCIRCUIT_H
+#define QUANTUMASYNCCIRCUIT_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <type_traits>
+#include "QuantumProgram.h"
+#include "QuantumCircuitBase.h"
+
+//Runs a circuit on its own executor thread. Gate calls only check their operands and
+//queue the gate, so the caller can prepare the next parameters while the state is
+//updated; measurements and expectation values return futures. The executor drains the
+//whole queue at once and fuses every run of single qubit gates on a qubit into one U,
+//moving them past gates on other qubits, so a batch costs one pass per fused run.
+//The wrapped circuit must outlive this object and must not be used directly meanwhile.
+//Fusion has to be off for the stabilizer backend, a fused U is not Clifford.
+class QuantumAsyncCircuit {
+public:
+    explicit QuantumAsyncCircuit(QuantumCircuitBase &circuit, bool fuse = true);
+    //applies everything still queued, then stops the executor
+    ~QuantumAsyncCircuit();
+    QuantumAsyncCircuit(const QuantumAsyncCircuit&) = delete;
+    QuantumAsyncCircuit& operator=(const QuantumAsyncCircuit&) = delete;
+
+    void submit(const GateOp &op);
+    void submit(const QuantumProgram &program);
+
+    //Runs f(circuit) on the executor after every gate queued before it. An error of an
+    //earlier gate is reported through this future instead, and the gates queued between
+    //the failed gate and this call are dropped.
+    template<class F>
+    auto call(F f) -> std::future<std::invoke_result_t<F, QuantumCircuitBase&>>;
+
+    //done once every gate queued so far is applied
+    std::future<void> sync();
+    std::future<double> expectZ(const std::vector<int> &qubits);
+    std::future<double> expectation(const Observable &observable);
+    std::future<std::vector<double>> marginalProbabilities(const std::vector<int> &qubits);
+    std::future<int> measure_single_qubit(int qubit);
+    std::future<std::string> collapse();
+    std::future<std::map<std::string,int>> run(int num_shots);
+
+    //gates submitted, and state passes they took after fusion
+    size_t getSubmittedGates() const { return submitted_gates; }
+    size_t getAppliedGates() const { return applied_gates; }
+
+    //Same names as the circuit methods
+    void H(int q) { submit({GateKind::H, q}); }
+    void X(int q) { submit({GateKind::X, q}); }
+    void Y(int q) { submit({GateKind::Y, q}); }
+    void Z(int q) { submit({GateKind::Z, q}); }
+    void S(int q) { submit({GateKind::S, q}); }
+    void Sdg(int q) { submit({GateKind::Sdg, q}); }
+    void T(int q) { submit({GateKind::T, q}); }
+    void Tdg(int q) { submit({GateKind::Tdg, q}); }
+    void P(int q, double theta) { submit({GateKind::P, q, -1, theta}); }
+    void Rx(int q, double theta) { submit({GateKind::Rx, q, -1, theta}); }
+    void Ry(int q, double theta) { submit({GateKind::Ry, q, -1, theta}); }
+    void Rz(int q, double theta) { submit({GateKind::Rz, q, -1, theta}); }
+    void CX(int c, int t) { submit({GateKind::CX, c, t}); }
+    void CY(int c, int t) { submit({GateKind::CY, c, t}); }
+    void CZ(int c, int t) { submit({GateKind::CZ, c, t}); }
+    void CH(int c, int t) { submit({GateKind::CH, c, t}); }
+    void CS(int c, int t) { submit({GateKind::CS, c, t}); }
+    void CSdg(int c, int t) { submit({GateKind::CSdg, c, t}); }
+    void CT(int c, int t) { submit({GateKind::CT, c, t}); }
+    void CTdg(int c, int t) { submit({GateKind::CTdg, c, t}); }
+    void CP(int c, int t, double theta) { submit({GateKind::CP, c, t, theta}); }
+    void CRx(int c, int t, double theta) { submit({GateKind::CRx, c, t, theta}); }
+    void CRy(int c, int t, double theta) { submit({GateKind::CRy, c, t, theta}); }
+    void CRz(int c, int t, double theta) { submit({GateKind::CRz, c, t, theta}); }
+    void SWAP(int a, int b) { submit({GateKind::SWAP, a, b}); }
+    void iSWAP(int a, int b) { submit({GateKind::iSWAP, a, b}); }
+
+private:
+    //a gate, or a call when run is set
+    struct Task {
+        GateOp op;
+        std::function<void(QuantumCircuitBase&)> run;
+        std::function<void(std::exception_ptr)> fail;
+    };
+
+    //single qubit gates waiting on a qubit, product is applied first to last
+    struct PendingRun {
+        std::array<std::complex<double>,4> product;
+        GateOp first;
+        size_t count = 0;
+    };
+
+    QuantumCircuitBase &circuit;
+    bool fuse;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Task> queue;
+    bool stopping = false;
+    std::atomic<size_t> submitted_gates{0};
+    std::atomic<size_t> applied_gates{0};
+
+    //only touched by the executor
+    std::vector<PendingRun> pending;
+    std::exception_ptr error;
+    std::thread executor;
+
+    void enqueue(Task task);
+    void execute();
+    void applyGate(const GateOp &op);
+    void flushQubit(int qubit);
+    void flushAll();
+};
+
+template<class F>
+auto QuantumAsyncCircuit::call(F f) -> std::future<std::invoke_result_t<F, QuantumCircuitBase&>> {
+    using Result = std::invoke_result_t<F, QuantumCircuitBase&>;
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> result = promise->get_future();
+    Task task;
+    task.run = [promise, f](QuantumCircuitBase &target) mutable {
+        try{
+            if constexpr(std::is_void_v<Result>){
+                f(target);
+                promise->set_value();
+            }else{
+                promise->set_value(f(target));
+            }
+        }catch(...){
+            promise->set_exception(std::current_exception());
+        }
+    };
+    task.fail = [promise](std::exception_ptr e){ promise->set_exception(e); };
+    enqueue(std::move(task));
+    return result;
+}
+
+#endif
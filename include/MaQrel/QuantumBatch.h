@@ -0,0 +1,62 @@
+#ifndef QUANTUMBATCH_H
+#define QUANTUMBATCH_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "QuantumProgram.h"
+#include "QuantumObservable.h"
+
+//One independent circuit of a batch: the program run from |0...0>, then the expectation
+//values of the observables and shots samples of every qubit
+struct BatchJob {
+    QuantumProgram program;
+    std::vector<Observable> observables;
+    int shots = 0;
+    bool optimize = false; //run the program through QuantumOptimizer first
+};
+
+struct BatchResult {
+    std::vector<double> expectations; //one per observable
+    std::map<std::string,int> counts;
+    size_t gates_removed = 0; //by the optimizer
+};
+
+//Throughput runner for many small circuits. Circuits below parallel_qubits run one per
+//thread on serial kernels, each thread recycling its state vectors between jobs and
+//between batches, so a tiny gate is never split over threads. Larger circuits run one
+//after the other on QuantumCircuitParallel. Results come back in submission order and
+//every job samples from its own RNG stream derived from the seed, so they do not depend
+//on the thread count.
+class QuantumBatchRunner {
+public:
+    struct Options {
+        int threads = 0;          //0 = omp_get_max_threads()
+        int parallel_qubits = 18; //circuits with at least this many qubits use the parallel backend
+        uint64_t seed = 0;
+    };
+
+    explicit QuantumBatchRunner(const Options &options);
+    QuantumBatchRunner() : QuantumBatchRunner(Options()) {}
+    ~QuantumBatchRunner();
+    QuantumBatchRunner(const QuantumBatchRunner&) = delete;
+    QuantumBatchRunner& operator=(const QuantumBatchRunner&) = delete;
+
+    std::vector<BatchResult> run(const std::vector<BatchJob> &jobs);
+    //the same observables and shots for every program
+    std::vector<BatchResult> run(const std::vector<QuantumProgram> &programs, const std::vector<Observable> &observables, int shots = 0);
+
+    //frees the recycled state vectors
+    void releaseStates();
+
+private:
+    class RecycledCircuit;
+
+    Options options;
+    //per thread, recycled circuits by qubit count
+    std::vector<std::map<int, std::unique_ptr<RecycledCircuit>>> recycled;
+};
+
+#endif
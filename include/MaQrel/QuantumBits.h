@@ -0,0 +1,65 @@
+#ifndef QUANTUMBITS_H
+#define QUANTUMBITS_H
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+//Bit tricks shared by the state vector kernels
+namespace QuantumBits {
+
+    //1 when an odd number of bits are set
+    inline int parity(size_t value){
+        return __builtin_parityll(static_cast<unsigned long long>(value));
+    }
+
+    inline int popcount(size_t value){
+        return __builtin_popcountll(static_cast<unsigned long long>(value));
+    }
+
+    //position of the highest set bit, value must not be 0
+    inline int highestBit(size_t value){
+        return 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+    }
+
+    //value with a 0 inserted at bit position, the higher bits move up by one. Maps the
+    //k-th amplitude pair of a gate on qubit position to its |0> index.
+    inline size_t insertZeroBit(size_t value, int position){
+        size_t low = value & ((1ULL<<position) - 1);
+        return ((value ^ low) << 1) | low;
+    }
+
+    //Gathers the bits of value selected by mask into the low bits (PEXT)
+    inline size_t compactBits(size_t value, size_t mask){
+    #if defined(__BMI2__)
+        return _pext_u64(value, mask);
+    #else
+        size_t result = 0;
+        for(size_t bit = 1; mask; bit <<= 1){
+            size_t lowest = mask & (~mask + 1);
+            if(value & lowest) result |= bit;
+            mask ^= lowest;
+        }
+        return result;
+    #endif
+    }
+
+    //Scatters the low bits of value into the positions selected by mask (PDEP)
+    inline size_t depositBits(size_t value, size_t mask){
+    #if defined(__BMI2__)
+        return _pdep_u64(value, mask);
+    #else
+        size_t result = 0;
+        for(size_t bit = 1; mask; bit <<= 1){
+            size_t lowest = mask & (~mask + 1);
+            if(value & bit) result |= lowest;
+            mask ^= lowest;
+        }
+        return result;
+    #endif
+    }
+}
+
+#endif
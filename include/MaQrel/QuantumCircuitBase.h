@@ -6,6 +6,10 @@
 #include<complex>
 #include<string>
 #include<functional>
+#include<array>
+#include<memory>
+#include "QuantumObservable.h"
+#include "QuantumSnapshot.h"
 
 class QuantumCircuitBase {
 protected:
@@ -15,10 +19,13 @@ protected:
 
     //Circuit
     std::vector<std::string> circuit;
+    bool diagram_enabled = true;
 
     //Add to the ASCII representation
     void addCircuit(int qubit,const std::string &gate);
     void addCircuit(int qubit1,const std::string &gate1, int qubit2, const std::string &gate2);
+    //one box on every qubit of a multi-qubit operation
+    void addCircuit(const std::vector<int> &qubits, const std::string &gate);
     //this aligns the columns of the circuit to look nice
     void alignCircuitColumns();
 
@@ -30,11 +37,42 @@ protected:
     //For controlled two qubit operations
     virtual void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op);
 
+    //For expectation values
+    //sum_i |a_i|^2 (-1)^{|i & mask|} for every mask, in a single pass over the state
+    virtual std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks);
+    //probabilities of the values of the mask bits, indexed by compactBits(i, mask)
+    virtual std::vector<double> maskedMarginal(size_t mask);
+    //rotates the qubits in x_basis/y_basis so that X/Y measurements become Z measurements
+    void rotateToZBasis(size_t x_basis, size_t y_basis);
+
+    //2^n amplitudes
+    void checkStateSize(size_t size) const;
+    //non-empty, in range and distinct
+    void checkRegister(const std::vector<int> &qubits) const;
+    //QFT as H and CP gates followed by the swaps, for backends without a state vector
+    void applyQFTGates(const std::vector<int> &qubits, bool inverse);
+    //exp(-i theta/2 P) for the Pauli string with the masks of a PauliTerm, one pass over the state
+    virtual void applyPauliRotation(size_t x_mask, size_t z_mask, double theta);
+    //the same as basis changes, a CX chain, an Rz and the reverse, for backends without a state vector
+    void applyPauliRotationGates(size_t x_mask, size_t z_mask, double theta);
+    //same number of qubits as other
+    void checkSameQubits(const QuantumCircuitBase &other) const;
+    //amplitudes of a flushed circuit: its state_vector when it keeps the state there,
+    //otherwise exported into buffer
+    static const std::vector<std::complex<double>>& denseAmplitudes(QuantumCircuitBase &circuit, std::vector<std::complex<double>> &buffer);
+
+    //For backends that keep the amplitudes somewhere other than state_vector
+    QuantumCircuitBase(int n, bool allocate_state);
+
 public:
     //Constructor
     QuantumCircuitBase(int n);
     virtual ~QuantumCircuitBase() = default;
 
+    int getQubitCount() const { return qubit_count; }
+    //applies the gates a backend has queued, nothing to do for the ones that apply them right away
+    virtual void flush() {}
+
     //Public gate methods
     //Hadamard Gate
     virtual void H(int target_qubit);
@@ -52,6 +90,8 @@ public:
     virtual void Rz(int target_qubit, const double theta);
     virtual void Rx(int target_qubit, const double theta);
     virtual void Ry(int target_qubit, const double theta);
+    //Any single qubit unitary, row major with |0> then |1>, e.g. several gates fused into one
+    virtual void U(int target_qubit, const std::array<std::complex<double>,4> &matrix);
     //Controlled gates for above ones
     virtual void CX(int control_qubit, int target_qubit);
     virtual void CZ(int control_qubit, int target_qubit);
@@ -68,32 +108,70 @@ public:
     //Two qubit gates
     virtual void SWAP(int qubit_1, int qubit_2);
     virtual void iSWAP(int qubit_1, int qubit_2);
+    //Quantum Fourier transform on a register, qubits[0] is the least significant bit.
+    //Runs as an FFT over the amplitudes, O(k 2^n) instead of O(k^2) gate passes.
+    virtual void QFT(const std::vector<int> &qubits, bool inverse = false);
+
+    //Rotation exp(-i theta/2 P) about a Pauli string, the rightmost character on qubit 0 as
+    //in Observable::addTerm, so PauliRotation("Z", theta) is Rz(theta). One pass over the state.
+    void PauliRotation(const std::string &pauli_string, double theta);
+    //paulis[k] acts on qubits[k]
+    void PauliRotation(const std::string &paulis, const std::vector<int> &qubits, double theta);
+    //One step of exp(-i H dt), one Pauli rotation per term: order 1 applies the terms in order,
+    //order 2 the symmetric product with half steps on both sides of the last term
+    void trotterStep(const Observable &hamiltonian, double dt, int order = 1);
 
     //destructive measurement
-    std::string collapse();
+    virtual std::string collapse();
     //measurement for multiple runs
-    std::map<std::string,int> run(int num_shots);
+    virtual std::map<std::string,int> run(int num_shots);
     //destructive measurement of a single qubit
-    int measure_single_qubit(int qubit);
+    virtual int measure_single_qubit(int qubit);
     //destructive measurement of a range of qubits
-    std::string measure_range_of_qubits(const std::vector<int> &qubits);
+    virtual std::string measure_range_of_qubits(const std::vector<int> &qubits);
     //measurement of a subset of qubits for multiple runs
-    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits);
+    virtual std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits);
+    //probabilities of all 2^k outcomes of qubits, bit j of the index is qubits[j]
+    std::vector<double> marginalProbabilities(const std::vector<int> &qubits);
     void reset(int qubit);
-    void resetAll(int qubit);
+    virtual void resetAll(int qubit);
 
     // Helper to output probability amplitude
     std::complex<double> getProbAmplitude(const std::vector<std::complex<double>>& state_vector, int qubit){
         return state_vector[qubit];
     };
 
-    double expectZ(std::vector<int> &q);
+    virtual double expectZ(const std::vector<int> &q);
+    //expectation value of a weighted sum of Pauli strings
+    virtual double expectation(const Observable &observable);
+    //Binary snapshots of the state vector
+    virtual void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double);
+    virtual void loadState(const std::string &path);
+    //In-memory copies of the amplitudes, e.g. to resume from a cached prefix state.
+    //importState leaves the diagram alone.
+    virtual std::vector<std::complex<double>> exportState();
+    virtual void importState(const std::vector<std::complex<double>> &amplitudes);
+    //copy on the same backend, state and diagram included
+    virtual std::unique_ptr<QuantumCircuitBase> clone();
+
+    //Overlaps, between circuits with the same number of qubits on any backends
+    //<this|other>
+    virtual std::complex<double> innerProduct(QuantumCircuitBase &other);
+    //|<this|other>|^2, the fidelity of two normalised pure states
+    double fidelity(QuantumCircuitBase &other) { return std::norm(innerProduct(other)); }
+    //sqrt(<this|this>), not norm() which would hide std::norm in the backends
+    virtual double stateNorm();
+    //amplitude of the basis state index, bit q of index is qubit q
+    virtual std::complex<double> amplitude(size_t index);
+
     //Helpers for outputing results
-    void printState(); //prints the entire state
+    virtual void printState(); //prints the entire state
     void printCircuit(); //prints the entire circuit
-    void printProbabilities(); //prints current probabilities above a threshold
-    void displayGraph(); // displays a graph using GNUPlot for the probabilities above a threshold
-    void displayHeatMap(); // heat map of the probabilities
+    //the ASCII diagram costs O(n) string work per gate, turn it off for wide or long circuits
+    void setDiagramEnabled(bool enabled) { diagram_enabled = enabled; }
+    virtual void printProbabilities(); //prints current probabilities above a threshold
+    virtual void displayGraph(); // displays a graph using GNUPlot for the probabilities above a threshold
+    virtual void displayHeatMap(); // heat map of the probabilities
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef QUANTUMCIRCUITFILE_H
+#define QUANTUMCIRCUITFILE_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <complex>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include "QuantumProgram.h"
+
+class QuantumCircuitBase;
+
+//Binary circuit files. A fixed header, then one fixed width record per gate, then the
+//matrices of the U records and a table of null terminated strings. The file is mapped
+//and replayed record by record straight into the gate methods, nothing is parsed or
+//allocated per gate.
+namespace QuantumCircuitFile {
+
+    constexpr char MAGIC[8] = {'M','A','Q','R','E','L','Q','C'};
+    constexpr uint32_t VERSION = 1;
+
+    //Record opcodes. The gate opcodes are the GateKind values, new kinds are only appended.
+    constexpr uint8_t OPCODE_U = 64;     //index is the matrix
+    constexpr uint8_t OPCODE_LABEL = 65; //index is a string offset, skipped on replay
+    constexpr uint32_t NO_STRING = UINT32_MAX;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t qubit_count;
+        uint64_t record_count;
+        uint64_t record_offset;
+        uint64_t matrix_count;
+        uint64_t matrix_offset;  //matrix_count x 4 complex<double>, row major
+        uint64_t string_offset;
+        uint64_t string_bytes;
+        uint32_t name;           //string offset of the circuit name or NO_STRING
+        uint32_t reserved;
+    };
+
+    struct Record {
+        uint8_t opcode;
+        uint8_t reserved[3];
+        int32_t qubit_1;
+        int32_t qubit_2;   //-1 for single qubit gates
+        uint32_t index;    //matrix or string of U and label records
+        double theta;
+    };
+    static_assert(sizeof(Header) == 72 && sizeof(Record) == 24, "The file layout must not depend on the compiler.");
+
+    //Streams records to a file. Records are written in large blocks as they come, the
+    //matrices and strings are kept until close() appends them and fills in the header.
+    class Writer {
+        std::ofstream out;
+        std::string path;
+        Header header;
+        std::vector<Record> pending;
+        std::vector<std::array<std::complex<double>,4>> matrices;
+        std::string strings;
+        bool closed = false;
+
+        void push(const Record &record);
+        uint32_t addString(const std::string &text);
+
+    public:
+        Writer(const std::string &path, int qubit_count);
+        //closes the file if close() was not called, errors are lost then
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        int qubitCount() const { return header.qubit_count; }
+        size_t size() const { return header.record_count; }
+
+        //checks the operands like QuantumProgram::add
+        Writer& add(const GateOp &op);
+        Writer& add(const QuantumProgram &program);
+        Writer& U(int q, const std::array<std::complex<double>,4> &matrix);
+        //a marker between gates, e.g. the start of a layer
+        Writer& label(const std::string &text);
+        Writer& setName(const std::string &name);
+
+        //Builders with the same names as the circuit methods
+        Writer& H(int q) { return add({GateKind::H, q}); }
+        Writer& X(int q) { return add({GateKind::X, q}); }
+        Writer& Y(int q) { return add({GateKind::Y, q}); }
+        Writer& Z(int q) { return add({GateKind::Z, q}); }
+        Writer& S(int q) { return add({GateKind::S, q}); }
+        Writer& Sdg(int q) { return add({GateKind::Sdg, q}); }
+        Writer& T(int q) { return add({GateKind::T, q}); }
+        Writer& Tdg(int q) { return add({GateKind::Tdg, q}); }
+        Writer& P(int q, double theta) { return add({GateKind::P, q, -1, theta}); }
+        Writer& Rx(int q, double theta) { return add({GateKind::Rx, q, -1, theta}); }
+        Writer& Ry(int q, double theta) { return add({GateKind::Ry, q, -1, theta}); }
+        Writer& Rz(int q, double theta) { return add({GateKind::Rz, q, -1, theta}); }
+        Writer& CX(int c, int t) { return add({GateKind::CX, c, t}); }
+        Writer& CY(int c, int t) { return add({GateKind::CY, c, t}); }
+        Writer& CZ(int c, int t) { return add({GateKind::CZ, c, t}); }
+        Writer& CH(int c, int t) { return add({GateKind::CH, c, t}); }
+        Writer& CS(int c, int t) { return add({GateKind::CS, c, t}); }
+        Writer& CSdg(int c, int t) { return add({GateKind::CSdg, c, t}); }
+        Writer& CT(int c, int t) { return add({GateKind::CT, c, t}); }
+        Writer& CTdg(int c, int t) { return add({GateKind::CTdg, c, t}); }
+        Writer& CP(int c, int t, double theta) { return add({GateKind::CP, c, t, theta}); }
+        Writer& CRx(int c, int t, double theta) { return add({GateKind::CRx, c, t, theta}); }
+        Writer& CRy(int c, int t, double theta) { return add({GateKind::CRy, c, t, theta}); }
+        Writer& CRz(int c, int t, double theta) { return add({GateKind::CRz, c, t, theta}); }
+        Writer& SWAP(int a, int b) { return add({GateKind::SWAP, a, b}); }
+        Writer& iSWAP(int a, int b) { return add({GateKind::iSWAP, a, b}); }
+
+        //appends the matrices and strings and writes the header
+        void close();
+    };
+
+    //Whole program in one call
+    void write(const std::string &path, const QuantumProgram &program);
+
+    //Read-only memory mapping of a circuit file
+    class MappedCircuit {
+        const unsigned char *data = nullptr;
+        size_t length = 0;
+        Header header;
+        std::vector<unsigned char> fallback; //used where mmap is not available
+
+        //checks the header against the file length
+        void readHeader();
+
+    public:
+        explicit MappedCircuit(const std::string &path);
+        ~MappedCircuit();
+        MappedCircuit(const MappedCircuit&) = delete;
+        MappedCircuit& operator=(const MappedCircuit&) = delete;
+
+        int qubitCount() const { return header.qubit_count; }
+        //records, labels included
+        size_t size() const { return header.record_count; }
+        Record record(size_t i) const;
+        std::array<std::complex<double>,4> matrix(uint32_t index) const;
+        //string at offset, empty for NO_STRING
+        std::string stringAt(uint32_t offset) const;
+        std::string name() const { return stringAt(header.name); }
+
+        //applies records [first, last) through the gate methods of circuit
+        void replay(QuantumCircuitBase &circuit, size_t first = 0, size_t last = SIZE_MAX) const;
+    };
+}
+
+#endif
@@ -0,0 +1,324 @@
+#ifndef QUANTUMCIRCUITFIXED_H
+#define QUANTUMCIRCUITFIXED_H
+
+#include <array>
+#include <vector>
+#include <complex>
+#include <map>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include "QuantumGates.h"
+#include "QuantumBits.h"
+#include "QuantumObservable.h"
+#include "QuantumVisualization.h"
+
+//State vector circuit with the qubit count fixed at compile time, for tiny circuits that
+//are evaluated millions of times (e.g. the 2 qubit SSM). The state is a std::array, the
+//runtime qubit index picks a kernel instantiated per qubit, so the index masks are
+//constants and the loops have constant trip counts, the short ones fully unrolled.
+//Gates take the QuantumGates lambdas directly instead of a std::function.
+//Same gate and measurement methods as QuantumCircuitBase, without the circuit diagram;
+//collapse() and measure_range_of_qubits() do not print.
+template<int N>
+class QuantumCircuitFixed {
+    static_assert(N >= 1 && N <= 16, "QuantumCircuitFixed is meant for small qubit counts, use QuantumCircuitBase above 16.");
+
+public:
+    static constexpr size_t SIZE = size_t(1) << N;
+    using State = std::array<std::complex<double>, SIZE>;
+
+private:
+    State state_vector;
+
+    //one generator per thread, shared by all fixed circuits
+    static std::mt19937_64& generator(){
+        thread_local std::mt19937_64 gen(std::random_device{}());
+        return gen;
+    }
+
+    //loops of at most this many iterations are unrolled at compile time
+    static constexpr size_t UNROLL_LIMIT = 16;
+
+    template<size_t COUNT, class Body, size_t... K>
+    static void unrolled(Body &body, std::index_sequence<K...>){
+        (body(K), ...);
+    }
+
+    //body(k) for k in [0, COUNT)
+    template<size_t COUNT, class Body>
+    static void repeat(Body &&body){
+        if constexpr(COUNT <= UNROLL_LIMIT) unrolled<COUNT>(body, std::make_index_sequence<COUNT>{});
+        else for(size_t k=0; k<COUNT; k++) body(k);
+    }
+
+    //k with a 0 inserted at bit P
+    template<int P>
+    static constexpr size_t insertZero(size_t k){
+        constexpr size_t low = (size_t(1) << P) - 1;
+        return ((k & ~low) << 1) | (k & low);
+    }
+
+    //calls f(std::integral_constant<int, q>)
+    template<int Q = 0, class F>
+    static void dispatch(int q, F &&f){
+        if constexpr(Q < N){
+            if(q == Q) f(std::integral_constant<int, Q>{});
+            else dispatch<Q+1>(q, std::forward<F>(f));
+        }else{
+            (void)q;
+            (void)f;
+            throw std::out_of_range("Qubits out of range.");
+        }
+    }
+
+    template<int T, class Op>
+    void singleKernel(Op op){
+        constexpr size_t bit = size_t(1) << T;
+        repeat<SIZE/2>([&](size_t k){
+            size_t i = insertZero<T>(k);
+            op(state_vector[i], state_vector[i|bit]);
+        });
+    }
+
+    template<int C, int T, class Op>
+    void controlledKernel(Op op){
+        if constexpr(C != T){
+            constexpr int low = C < T ? C : T;
+            constexpr int high = C < T ? T : C;
+            constexpr size_t control = size_t(1) << C, target = size_t(1) << T;
+            repeat<SIZE/4>([&](size_t k){
+                size_t i = insertZero<high>(insertZero<low>(k)) | control;
+                op(state_vector[i], state_vector[i|target]);
+            });
+        }
+    }
+
+    //op(|00>, |01>, |10>, |11>) with qubit_1 as the high bit, like applyTwoQubitOp
+    template<int A, int B, class Op>
+    void twoQubitKernel(Op op){
+        if constexpr(A != B){
+            constexpr int low = A < B ? A : B;
+            constexpr int high = A < B ? B : A;
+            constexpr size_t bit_a = size_t(1) << A, bit_b = size_t(1) << B;
+            repeat<SIZE/4>([&](size_t k){
+                size_t i = insertZero<high>(insertZero<low>(k));
+                op(state_vector[i], state_vector[i|bit_b], state_vector[i|bit_a], state_vector[i|bit_a|bit_b]);
+            });
+        }
+    }
+
+    template<class Op>
+    void applySingleQubitOp(int target_qubit, Op op){
+        dispatch(target_qubit, [&](auto t){ singleKernel<decltype(t)::value>(op); });
+    }
+
+    template<class Op>
+    void applyControlledQubitOp(int control_qubit, int target_qubit, Op op){
+        if(control_qubit == target_qubit && control_qubit >= 0 && control_qubit < N) throw std::invalid_argument("Control and target qubits cannot be the same.");
+        dispatch(control_qubit, [&](auto c){
+            dispatch(target_qubit, [&](auto t){ controlledKernel<decltype(c)::value, decltype(t)::value>(op); });
+        });
+    }
+
+    template<class Op>
+    void applyTwoQubitOp(int qubit_1, int qubit_2, Op op){
+        if(qubit_1 == qubit_2 && qubit_1 >= 0 && qubit_1 < N) throw std::invalid_argument("Qubits cannot be the same");
+        dispatch(qubit_1, [&](auto a){
+            dispatch(qubit_2, [&](auto b){ twoQubitKernel<decltype(a)::value, decltype(b)::value>(op); });
+        });
+    }
+
+    static size_t checkedMask(const std::vector<int> &qubits){
+        size_t mask = 0;
+        for(int q: qubits){
+            if(q < 0 || q >= N) throw std::out_of_range("Qubits out of range.");
+            mask |= size_t(1) << q;
+        }
+        return mask;
+    }
+
+    //probabilities of the outcomes of mask, by compacted index
+    std::vector<double> maskedMarginal(size_t mask) const {
+        std::vector<double> weights(size_t(1) << QuantumBits::popcount(mask), 0.0);
+        for(size_t i=0; i<SIZE; i++) weights[QuantumBits::compactBits(i, mask)] += std::norm(state_vector[i]);
+        return weights;
+    }
+
+    static std::string rangeString(size_t measurement, const std::vector<int> &qubits){
+        std::string output;
+        for(int q: qubits) output += ((measurement >> q) & 1) ? '1' : '0';
+        return output;
+    }
+
+    template<class Weights>
+    static size_t sample(const Weights &cumulative, double total){
+        double r = std::uniform_real_distribution<double>(0.0, total)(generator());
+        size_t index = std::upper_bound(cumulative.begin(), cumulative.end(), r) - cumulative.begin();
+        return std::min<size_t>(index, cumulative.size() - 1);
+    }
+
+public:
+    QuantumCircuitFixed(){ resetAll(0); }
+
+    static constexpr int getQubitCount() { return N; }
+    //seeds the measurement generator of the calling thread
+    static void seed(uint64_t value) { generator().seed(value); }
+
+    const State& state() const { return state_vector; }
+
+    //Public gate methods
+    void H(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::H_Function()); }
+    void X(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::X_Function()); }
+    void Z(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::Z_Function()); }
+    void Y(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::Y_Function()); }
+    void S(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::Phase_Function(QuantumGates::I)); }
+    void Sdg(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::Phase_Function(-1.0 * QuantumGates::I)); }
+    void T(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::Phase_Function(std::polar(1.0, M_PI/4.0))); }
+    void Tdg(int target_qubit) { applySingleQubitOp(target_qubit, QuantumGates::Phase_Function(std::polar(1.0, -M_PI/4.0))); }
+    void P(int target_qubit, const double theta) { applySingleQubitOp(target_qubit, QuantumGates::Phase_Function(std::polar(1.0, theta))); }
+    void Rz(int target_qubit, const double theta) { applySingleQubitOp(target_qubit, QuantumGates::Rz_Function(theta)); }
+    void Rx(int target_qubit, const double theta) { applySingleQubitOp(target_qubit, QuantumGates::Rx_Function(theta)); }
+    void Ry(int target_qubit, const double theta) { applySingleQubitOp(target_qubit, QuantumGates::Ry_Function(theta)); }
+    void U(int target_qubit, const std::array<std::complex<double>,4> &matrix) { applySingleQubitOp(target_qubit, QuantumGates::Matrix_Function(matrix)); }
+
+    void CX(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::X_Function()); }
+    void CZ(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Z_Function()); }
+    void CH(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::H_Function()); }
+    void CY(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Y_Function()); }
+    void CS(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Phase_Function(QuantumGates::I)); }
+    void CSdg(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Phase_Function(-1.0 * QuantumGates::I)); }
+    void CT(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Phase_Function(std::polar(1.0, M_PI/4.0))); }
+    void CTdg(int control_qubit, int target_qubit) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Phase_Function(std::polar(1.0, -M_PI/4.0))); }
+    void CP(int control_qubit, int target_qubit, const double theta) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Phase_Function(std::polar(1.0, theta))); }
+    void CRx(int control_qubit, int target_qubit, const double theta) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Rx_Function(theta)); }
+    void CRy(int control_qubit, int target_qubit, const double theta) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Ry_Function(theta)); }
+    void CRz(int control_qubit, int target_qubit, const double theta) { applyControlledQubitOp(control_qubit, target_qubit, QuantumGates::Rz_Function(theta)); }
+
+    void SWAP(int qubit_1, int qubit_2) { applyTwoQubitOp(qubit_1, qubit_2, QuantumGates::SWAP_Function()); }
+    void iSWAP(int qubit_1, int qubit_2) { applyTwoQubitOp(qubit_1, qubit_2, QuantumGates::iSWAP_Function()); }
+
+    //destructive measurement
+    std::string collapse(){
+        std::array<double, SIZE> cumulative;
+        double total = 0.0;
+        for(size_t i=0; i<SIZE; i++) cumulative[i] = total += std::norm(state_vector[i]);
+        size_t index = sample(cumulative, total);
+        resetAll(index);
+        return QuantumVisualization::basisString(index, N);
+    }
+
+    //measurement for multiple runs
+    std::map<std::string,int> run(int num_shots){
+        std::array<double, SIZE> cumulative;
+        double total = 0.0;
+        for(size_t i=0; i<SIZE; i++) cumulative[i] = total += std::norm(state_vector[i]);
+        std::array<int, SIZE> hits = {};
+        for(int shot=0; shot<num_shots; shot++) hits[sample(cumulative, total)]++;
+        std::map<std::string,int> result;
+        for(size_t i=0; i<SIZE; i++) if(hits[i]) result[QuantumVisualization::basisString(i, N)] = hits[i];
+        return result;
+    }
+
+    //destructive measurement of a single qubit
+    int measure_single_qubit(int qubit){
+        int measurement = 0;
+        dispatch(qubit, [&](auto q){
+            constexpr size_t bit = size_t(1) << decltype(q)::value;
+            double prob_of_one = 0.0;
+            repeat<SIZE/2>([&](size_t k){ prob_of_one += std::norm(state_vector[insertZero<decltype(q)::value>(k) | bit]); });
+            measurement = std::bernoulli_distribution(std::min(1.0, prob_of_one))(generator());
+            double scale = 1.0 / std::sqrt(measurement ? prob_of_one : 1.0 - prob_of_one);
+            size_t kept = measurement ? bit : 0;
+            repeat<SIZE/2>([&](size_t k){
+                size_t i = insertZero<decltype(q)::value>(k);
+                state_vector[i | kept] *= scale;
+                state_vector[i | (bit ^ kept)] = 0.0;
+            });
+        });
+        return measurement;
+    }
+
+    //destructive measurement of a range of qubits, in the order given
+    std::string measure_range_of_qubits(const std::vector<int> &qubits){
+        size_t mask = checkedMask(qubits);
+        std::vector<double> weights = maskedMarginal(mask);
+        std::vector<double> cumulative(weights.size());
+        double total = 0.0;
+        for(size_t i=0; i<weights.size(); i++) cumulative[i] = total += weights[i];
+        size_t outcome = sample(cumulative, total);
+        size_t measurement = QuantumBits::depositBits(outcome, mask);
+        double scale = 1.0 / std::sqrt(weights[outcome]);
+        for(size_t i=0; i<SIZE; i++){
+            if((i & mask) == measurement) state_vector[i] *= scale;
+            else state_vector[i] = 0.0;
+        }
+        return rangeString(measurement, qubits);
+    }
+
+    //measurement of a subset of qubits for multiple runs
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits){
+        size_t mask = checkedMask(qubits);
+        std::vector<double> cumulative = maskedMarginal(mask);
+        for(size_t i=1; i<cumulative.size(); i++) cumulative[i] += cumulative[i-1];
+        std::vector<int> hits(cumulative.size(), 0);
+        for(int shot=0; shot<num_shots; shot++) hits[sample(cumulative, cumulative.back())]++;
+        std::map<std::string,int> result;
+        for(size_t i=0; i<hits.size(); i++) if(hits[i]) result[rangeString(QuantumBits::depositBits(i, mask), qubits)] = hits[i];
+        return result;
+    }
+
+    void reset(int qubit){
+        if(measure_single_qubit(qubit) == 1) X(qubit);
+    }
+
+    void resetAll(int index){
+        if(index < 0 || (size_t)index >= SIZE) throw std::out_of_range("Basis state index out of range.");
+        state_vector.fill(0.0);
+        state_vector[index] = 1.0;
+    }
+
+    double expectZ(const std::vector<int> &q) const {
+        //Z.Z = I, so a qubit listed twice cancels out of the parity
+        size_t mask = 0;
+        for(int j: q) mask ^= checkedMask({j});
+        double expect = 0.0;
+        for(size_t i=0; i<SIZE; i++) expect += QuantumBits::parity(i & mask) ? -std::norm(state_vector[i]) : std::norm(state_vector[i]);
+        return expect;
+    }
+
+    //expectation value of a weighted sum of Pauli strings, <P> = sum_i conj(a[i^x]) i^|x&z| (-1)^|i&z| a[i]
+    double expectation(const Observable &observable) const {
+        double expect = observable.getIdentityCoefficient();
+        static const std::complex<double> powers_of_i[4] = {{1.0, 0.0}, {0.0, 1.0}, {-1.0, 0.0}, {0.0, -1.0}};
+        for(const PauliTerm &term: observable.getTerms()){
+            if(((term.x_mask | term.z_mask) >> N) != 0) throw std::out_of_range("Observable acts on qubits out of range.");
+            std::complex<double> sum = 0.0;
+            for(size_t i=0; i<SIZE; i++){
+                std::complex<double> product = std::conj(state_vector[i ^ term.x_mask]) * state_vector[i];
+                sum += QuantumBits::parity(i & term.z_mask) ? -product : product;
+            }
+            expect += term.coefficient * (powers_of_i[QuantumBits::popcount(term.x_mask & term.z_mask) & 3] * sum).real();
+        }
+        return expect;
+    }
+
+    //In-memory copies of the amplitudes
+    std::vector<std::complex<double>> exportState() const {
+        return std::vector<std::complex<double>>(state_vector.begin(), state_vector.end());
+    }
+
+    void importState(const std::vector<std::complex<double>> &amplitudes){
+        if(amplitudes.size() != SIZE) throw std::invalid_argument("State has " + std::to_string(amplitudes.size()) + " amplitudes, circuit has " + std::to_string(N) + " qubits.");
+        std::copy(amplitudes.begin(), amplitudes.end(), state_vector.begin());
+    }
+
+    void printState() const { QuantumVisualization::printState(exportState(), N); }
+};
+
+#endif
@@ -11,9 +11,31 @@ public:
     //Constructor
     QuantumCircuitMPI(int n);
 
+    //only rank 0 holds the full state, so only rank 0 writes it
+    void saveState(const string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    //every rank transforms the slices in its part of the state, rank 0 alone if the
+    //register reaches into the bits that select the rank
+    void QFT(const vector<int> &qubits, bool inverse = false) override;
+
+    unique_ptr<QuantumCircuitBase> clone() override;
+    //with another MPI circuit every rank reduces its slice of both states, otherwise
+    //rank 0 computes the product; every rank gets the result
+    complex<double> innerProduct(QuantumCircuitBase &other) override;
+    double stateNorm() override;
+    complex<double> amplitude(size_t index) override;
+
 private:
     void applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op) override;
     void applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op) override;
+    //every rank rotates its part of the state, the parts are cut above the highest X/Y qubit
+    //so that both amplitudes of a pair land on the same rank
+    void applyPauliRotation(size_t x_mask, size_t z_mask, double theta) override;
+    vector<double> zParityExpectations(const vector<size_t> &z_masks) override;
+    //local histograms summed with one Allreduce, every rank gets the marginal
+    vector<double> maskedMarginal(size_t mask) override;
+
+    //splits rank 0's state evenly over all ranks, returns the global index of local_buf[0]
+    size_t scatterState(vector<complex<double>> &local_buf);
 };
 
 #endif
\ No newline at end of file
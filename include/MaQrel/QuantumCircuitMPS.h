@@ -0,0 +1,105 @@
+#ifndef QUANTUMCIRCUITMPS_H
+#define QUANTUMCIRCUITMPS_H
+
+#include <array>
+#include <random>
+#include "QuantumCircuitBase.h"
+
+//State kept as a matrix product state, one tensor per qubit with qubit 0 on the left.
+//Memory and gate cost grow with the bond dimension instead of 2^n, so shallow or
+//1-D local circuits scale to hundreds of qubits. Two-qubit gates are applied on
+//neighbouring sites (other pairs are swapped together first) and split again with an
+//SVD that keeps at most max_bond_dim singular values and drops the smallest ones while
+//their total weight stays below cutoff.
+class QuantumCircuitMPS : public QuantumCircuitBase {
+public:
+    //Constructor
+    QuantumCircuitMPS(int n, int max_bond_dim = 64, double cutoff = 1e-12);
+
+    //sum of the discarded weights of every truncation so far, 1 - fidelity is at most about this
+    double getTruncationError() const { return truncation_error; }
+    //bond dimension between qubit and qubit+1
+    int getBondDimension(int qubit) const;
+    int getMaxBondDimension() const;
+
+    //applied gate by gate, the bond dimension limits the entanglement it can build anyway
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    std::string measure_range_of_qubits(const std::vector<int> &qubits) override;
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits) override;
+    void resetAll(int index) override;
+    double expectZ(const std::vector<int> &q) override;
+    double expectation(const Observable &observable) override;
+
+    //contracts the MPS into a full state vector, only for small qubit counts
+    std::vector<std::complex<double>> toStateVector();
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    std::vector<std::complex<double>> exportState() override;
+    //factorised with SVDs under the same truncation as the gates
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+    //contracted site by site when other is an MPS too, O(n chi^3) instead of O(2^n)
+    std::complex<double> innerProduct(QuantumCircuitBase &other) override;
+    double stateNorm() override;
+    //one row of every site, O(n chi^2)
+    std::complex<double> amplitude(size_t index) override;
+
+    void printState() override;
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+protected:
+    void applySingleQubitOp(int target_qubit, std::function<void(std::complex<double>&,std::complex<double>&)> op) override;
+    void applyTwoQubitOp(int qubit_1, int qubit_2, std::function<void(std::complex<double>&,std::complex<double>&, std::complex<double>&,std::complex<double>&)> op) override;
+    void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    //exact, one environment per outcome of the qubits swept so far
+    std::vector<double> maskedMarginal(size_t mask) override;
+
+private:
+    //toStateVector and friends refuse anything larger
+    static constexpr int MAX_DENSE_QUBITS = 30;
+
+    using Matrix2 = std::array<std::complex<double>,4>;  //row major, |0>,|1>
+    using Matrix4 = std::array<std::complex<double>,16>; //row major, index 2*bit(first)+bit(second)
+
+    //tensor A[l][s][r] stored at (l*2+s)*right+r
+    struct Site {
+        int left = 1;
+        int right = 1;
+        std::vector<std::complex<double>> data;
+    };
+
+    std::vector<Site> sites;
+    int max_bond_dim;
+    double cutoff;
+    double truncation_error = 0.0;
+    //orthogonality center, sites left of it are left canonical and sites right of it right canonical
+    int center = 0;
+
+    void checkQubit(int qubit) const;
+    void checkDense() const;
+    void resetTo(const std::vector<int> &bits);
+    //projective measurement without touching the diagram
+    int measureQubit(int qubit);
+
+    void applyMatrix(int qubit, const Matrix2 &u);
+    //gate on any two qubits, ordered (qubit_1, qubit_2)
+    void applyMatrix(int qubit_1, int qubit_2, const Matrix4 &u);
+    //gate on sites left and left+1 ordered (left, left+1), truncating the new bond
+    void applyAdjacent(int left, const Matrix4 &u);
+    void moveCenter(int qubit);
+
+    //<psi| ops |psi> with ops[q] == nullptr for the identity
+    std::complex<double> expectOperators(const std::vector<const Matrix2*> &ops);
+    //sequential sampling of every qubit from the left
+    std::vector<int> sampleBits(std::mt19937_64 &gen);
+    std::string bitString(const std::vector<int> &bits) const;
+};
+
+#endif
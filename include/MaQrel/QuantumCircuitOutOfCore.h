@@ -0,0 +1,94 @@
+#ifndef QUANTUMCIRCUITOUTOFCORE_H
+#define QUANTUMCIRCUITOUTOFCORE_H
+
+#include "QuantumCircuitBase.h"
+
+//State vector kept in a file (in the snapshot layout) instead of memory. The file is
+//streamed through memory in chunks of 2^chunk_qubits amplitudes. Gates are queued and
+//applied together in one sweep over the file; gates on qubits above the chunk are
+//handled by loading the paired chunks together. The backing file is deleted when the
+//circuit is destroyed, use saveState to keep a state.
+class QuantumCircuitOutOfCore : public QuantumCircuitBase {
+public:
+    //Constructor
+    QuantumCircuitOutOfCore(int n, const std::string &backing_file, int chunk_qubits = 22);
+    ~QuantumCircuitOutOfCore();
+    QuantumCircuitOutOfCore(const QuantumCircuitOutOfCore&) = delete;
+    QuantumCircuitOutOfCore& operator=(const QuantumCircuitOutOfCore&) = delete;
+
+    //applies every queued gate in a single sweep
+    void flush() override;
+    //number of sweeps over the file so far
+    size_t getSweepCount() const { return sweep_count; }
+
+    //one sweep running the FFT on every resident group, gate by gate if the register
+    //spans too many qubits above the chunk
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    std::string measure_range_of_qubits(const std::vector<int> &qubits) override;
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits) override;
+    void resetAll(int index) override;
+    double expectation(const Observable &observable) override;
+
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    //the whole state in memory, only for states that fit
+    std::vector<std::complex<double>> exportState() override;
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    //not supported, the copy would need a backing file of its own: saveState and loadState instead
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+
+    void printState() override;
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+protected:
+    void applySingleQubitOp(int target_qubit, std::function<void(std::complex<double>&,std::complex<double>&)> op) override;
+    void applyTwoQubitOp(int qubit_1, int qubit_2, std::function<void(std::complex<double>&,std::complex<double>&, std::complex<double>&,std::complex<double>&)> op) override;
+    void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    //one streaming pass, at most HISTOGRAM_MAX_QUBITS qubits
+    std::vector<double> maskedMarginal(size_t mask) override;
+
+private:
+    //at most this many qubits above the chunk per sweep, i.e. 4 chunks resident per buffer
+    static constexpr int MAX_GROUP_QUBITS = 2;
+
+    enum class OpKind { Single, Controlled, Two };
+    struct PendingOp {
+        OpKind kind;
+        int qubit_1; //target, control or first qubit
+        int qubit_2; //unused, target or second qubit
+        std::function<void(std::complex<double>&,std::complex<double>&)> op;
+        std::function<void(std::complex<double>&,std::complex<double>&,std::complex<double>&,std::complex<double>&)> two_qubit_op;
+    };
+
+    std::string backing_file;
+    int fd = -1;
+    int chunk_qubits;
+    size_t chunk_size;
+    size_t data_offset;
+    size_t sweep_count = 0;
+
+    std::vector<PendingOp> pending;
+    size_t pending_high_mask = 0; //qubits at or above chunk_qubits used by the queued gates
+    std::vector<std::complex<double>> buffers[2];
+
+    void enqueue(PendingOp op);
+    //Streams every group of chunks through body. A group is the set of chunks whose indices
+    //differ only in the high qubits of high_mask, laid out in the buffer so that those
+    //qubits follow the chunk qubits. body gets the buffer and the first chunk of the group.
+    void sweep(size_t high_mask, const std::function<void(std::complex<double>*, size_t)> &body, bool write_back);
+    //position of qubit inside a group buffer
+    int bufferQubit(int qubit, size_t high_mask) const;
+    void transferChunk(size_t chunk, std::complex<double> *buffer, bool store);
+    void resetTo(size_t index);
+    //indices drawn from the current distribution with two streaming passes
+    std::vector<size_t> sample(int num_shots);
+};
+
+#endif
@@ -3,15 +3,68 @@
 
 #include "QuantumCircuitBase.h"
 
+class QuantumThreadPool;
+
+//Gate kernels, reductions and the QFT run on the persistent QuantumThreadPool instead of an
+//OpenMP region per call. Gates acting only on the qubits below local_qubits are queued instead, and a
+//queue is applied in one pass where every block of 2^local_qubits amplitudes runs all
+//of its gates in order: the blocks are independent, so there is no barrier between the
+//gates and each block stays in cache. Everything that reads the state applies the queue first.
 class QuantumCircuitParallel : public QuantumCircuitBase {
 public:
-    //Constructor
+    //Constructor, on the shared pool unless given one that outlives the circuit
     QuantumCircuitParallel(int n);
+    QuantumCircuitParallel(int n, QuantumThreadPool &pool);
+
+    //slices of the state spread over the threads, or the butterflies when there are too few slices
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    void resetAll(int index) override;
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    std::vector<std::complex<double>> exportState() override;
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    //on the same pool
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+    //reductions on the pool, one partial sum per chunk so the result does not depend on the threads
+    std::complex<double> innerProduct(QuantumCircuitBase &other) override;
+    double stateNorm() override;
+    void printState() override;
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+    //applies the queued gates
+    void flush() override;
+    //gates below this qubit are queued, 0 when the state is too small to split
+    int getLocalQubits() const { return local_qubits; }
 
 private:
-// here we are overriding to include openMP
+    //largest block a queue is applied to, 2^12 amplitudes fit in L2
+    static constexpr int MAX_LOCAL_QUBITS = 12;
+    //amplitude pairs per chunk of a gate kernel
+    static constexpr size_t GRAIN = 1 << 12;
+
+    struct LocalOp {
+        int control; //-1 for single qubit ops
+        int target;
+        std::function<void(std::complex<double>&,std::complex<double>&)> op;
+    };
+
+    QuantumThreadPool &pool;
+    int local_qubits;
+    std::vector<LocalOp> pending;
+
+    //gate kernels on the thread pool
     void applySingleQubitOp(int target_qubit, std::function<void(std::complex<double>&,std::complex<double>&)> op) override; 
     void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op) override;
+    void applyTwoQubitOp(int qubit_1, int qubit_2, std::function<void(std::complex<double>&,std::complex<double>&, std::complex<double>&,std::complex<double>&)> op) override;
+    void applyPauliRotation(size_t x_mask, size_t z_mask, double theta) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    std::vector<double> maskedMarginal(size_t mask) override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef QUANTUMCIRCUITSOA_H
+#define QUANTUMCIRCUITSOA_H
+
+#include <vector>
+#include <array>
+#include "QuantumCircuitBase.h"
+
+//Serial state vector with the real and imaginary parts in two separate arrays instead of
+//interleaved std::complex<double>. A gate turns its lambda into a matrix once and runs
+//over contiguous runs of re[] and im[], so the complex products are plain multiply-adds
+//that vectorise without shuffles (build with optimisation, e.g. make OPT=-O3). Diagonal
+//gates only scale. The amplitudes are converted to complex numbers at the API boundary
+//only: exportState/importState, amplitude(), snapshots, printing and the QFT, which runs
+//the FFT on an interleaved copy.
+class QuantumCircuitSoA : public QuantumCircuitBase {
+public:
+    //Constructor
+    QuantumCircuitSoA(int n);
+
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    std::string measure_range_of_qubits(const std::vector<int> &qubits) override;
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits) override;
+    void resetAll(int index) override;
+    //the rotated groups are measured on a copy of re[] and im[]
+    double expectation(const Observable &observable) override;
+
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    std::vector<std::complex<double>> exportState() override;
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+    double stateNorm() override;
+    std::complex<double> amplitude(size_t index) override;
+
+    void printState() override;
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+protected:
+    void applySingleQubitOp(int target_qubit, std::function<void(std::complex<double>&,std::complex<double>&)> op) override;
+    void applyTwoQubitOp(int qubit_1, int qubit_2, std::function<void(std::complex<double>&,std::complex<double>&, std::complex<double>&,std::complex<double>&)> op) override;
+    void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op) override;
+    void applyPauliRotation(size_t x_mask, size_t z_mask, double theta) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    std::vector<double> maskedMarginal(size_t mask) override;
+
+private:
+    std::vector<double> re, im;
+
+    //u on the pairs (first+m, first+m+half) for m < length
+    void matrixRun(size_t first, size_t length, size_t half, const std::array<std::complex<double>,4> &u);
+    //u on the pairs (i, i+half) with i the k-th index with zeros at low and high (-1 for none)
+    //and set_bits set, for k < count
+    void matrixPairs(size_t count, int low, int high, size_t set_bits, size_t half, const std::array<std::complex<double>,4> &u);
+    //body(i) for the index i of every amplitude with both qubits 0, in contiguous runs when the lower qubit allows
+    template<class F>
+    void forEachQuartet(int qubit_1, int qubit_2, F body) const;
+    //probabilities |a_i|^2 of the whole state
+    std::vector<double> probabilities() const;
+    //keeps the amplitudes with (i & mask) == value, scaled by 1/norm_factor
+    void project(size_t mask, size_t value, double norm_factor);
+};
+
+#endif
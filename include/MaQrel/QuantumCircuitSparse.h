@@ -0,0 +1,109 @@
+#ifndef QUANTUMCIRCUITSPARSE_H
+#define QUANTUMCIRCUITSPARSE_H
+
+#include <cstdint>
+#include "QuantumCircuitBase.h"
+
+//Keeps only the nonzero amplitudes, as basis index -> amplitude in an open addressing
+//hash table, so gates cost O(nonzeros) instead of O(2^n). Wide circuits with few
+//nonzero amplitudes (GHZ, basis state arithmetic, oracles) fit up to 63 qubits.
+//Amplitudes with magnitude below threshold are dropped after every gate. Once more
+//than crossover * 2^n amplitudes are nonzero the state moves to the dense state_vector
+//and the base class kernels take over; measurements move it back when it thins out.
+class QuantumCircuitSparse : public QuantumCircuitBase {
+public:
+    //Constructor
+    QuantumCircuitSparse(int n, double crossover = 1.0/16, double threshold = 1e-12);
+
+    size_t getNonzeroCount() const;
+    bool isDense() const { return dense; }
+
+    //one FFT per distinct value of the other qubits, the register itself usually fills up
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    std::string measure_range_of_qubits(const std::vector<int> &qubits) override;
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits) override;
+    void resetAll(int index) override;
+    double expectation(const Observable &observable) override;
+
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    std::vector<std::complex<double>> exportState() override;
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+    //while sparse only the stored amplitudes are visited, other is read with amplitude()
+    std::complex<double> innerProduct(QuantumCircuitBase &other) override;
+    double stateNorm() override;
+    std::complex<double> amplitude(size_t index) override;
+
+    void printState() override; //only the nonzero amplitudes while sparse
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+protected:
+    void applySingleQubitOp(int target_qubit, std::function<void(std::complex<double>&,std::complex<double>&)> op) override;
+    void applyTwoQubitOp(int qubit_1, int qubit_2, std::function<void(std::complex<double>&,std::complex<double>&, std::complex<double>&,std::complex<double>&)> op) override;
+    void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op) override;
+    //every stored amplitude goes to itself and to its partner index ^ x_mask
+    void applyPauliRotation(size_t x_mask, size_t z_mask, double theta) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    std::vector<double> maskedMarginal(size_t mask) override;
+
+private:
+    //the dense layout is never used above this, the state stays sparse instead
+    static constexpr int MAX_DENSE_QUBITS = 30;
+
+    //Linear probing table with Fibonacci hashing, kept at most half full. Entries are
+    //never erased, a gate builds the next table and the survivors are copied back.
+    class AmplitudeTable {
+    public:
+        static constexpr size_t EMPTY = SIZE_MAX; //never a basis index, n < 64
+
+        void clear();
+        void reserve(size_t entries);
+        size_t size() const { return count; }
+        //inserts a zero amplitude if key is missing
+        std::complex<double>& at(size_t key);
+        const std::complex<double>* find(size_t key) const;
+
+        template<class F>
+        void forEach(F f) const {
+            for(size_t slot=0; slot<keys.size(); slot++){
+                if(keys[slot] != EMPTY) f(keys[slot], values[slot]);
+            }
+        }
+
+    private:
+        std::vector<size_t> keys;
+        std::vector<std::complex<double>> values;
+        size_t count = 0;
+        int shift = 64;
+
+        size_t slotOf(size_t key) const { return (key * 0x9E3779B97F4A7C15ULL) >> shift; }
+        void rehash(size_t capacity);
+    };
+
+    AmplitudeTable table, scratch;
+    bool dense = false;
+    double crossover;
+    double threshold;
+
+    //copies scratch back into table without the amplitudes below threshold
+    void prune();
+    void toDense();
+    void toSparse();
+    //moves to the dense layout if the table got too full
+    void checkDensity();
+    //moves back to the sparse layout after a measurement thinned the state out
+    void checkSparsity();
+    void checkQubit(int qubit) const;
+    //nonzero (index, probability) pairs, sorted by index
+    std::vector<std::pair<size_t,double>> probabilities() const;
+    std::vector<std::complex<double>> denseCopy() const;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef QUANTUMCIRCUITSTABILIZER_H
+#define QUANTUMCIRCUITSTABILIZER_H
+
+#include <cstdint>
+#include <random>
+#include "QuantumCircuitBase.h"
+
+//Clifford circuits on a stabilizer tableau (Aaronson-Gottesman), O(n) per gate and
+//O(n^2) per measurement instead of O(2^n). Rows are bit packed into 64-bit words so
+//row products are plain word loops. Non-Clifford gates throw invalid_argument.
+class QuantumCircuitStabilizer : public QuantumCircuitBase {
+public:
+    //Constructor
+    QuantumCircuitStabilizer(int n);
+
+    //Clifford gates
+    void H(int target_qubit) override;
+    void X(int target_qubit) override;
+    void Y(int target_qubit) override;
+    void Z(int target_qubit) override;
+    void S(int target_qubit) override;
+    void Sdg(int target_qubit) override;
+    void CX(int control_qubit, int target_qubit) override;
+    void CY(int control_qubit, int target_qubit) override;
+    void CZ(int control_qubit, int target_qubit) override;
+    void SWAP(int qubit_1, int qubit_2) override;
+    void iSWAP(int qubit_1, int qubit_2) override;
+    //only accepted when the angle makes them Clifford (multiples of pi/2, pi for CP)
+    void P(int target_qubit, const double theta) override;
+    void Rz(int target_qubit, const double theta) override;
+    void Rx(int target_qubit, const double theta) override;
+    void Ry(int target_qubit, const double theta) override;
+    void CP(int control_qubit, int target_qubit, const double theta) override;
+    //never Clifford
+    void T(int target_qubit) override;
+    void Tdg(int target_qubit) override;
+    void CH(int control_qubit, int target_qubit) override;
+    void CS(int control_qubit, int target_qubit) override;
+    void CSdg(int control_qubit, int target_qubit) override;
+    void CT(int control_qubit, int target_qubit) override;
+    void CTdg(int control_qubit, int target_qubit) override;
+    void CRx(int control_qubit, int target_qubit, const double theta) override;
+    void CRy(int control_qubit, int target_qubit, const double theta) override;
+    void CRz(int control_qubit, int target_qubit, const double theta) override;
+    void U(int target_qubit, const std::array<std::complex<double>,4> &matrix) override;
+    //only Clifford on a single qubit, where it is H
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    std::string measure_range_of_qubits(const std::vector<int> &qubits) override;
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits) override;
+    void resetAll(int index) override;
+    double expectZ(const std::vector<int> &q) override;
+    double expectation(const Observable &observable) override;
+
+    //+1, -1 or 0 for a Pauli string given as bit vectors (bit q of word q/64), Y sets both
+    int pauliExpectation(const std::vector<uint64_t> &x_bits, const std::vector<uint64_t> &z_bits);
+
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    std::vector<std::complex<double>> exportState() override;
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+    void printState() override; //prints the stabilizer generators
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+protected:
+    //only for multiples of pi/2, then the gate ladder is Clifford
+    void applyPauliRotation(size_t x_mask, size_t z_mask, double theta) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    //uniform over the projection of the outcome space onto the mask
+    std::vector<double> maskedMarginal(size_t mask) override;
+
+private:
+    //rows 0..n-1 destabilizers, n..2n-1 stabilizers, 2n scratch
+    size_t words; //64-bit words per row, padded to a multiple of 4
+    std::vector<uint64_t> xs, zs;
+    std::vector<uint8_t> phases;
+    //only while building the sample space: which random outcomes each row phase depends on
+    size_t dep_words = 0;
+    size_t dep_variables = 0;
+    std::vector<uint64_t> deps;
+
+    //Measuring every qubit gives outcome = base XOR (sum of a random subset of generators).
+    //Built once per state and reused by every shot.
+    struct SampleSpace {
+        bool valid = false;
+        std::vector<uint64_t> base;
+        std::vector<std::vector<uint64_t>> generators;
+    } sample_space;
+
+    uint64_t* xRow(size_t row) { return xs.data() + row*words; }
+    uint64_t* zRow(size_t row) { return zs.data() + row*words; }
+    bool xBit(size_t row, int q) const { return (xs[row*words + (q>>6)] >> (q&63)) & 1; }
+    bool zBit(size_t row, int q) const { return (zs[row*words + (q>>6)] >> (q&63)) & 1; }
+
+    void checkQubit(int qubit) const;
+    void checkPair(int qubit_1, int qubit_2) const;
+    [[noreturn]] void notClifford(const std::string &gate) const;
+    //number of quarter turns when theta is a multiple of pi/2, throws otherwise
+    int quarterTurns(const std::string &gate, double theta) const;
+
+    //tableau updates without touching the diagram
+    void applyH(int q);
+    void applyS(int q);
+    void applySdg(int q);
+    void applyPauli(int q, bool x, bool z);
+    void applyCX(int c, int t);
+    void applyCZ(int c, int t);
+    void applySwap(int a, int b);
+
+    void resetTableau();
+    void rowCopy(size_t target, size_t source);
+    void rowClear(size_t row);
+    bool anticommutes(size_t row, const std::vector<uint64_t> &x_bits, const std::vector<uint64_t> &z_bits) const;
+    //row h becomes row i * row h with the phase tracked mod 4
+    void rowsum(size_t h, size_t i);
+    //CHP measurement, a random outcome is drawn unless forced is 0 or 1
+    int measure(int qubit, int forced = -1);
+    void buildSampleSpace();
+    std::vector<uint64_t> sampleOutcome(std::mt19937_64 &gen);
+    std::string outcomeString(const std::vector<uint64_t> &outcome) const;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef QUANTUMCIRCUITTENSORNETWORK_H
+#define QUANTUMCIRCUITTENSORNETWORK_H
+
+#include <vector>
+#include <functional>
+#include "QuantumCircuitBase.h"
+
+//Gates are recorded as a tensor network instead of being applied: one 4-leg tensor per
+//two-qubit gate, with the single qubit gates folded into the tensor that last touched
+//their qubit. An amplitude <x|C|psi> fixes the output legs to the bits of x and contracts
+//the network in a greedy order (cheapest pair of neighbours first). When an intermediate
+//would exceed 2^max_tensor_qubits amplitudes the most shared legs are sliced: every
+//assignment of the sliced legs is contracted on its own, all cores in parallel, and the
+//slices are summed. Memory grows with the width of the network rather than with 2^n, so
+//wide shallow circuits work for a few bitstrings, e.g. for cross-entropy benchmarking.
+//Everything else (measurements, expectations, printing) expands the state first and is
+//only available for small qubit counts.
+class QuantumCircuitTensorNetwork : public QuantumCircuitBase {
+public:
+    //Constructor
+    QuantumCircuitTensorNetwork(int n, int max_tensor_qubits = 24);
+
+    //tensors of the network, one per two-qubit gate plus the initial state
+    size_t getTensorCount() const { return tensors.size(); }
+    //slices and largest intermediate (log2 of its size) of the last contraction
+    size_t getSliceCount() const { return last_slices; }
+    int getLargestTensorQubits() const { return last_largest; }
+
+    //<x|C|psi> for every basis state x of indices in one pass over the slices
+    std::vector<std::complex<double>> amplitudes(const std::vector<size_t> &indices);
+    std::complex<double> amplitude(size_t index) override;
+
+    //applied gate by gate
+    void QFT(const std::vector<int> &qubits, bool inverse = false) override;
+
+    std::string collapse() override;
+    std::map<std::string,int> run(int num_shots) override;
+    int measure_single_qubit(int qubit) override;
+    std::string measure_range_of_qubits(const std::vector<int> &qubits) override;
+    std::map<std::string,int> run_range_of_qubits(int num_shots, const std::vector<int> &qubits) override;
+    //restarts the network from the basis state index
+    void resetAll(int index) override;
+    double expectation(const Observable &observable) override;
+
+    void saveState(const std::string &path, QuantumSnapshot::Precision precision = QuantumSnapshot::Precision::Double) override;
+    void loadState(const std::string &path) override;
+    //contracts with the output legs left open, only for small qubit counts
+    std::vector<std::complex<double>> exportState() override;
+    //restarts the network from one tensor holding the amplitudes
+    void importState(const std::vector<std::complex<double>> &amplitudes) override;
+    std::unique_ptr<QuantumCircuitBase> clone() override;
+
+    void printState() override;
+    void printProbabilities() override;
+    void displayGraph() override;
+    void displayHeatMap() override;
+
+protected:
+    void applySingleQubitOp(int target_qubit, std::function<void(std::complex<double>&,std::complex<double>&)> op) override;
+    void applyTwoQubitOp(int qubit_1, int qubit_2, std::function<void(std::complex<double>&,std::complex<double>&, std::complex<double>&,std::complex<double>&)> op) override;
+    void applyControlledQubitOp(int control_qubit, int target_qubit, std::function<void(std::complex<double>&, std::complex<double>&)> op) override;
+    std::vector<double> zParityExpectations(const std::vector<size_t> &z_masks) override;
+    std::vector<double> maskedMarginal(size_t mask) override;
+
+private:
+    //exportState refuses anything larger
+    static constexpr int MAX_DENSE_QUBITS = 30;
+
+    //every leg has dimension 2, bit k of an index into data is the value of legs[k]
+    struct Tensor {
+        std::vector<int> legs;
+        std::vector<std::complex<double>> data;
+    };
+
+    //Contraction order for a set of fixed legs: tensors 0..T-1 are the network, step s
+    //contracts two earlier tensors into tensor T+s
+    struct Plan {
+        std::vector<std::pair<int,int>> steps;
+        std::vector<int> sliced; //legs fixed per slice
+        std::vector<int> result_legs;
+        int largest = 0;
+    };
+
+    int max_tensor_qubits;
+    std::vector<Tensor> tensors;
+    int leg_count = 0;
+    //open output leg of every qubit and the tensor holding it
+    std::vector<int> wire;
+    std::vector<int> wire_tensor;
+
+    //set while a dense copy of the state sits in state_vector, the gates then act on it
+    bool dense_view = false;
+
+    size_t last_slices = 0;
+    int last_largest = 0;
+
+    void checkQubit(int qubit) const;
+    void checkDense() const;
+    //tensor over legs with the given 4x4 matrix, index 2*bit(qubit_1)+bit(qubit_2)
+    void addTwoQubitTensor(int qubit_1, int qubit_2, const std::array<std::complex<double>,16> &u);
+    //greedy order with the legs of fixed removed, slicing until no tensor exceeds 2^cap
+    Plan makePlan(const std::vector<bool> &fixed, int cap) const;
+    //contracts one slice, value[leg] is -1 for free legs
+    Tensor contractSlice(const Plan &plan, const std::vector<int> &value) const;
+    //runs body on the expanded state in state_vector; with keep the network restarts from
+    //whatever state body leaves there
+    void withDenseState(const std::function<void()> &body, bool keep = false);
+};
+
+#endif
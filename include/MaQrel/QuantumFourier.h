@@ -0,0 +1,45 @@
+#ifndef QUANTUMFOURIER_H
+#define QUANTUMFOURIER_H
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+
+//The QFT on a register is a DFT over the register value for every fixed value of the
+//other qubits, so it runs as one in-place radix-2 FFT per slice of the state.
+//qubits[k] is bit k of the register value x, the forward transform maps
+//|x> -> 2^{-k/2} sum_y e^{2 pi i x y / 2^k} |y>, the same as H/CP gates followed by the swaps.
+namespace QuantumFourier {
+
+    struct Plan {
+        std::vector<int> qubits;
+        int bits = 0;
+        size_t register_mask = 0;
+        //state offset of register value y
+        std::vector<size_t> offsets;
+        //state offset of register value bitreverse(y), the FFT input order
+        std::vector<size_t> reversed_offsets;
+        //e^{+-2 pi i j / 2^bits} for j < 2^{bits-1}
+        std::vector<std::complex<double>> twiddles;
+        double scale = 1.0;
+    };
+
+    Plan makePlan(const std::vector<int> &qubits, bool inverse);
+
+    size_t reverseBits(size_t value, int bits);
+    //register value of a basis index
+    size_t registerValue(size_t index, const Plan &plan);
+
+    //data holds the 2^bits register amplitudes in bit reversed order and is left
+    //transformed and normalised in natural order
+    void transform(std::complex<double> *data, const Plan &plan);
+    //butterflies of one stage, half is the distance between the two inputs
+    void butterflyStage(std::complex<double> *data, const Plan &plan, size_t half, size_t first, size_t last);
+
+    //the slice of state with the other qubits fixed to those of base, buffer is scratch space
+    void transformSlice(std::complex<double> *state, size_t base, const Plan &plan, std::vector<std::complex<double>> &buffer);
+    //every slice of size amplitudes, the register has to lie within them
+    void apply(std::complex<double> *state, size_t size, const Plan &plan);
+}
+
+#endif
@@ -2,6 +2,10 @@
 #define QUANTUMGATES_H
 #include <complex>
 #include <cmath>
+#include <array>
+#include <functional>
+#include <cstddef>
+#include "QuantumBits.h"
 
 //This contains the gate functions used for operating on the state vectior matrix
 namespace QuantumGates {
@@ -32,6 +36,16 @@ namespace QuantumGates {
         };
     }
 
+    //H*Sdg, takes the Y eigenbasis to the Z eigenbasis
+    inline auto YBasis_Function(){
+        return [](auto &a, auto &b){
+            std::complex<double> a_old = a;
+            std::complex<double> b_old = b;
+            a=(a_old-I*b_old)/std::sqrt(2);
+            b=(a_old+I*b_old)/std::sqrt(2);
+        };
+    }
+
     inline auto Phase_Function(const std::complex<double> &phase){
         return [=](auto &a, auto &b){
             b*=phase;
@@ -72,6 +86,44 @@ namespace QuantumGates {
         };
     }
 
+    //row major 2x2 matrix
+    inline auto Matrix_Function(const std::array<std::complex<double>,4> &u){
+        return [=](auto &a, auto &b){
+            std::complex<double> a_old = a;
+            std::complex<double> b_old = b;
+            a = u[0]*a_old + u[1]*b_old;
+            b = u[2]*a_old + u[3]*b_old;
+        };
+    }
+
+    //exp(-i theta/2 P) for a Pauli string with the masks of a PauliTerm (Y sets both).
+    //P|j> = i^{#Y} (-1)^{|j & z_mask|} |j ^ x_mask>, so the amplitudes mix in pairs:
+    //a is the amplitude of the global index j and b the one of j ^ x_mask
+    inline auto PauliRotation_Function(size_t x_mask, size_t z_mask, const double theta){
+        const std::complex<double> powers[4] = {1.0, I, -1.0, -I};
+        const double c = std::cos(theta/2.0);
+        const std::complex<double> s = -I*std::sin(theta/2.0)*powers[QuantumBits::popcount(x_mask & z_mask) % 4];
+        //the sign of j ^ x_mask relative to the sign of j
+        const double flip = QuantumBits::parity(x_mask & z_mask) ? -1.0 : 1.0;
+
+        return [=](size_t j, auto &a, auto &b){
+            std::complex<double> s_j = QuantumBits::parity(j & z_mask) ? -s : s;
+            std::complex<double> a_old = a;
+            a = c*a + flip*s_j*b;
+            b = c*b + s_j*a_old;
+        };
+    }
+
+    //the same for x_mask == 0, a phase on every amplitude
+    inline auto PauliPhase_Function(size_t z_mask, const double theta){
+        const std::complex<double> even = std::polar(1.0,-theta/2.0);
+        const std::complex<double> odd = std::polar(1.0,theta/2.0);
+
+        return [=](size_t j, auto &a){
+            a *= QuantumBits::parity(j & z_mask) ? odd : even;
+        };
+    }
+
     inline auto SWAP_Function(){
         return [](auto &a, auto &b, auto &c, auto &d){
             std::swap(b,c);
@@ -85,5 +137,31 @@ namespace QuantumGates {
             c = I*c;
         };
     }
+
+    //The gate functions are linear, so applying one to the basis states gives its matrix.
+    //Row major, |0> then |1>
+    inline std::array<std::complex<double>,4> singleQubitMatrix(const std::function<void(std::complex<double>&,std::complex<double>&)> &op){
+        std::array<std::complex<double>,4> u;
+        for(int c=0; c<2; c++){
+            std::complex<double> col[2] = {0.0, 0.0};
+            col[c] = 1.0;
+            op(col[0], col[1]);
+            u[c] = col[0];
+            u[2+c] = col[1];
+        }
+        return u;
+    }
+
+    //Row major with the argument order of applyTwoQubitOp, index 2*bit(qubit_1)+bit(qubit_2)
+    inline std::array<std::complex<double>,16> twoQubitMatrix(const std::function<void(std::complex<double>&,std::complex<double>&,std::complex<double>&,std::complex<double>&)> &op){
+        std::array<std::complex<double>,16> u;
+        for(int c=0; c<4; c++){
+            std::complex<double> col[4] = {0.0, 0.0, 0.0, 0.0};
+            col[c] = 1.0;
+            op(col[0], col[1], col[2], col[3]);
+            for(int r=0; r<4; r++) u[r*4+c] = col[r];
+        }
+        return u;
+    }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef QUANTUMHYBRID_H
+#define QUANTUMHYBRID_H
+
+#include <vector>
+#include <complex>
+#include <array>
+#include <cstddef>
+#include "QuantumProgram.h"
+
+//Schrodinger-Feynman simulation of a program on two halves of the register. Qubits
+//[0, split) and [split, n) each get their own state vector; a two-qubit gate across the
+//halves is cut into its Schmidt terms, sum_k c_k A_k (x) B_k (a controlled gate into
+//|0><0| (x) I + |1><1| (x) U, SWAP and iSWAP into four Pauli products). Every choice of
+//one term per cut gate is a path whose two half states are simulated independently,
+//and an amplitude is the sum over the paths of c * <x_low|low> <x_high|high>.
+//Memory is one pair of half states per thread, 2^split + 2^(n-split) amplitudes, but
+//the work doubles with every cut controlled gate. Paths run in parallel, one per thread
+//on serial kernels, and all of them start from the shared state before the first cut.
+class QuantumHybridSimulator {
+public:
+    struct Options {
+        int split = 0;                 //qubits below split form the lower half, 0 = n/2
+        int threads = 0;               //0 = omp_get_max_threads()
+        size_t max_paths = 1ULL << 24; //more paths than this are refused
+    };
+
+    QuantumHybridSimulator(const QuantumProgram &program, const Options &options);
+    explicit QuantumHybridSimulator(const QuantumProgram &program) : QuantumHybridSimulator(program, Options()) {}
+
+    int qubitCount() const { return qubit_count; }
+    int getSplit() const { return split; }
+    //gates across the halves
+    size_t cutCount() const { return cuts.size(); }
+    //product of the Schmidt ranks of the cut gates
+    size_t pathCount() const { return path_count; }
+
+    //amplitudes of the basis states indices, bit q of an index is qubit q
+    std::vector<std::complex<double>> amplitudes(const std::vector<size_t> &indices);
+    std::complex<double> amplitude(size_t index) { return amplitudes({index})[0]; }
+    //all 2^n amplitudes, only for registers small enough to hold them
+    std::vector<std::complex<double>> state();
+
+private:
+    //c * lower (x) upper, identities are skipped
+    struct Term {
+        std::complex<double> coefficient;
+        std::array<std::complex<double>,4> lower, upper;
+        bool lower_identity, upper_identity;
+    };
+    struct Cut {
+        int lower_qubit, upper_qubit; //within their halves
+        std::vector<Term> terms;
+    };
+    //gates of each half, qubits renumbered within the half
+    struct Segment {
+        std::vector<GateOp> lower, upper;
+    };
+    class HalfCircuit;
+
+    int qubit_count;
+    int split;
+    int threads;
+    size_t path_count = 1;
+    //segments[s] runs before cuts[s], the last segment after the last cut
+    std::vector<Segment> segments;
+    std::vector<Cut> cuts;
+
+    //the cut of op, with the Schmidt terms of its gate
+    static Cut cutOf(const GateOp &op, int split);
+    //runs path from the half states after the first segment, returns its coefficient
+    std::complex<double> runPath(size_t path, HalfCircuit &lower, HalfCircuit &upper, const HalfCircuit &lower_prefix, const HalfCircuit &upper_prefix) const;
+    //body(coefficient, lower, upper) for every path, from omp threads
+    template<class F>
+    void forEachPath(F body);
+};
+
+#endif
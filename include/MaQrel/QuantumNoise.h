@@ -0,0 +1,87 @@
+#ifndef QUANTUMNOISE_H
+#define QUANTUMNOISE_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+#include "QuantumProgram.h"
+#include "QuantumObservable.h"
+
+struct NoiseChannel {
+    enum class Type { Depolarizing, AmplitudeDamping };
+    Type type;
+    double probability; //p for depolarizing, gamma for amplitude damping
+};
+
+//Where the noise goes. Channels attached to gates act after every such gate,
+//depolarizing jointly on all of the gate's qubits (a random non-identity Pauli with
+//probability p) and amplitude damping on each of them. Channels attached to a qubit
+//act after every gate that touches it. Readout errors only affect the shot counts.
+class NoiseModel {
+public:
+    struct Site {
+        std::vector<int> qubits;
+        NoiseChannel channel;
+    };
+
+    //after every gate
+    void addDepolarizing(double p);
+    void addAmplitudeDamping(double gamma);
+    //after every gate of this kind
+    void addDepolarizing(GateKind kind, double p);
+    void addAmplitudeDamping(GateKind kind, double gamma);
+    //after every gate touching qubit
+    void addQubitDepolarizing(int qubit, double p);
+    void addQubitAmplitudeDamping(int qubit, double gamma);
+    //p01: a 0 is read as 1, p10: a 1 is read as 0
+    void setReadoutError(double p01, double p10);
+    void setReadoutError(int qubit, double p01, double p10);
+
+    //channels acting right after op
+    std::vector<Site> sitesAfter(const GateOp &op) const;
+    bool hasReadoutError() const;
+    //(p01, p10) for qubit
+    std::pair<double,double> readoutError(int qubit) const;
+    //throws when a per-qubit channel or readout error names a qubit >= qubit_count
+    void checkQubitCount(int qubit_count) const;
+
+private:
+    std::vector<NoiseChannel> all_gates;
+    std::map<GateKind, std::vector<NoiseChannel>> per_gate;
+    std::map<int, std::vector<NoiseChannel>> per_qubit;
+    std::pair<double,double> default_readout = {0.0, 0.0};
+    std::map<int, std::pair<double,double>> readout;
+};
+
+struct TrajectoryResult {
+    std::map<std::string,int> counts; //merged over every trajectory, with readout errors
+    std::vector<double> expectations; //one per observable, averaged over trajectories
+    int trajectories = 0;
+    int noiseless_trajectories = 0; //drew no error and shared the noiseless final state
+};
+
+//Monte Carlo wavefunction trajectories on the state-vector kernels. Depolarizing errors
+//are drawn up front, so each trajectory starts from the shared noiseless prefix state
+//at its first noise draw instead of replaying it. Trajectories run in parallel batches
+//with one state per thread; every trajectory has its own RNG stream derived from the
+//seed, so results do not depend on the thread count.
+class TrajectorySimulator {
+public:
+    TrajectorySimulator(const QuantumProgram &program, const NoiseModel &noise);
+
+    void setSeed(uint64_t seed) { this->seed = seed; }
+    //shots_per_trajectory shots are drawn from the final state of every trajectory
+    TrajectoryResult run(int num_trajectories, int shots_per_trajectory = 1, const std::vector<Observable> &observables = {});
+
+private:
+    QuantumProgram program;
+    NoiseModel noise;
+    uint64_t seed;
+    //noise sites after every op of the program
+    std::vector<std::vector<NoiseModel::Site>> sites;
+    //index of the first op followed by amplitude damping, size() if none
+    size_t first_damping;
+};
+
+#endif
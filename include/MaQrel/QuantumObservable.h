@@ -0,0 +1,61 @@
+#ifndef QUANTUMOBSERVABLE_H
+#define QUANTUMOBSERVABLE_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+//A weighted Pauli string. Bit q of x_mask/z_mask is set when the Pauli on qubit q
+//has an X/Z component, so X sets x_mask, Z sets z_mask and Y sets both.
+struct PauliTerm {
+    double coefficient;
+    size_t x_mask;
+    size_t z_mask;
+};
+
+//Weighted sum of Pauli strings, e.g. an Ising or molecular Hamiltonian
+class Observable {
+    std::vector<PauliTerm> terms;
+    double identity_coefficient = 0.0;
+    //(x_mask, z_mask) -> position in terms, so repeated strings are merged
+    std::map<std::pair<size_t,size_t>, int> term_index;
+
+    //qubit-wise commuting groups of term indices, rebuilt after every addTerm
+    mutable std::vector<std::vector<int>> groups;
+    mutable bool grouped = false;
+
+public:
+    Observable() = default;
+
+    //coefficient * paulis[k] acting on qubits[k], e.g. addTerm(0.5, "XZ", {0, 3})
+    void addTerm(double coefficient, const std::string &paulis, const std::vector<int> &qubits);
+    //pauli string written like the basis states, the rightmost character is qubit 0, e.g. "XIZ"
+    void addTerm(double coefficient, const std::string &pauli_string);
+
+    const std::vector<PauliTerm>& getTerms() const { return terms; }
+    double getIdentityCoefficient() const { return identity_coefficient; }
+    size_t size() const { return terms.size(); }
+
+    //Greedy partition into groups whose terms agree on every qubit they share,
+    //so one basis rotation turns the whole group diagonal
+    const std::vector<std::vector<int>>& qubitWiseGroups() const;
+};
+
+//Kernels helpers used by the backends to evaluate Z parities
+namespace PauliParity {
+
+    //histograms are only built for supports up to this many qubits unless the
+    //group has more terms than support qubits (then the transform always pays off)
+    constexpr int HISTOGRAM_MAX_QUBITS = 20;
+
+    //max_qubits caps that second case, e.g. at the qubits of one rank's slice
+    bool useHistogram(size_t num_masks, size_t support, int max_qubits = 64);
+    //in place Walsh-Hadamard transform, entry s becomes sum_i p_i (-1)^{|i&s|}
+    void walshHadamard(std::vector<double> &data);
+    //reads the parities of each mask out of a transformed histogram over support
+    std::vector<double> fromTransformed(const std::vector<double> &transformed, const std::vector<size_t> &z_masks, size_t support);
+}
+
+#endif
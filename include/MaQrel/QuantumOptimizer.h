@@ -0,0 +1,32 @@
+#ifndef QUANTUMOPTIMIZER_H
+#define QUANTUMOPTIMIZER_H
+
+#include <cstddef>
+#include "QuantumProgram.h"
+
+//Peephole pass over a recorded gate sequence. Every gate is compared with the earlier
+//gates on its qubits it commutes with (gates that act on each shared qubit through Z
+//type operators, e.g. phases and control qubits, or through X type or Y type ones):
+//  - self inverse pairs (H H, X X, CX CX, SWAP SWAP, ...) cancel
+//  - phase gates (Z, S, T, P and their inverses) merge into one P, controlled phases
+//    (CZ, CS, CT, CP, ...) into one CP, and same-axis rotations add their angles
+//  - rotations by a multiple of their period are dropped
+//The optimized program applies exactly the same unitary, global phase included.
+namespace QuantumOptimizer {
+
+    struct Report {
+        size_t input_gates = 0;
+        size_t output_gates = 0;
+        size_t cancelled = 0; //gates removed as inverse pairs
+        size_t merged = 0;    //gates folded into an earlier one
+        size_t dropped = 0;   //identity rotations removed
+        size_t removed() const { return input_gates - output_gates; }
+    };
+
+    //earlier gates sharing a qubit that a gate is compared with
+    constexpr int DEFAULT_WINDOW = 32;
+
+    QuantumProgram optimize(const QuantumProgram &program, Report *report = nullptr, int window = DEFAULT_WINDOW);
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef QUANTUMPREFIXCACHE_H
+#define QUANTUMPREFIXCACHE_H
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "QuantumProgram.h"
+
+class QuantumCircuitBase;
+
+//LRU cache of intermediate states keyed by the gate prefix that produced them from
+//|0...0>. A prefix is fingerprinted with a rolling hash over its ops, angles included
+//bit for bit, and checked op by op on a hit. run() resumes a program from the longest
+//cached prefix and caches the state where it diverged from the previous program, so a
+//parameter sweep that changes late angles replays only the ops after the change.
+//Cached states are shared and never written; resuming copies one into the circuit.
+//Safe to share between threads.
+class QuantumPrefixCache {
+public:
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t skipped_ops = 0; //ops not replayed thanks to a hit
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    using State = std::shared_ptr<const std::vector<std::complex<double>>>;
+
+    //memory_budget is in bytes, states larger than it are never cached
+    explicit QuantumPrefixCache(size_t memory_budget);
+
+    //Runs program on circuit, which has to be in |0...0> and have the program's qubit
+    //count. Returns the number of ops taken from the cache.
+    size_t run(const QuantumProgram &program, QuantumCircuitBase &circuit);
+    //also caches the state after every checkpoint_interval ops, 0 turns it off
+    void setCheckpointInterval(size_t ops) { checkpoint_interval = ops; }
+
+    //the longest cached prefix of program as (length, state), (0, nullptr) if none
+    std::pair<size_t, State> lookup(const QuantumProgram &program);
+    //caches the state after ops [0, length) of program
+    void insert(const QuantumProgram &program, size_t length, std::vector<std::complex<double>> state);
+
+    void clear();
+    Stats stats() const;
+    size_t memoryBudget() const { return memory_budget; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        int qubit_count;
+        std::vector<GateOp> prefix;
+        State state;
+        size_t bytes;
+    };
+
+    size_t memory_budget;
+    size_t checkpoint_interval = 0;
+    mutable std::mutex lock;
+    //most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    Stats counters;
+    //ops of the last program run, to find where the next one diverges
+    std::vector<GateOp> previous;
+
+    //fingerprints of the prefixes of every length, keys[0] is the empty prefix
+    static std::vector<uint64_t> prefixKeys(const QuantumProgram &program);
+    void evictFor(size_t bytes);
+};
+
+#endif
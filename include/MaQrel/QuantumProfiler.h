@@ -0,0 +1,86 @@
+#ifndef QUANTUMPROFILER_H
+#define QUANTUMPROFILER_H
+
+#include <map>
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <chrono>
+
+//Hot path instrumentation. Build the library with -DMAQREL_PROFILE (make PROFILE=1) to
+//record gate counts, kernel times, bytes touched, MPI traffic and, where perf_event_open
+//is allowed, cycles and LLC misses of the calling thread. Without the flag the recording
+//macros expand to nothing and the query functions below return empty reports.
+//Read the statistics while no circuit is running.
+namespace QuantumProfiler {
+
+    struct KernelStats {
+        uint64_t calls = 0;
+        double seconds = 0.0;
+        uint64_t bytes = 0;       //amplitude bytes read plus written
+        uint64_t cycles = 0;      //hardware counters, 0 when unavailable
+        uint64_t llc_misses = 0;
+        double bandwidth() const { return seconds > 0 ? bytes / seconds / 1e9 : 0.0; } //GB/s
+    };
+
+    struct CommStats {
+        uint64_t calls = 0;
+        double seconds = 0.0;
+        uint64_t bytes = 0;
+    };
+
+    struct Report {
+        std::map<std::string, uint64_t> gate_calls;
+        std::map<std::string, KernelStats> kernels;
+        std::map<std::string, CommStats> communication; //per MPI collective
+        bool hardware_counters = false;
+    };
+
+    //true when the library was built with MAQREL_PROFILE
+    bool enabled();
+    //whether perf_event_open counters could be opened on this machine
+    bool hardwareCountersAvailable();
+    void reset();
+    //statistics summed over every thread
+    Report report();
+    void printReport(std::ostream &out);
+    //Chrome trace format (chrome://tracing, Perfetto), only events recorded while tracing was on
+    void setTracing(bool on);
+    void writeTrace(const std::string &path);
+
+    //Recording, use the macros below
+    void countGate(const char *gate);
+
+    class KernelScope {
+        const char *kernel;
+        uint64_t bytes;
+        std::chrono::steady_clock::time_point start;
+        uint64_t start_cycles, start_misses;
+    public:
+        KernelScope(const char *kernel, uint64_t bytes);
+        ~KernelScope();
+    };
+
+    class CommScope {
+        const char *operation;
+        uint64_t bytes;
+        std::chrono::steady_clock::time_point start;
+    public:
+        CommScope(const char *operation, uint64_t bytes);
+        ~CommScope();
+    };
+}
+
+#ifdef MAQREL_PROFILE
+#define MAQREL_PROFILE_CONCAT_(a, b) a##b
+#define MAQREL_PROFILE_CONCAT(a, b) MAQREL_PROFILE_CONCAT_(a, b)
+#define MAQREL_PROFILE_GATE(gate) QuantumProfiler::countGate(gate)
+#define MAQREL_PROFILE_KERNEL(kernel, bytes) QuantumProfiler::KernelScope MAQREL_PROFILE_CONCAT(maqrel_kernel_, __LINE__)(kernel, bytes)
+#define MAQREL_PROFILE_COMM(operation, bytes) QuantumProfiler::CommScope MAQREL_PROFILE_CONCAT(maqrel_comm_, __LINE__)(operation, bytes)
+#else
+#define MAQREL_PROFILE_GATE(gate) ((void)0)
+#define MAQREL_PROFILE_KERNEL(kernel, bytes) ((void)0)
+#define MAQREL_PROFILE_COMM(operation, bytes) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef QUANTUMPROGRAM_H
+#define QUANTUMPROGRAM_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <complex>
+
+class QuantumCircuitBase;
+
+//Every gate of the QuantumCircuitBase API
+enum class GateKind {
+    H, X, Y, Z, S, Sdg, T, Tdg, P, Rx, Ry, Rz,
+    CX, CY, CZ, CH, CS, CSdg, CT, CTdg, CP, CRx, CRy, CRz,
+    SWAP, iSWAP
+};
+
+//One gate with its operands, qubit_2 is -1 for single qubit gates and theta is only
+//used by the parameterised ones. For controlled gates qubit_1 is the control.
+struct GateOp {
+    GateKind kind;
+    int qubit_1;
+    int qubit_2 = -1;
+    double theta = 0.0;
+};
+
+namespace QuantumGateInfo {
+    //1 or 2
+    int arity(GateKind kind);
+    bool hasAngle(GateKind kind);
+    //name of the gate method, e.g. "CX"
+    std::string name(GateKind kind);
+    //throws like the circuit would for operands outside qubit_count qubits
+    void check(const GateOp &op, int qubit_count);
+    //matrix of a single qubit op, row major with |0> then |1>
+    std::array<std::complex<double>,4> matrix(const GateOp &op);
+    //applies the op through the public gate method of the circuit
+    void apply(QuantumCircuitBase &circuit, const GateOp &op);
+}
+
+//A gate sequence that can be replayed on any backend, e.g. once per noise trajectory
+class QuantumProgram {
+    int qubit_count;
+    std::vector<GateOp> gate_ops;
+
+public:
+    QuantumProgram(int n);
+
+    int qubitCount() const { return qubit_count; }
+    size_t size() const { return gate_ops.size(); }
+    const std::vector<GateOp>& ops() const { return gate_ops; }
+    const GateOp& operator[](size_t i) const { return gate_ops[i]; }
+
+    //checks the operands and appends
+    QuantumProgram& add(const GateOp &op);
+
+    //applies ops [first, last) to circuit
+    void applyTo(QuantumCircuitBase &circuit, size_t first = 0, size_t last = SIZE_MAX) const;
+
+    //Builders with the same names as the circuit methods
+    QuantumProgram& H(int q) { return add({GateKind::H, q}); }
+    QuantumProgram& X(int q) { return add({GateKind::X, q}); }
+    QuantumProgram& Y(int q) { return add({GateKind::Y, q}); }
+    QuantumProgram& Z(int q) { return add({GateKind::Z, q}); }
+    QuantumProgram& S(int q) { return add({GateKind::S, q}); }
+    QuantumProgram& Sdg(int q) { return add({GateKind::Sdg, q}); }
+    QuantumProgram& T(int q) { return add({GateKind::T, q}); }
+    QuantumProgram& Tdg(int q) { return add({GateKind::Tdg, q}); }
+    QuantumProgram& P(int q, double theta) { return add({GateKind::P, q, -1, theta}); }
+    QuantumProgram& Rx(int q, double theta) { return add({GateKind::Rx, q, -1, theta}); }
+    QuantumProgram& Ry(int q, double theta) { return add({GateKind::Ry, q, -1, theta}); }
+    QuantumProgram& Rz(int q, double theta) { return add({GateKind::Rz, q, -1, theta}); }
+    QuantumProgram& CX(int c, int t) { return add({GateKind::CX, c, t}); }
+    QuantumProgram& CY(int c, int t) { return add({GateKind::CY, c, t}); }
+    QuantumProgram& CZ(int c, int t) { return add({GateKind::CZ, c, t}); }
+    QuantumProgram& CH(int c, int t) { return add({GateKind::CH, c, t}); }
+    QuantumProgram& CS(int c, int t) { return add({GateKind::CS, c, t}); }
+    QuantumProgram& CSdg(int c, int t) { return add({GateKind::CSdg, c, t}); }
+    QuantumProgram& CT(int c, int t) { return add({GateKind::CT, c, t}); }
+    QuantumProgram& CTdg(int c, int t) { return add({GateKind::CTdg, c, t}); }
+    QuantumProgram& CP(int c, int t, double theta) { return add({GateKind::CP, c, t, theta}); }
+    QuantumProgram& CRx(int c, int t, double theta) { return add({GateKind::CRx, c, t, theta}); }
+    QuantumProgram& CRy(int c, int t, double theta) { return add({GateKind::CRy, c, t, theta}); }
+    QuantumProgram& CRz(int c, int t, double theta) { return add({GateKind::CRz, c, t, theta}); }
+    QuantumProgram& SWAP(int a, int b) { return add({GateKind::SWAP, a, b}); }
+    QuantumProgram& iSWAP(int a, int b) { return add({GateKind::iSWAP, a, b}); }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef QUANTUMQASM_H
+#define QUANTUMQASM_H
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+class QuantumCircuitBase;
+
+//Streaming OpenQASM 2.0 front-end. Statements are read one at a time through a fixed
+//size buffer and applied to the circuit right away, only the gate definitions are kept,
+//so memory does not grow with the length of the file. qelib1.inc is built in; other
+//includes are read relative to the working directory.
+//
+//Registers are laid out in declaration order, qubit 0 is q[0] of the first qreg.
+//A measurement is held back until a later statement touches its qubit or reads its
+//classical bit, so the measurements at the end of a circuit can be sampled from the final
+//state instead of collapsing it.
+class QasmReader {
+public:
+    struct Stats {
+        size_t statements = 0;
+        size_t gates = 0;        //backend gate calls, after expanding gate definitions
+        size_t measurements = 0; //measure statements per qubit, held back ones included
+        double parse_seconds = 0.0;
+        double simulate_seconds = 0.0;
+    };
+
+    explicit QasmReader(std::istream &in);
+    ~QasmReader();
+    QasmReader(const QasmReader&) = delete;
+    QasmReader& operator=(const QasmReader&) = delete;
+
+    //qubits of all qregs, reads the declarations ahead of the first gate
+    int qubitCount();
+    //streams the rest of the program into circuit, which needs qubitCount() qubits.
+    //Parse and circuit errors are rethrown as runtime_error with the line number.
+    void run(QuantumCircuitBase &circuit);
+
+    //(qubit, classical bit) of the measurements still held back
+    std::vector<std::pair<int,int>> finalMeasurements() const;
+    //performs the held back measurements on the circuit
+    void measureFinal(QuantumCircuitBase &circuit);
+    //samples the held back measurements shots times without touching the state. Keys
+    //are the classical registers, the last creg leftmost and bit 0 rightmost, separated
+    //by spaces.
+    std::map<std::string,int> sampleFinal(QuantumCircuitBase &circuit, int shots, uint64_t seed = 0);
+    //current classical registers in the same format
+    std::string classicalBits() const;
+
+    const Stats& stats() const { return run_stats; }
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+    Stats run_stats;
+};
+
+#endif
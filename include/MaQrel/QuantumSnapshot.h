@@ -0,0 +1,74 @@
+#ifndef QUANTUMSNAPSHOT_H
+#define QUANTUMSNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+
+//Binary state vector snapshots. The file is a fixed header, the qubit map and
+//then the raw amplitudes starting on a page boundary, so it can be mapped and
+//used without any parsing.
+namespace QuantumSnapshot {
+
+    constexpr char MAGIC[8] = {'M','A','Q','R','E','L','S','V'};
+    constexpr uint32_t VERSION = 1;
+    constexpr size_t PAGE_ALIGNMENT = 4096;
+
+    //bytes per real component of an amplitude
+    enum class Precision : uint32_t { Single = 4, Double = 8 };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t qubit_count;
+        uint32_t precision;
+        uint32_t reserved;
+        uint64_t amplitude_offset; //byte offset of the first amplitude
+        uint64_t amplitude_count;
+        //followed by qubit_count int32 entries: bit k of an index holds logical qubit map[k]
+    };
+
+    //Header, qubit map and padding up to the first amplitude
+    std::vector<unsigned char> encodeHeader(int qubit_count, const std::vector<int> &qubit_map, Precision precision);
+
+    //Writes the state with large sequential writes
+    void write(const std::string &path, const std::vector<std::complex<double>> &state_vector, int qubit_count,
+               Precision precision = Precision::Double);
+    void write(const std::string &path, const std::vector<std::complex<double>> &state_vector, int qubit_count,
+               const std::vector<int> &qubit_map, Precision precision = Precision::Double);
+
+    //Read-only memory mapping of a snapshot file
+    class MappedSnapshot {
+        const unsigned char *data = nullptr;
+        size_t length = 0;
+        Header header;
+        std::vector<int> qubit_map;
+        std::vector<unsigned char> fallback; //used where mmap is not available
+
+        //checks the header and reads the qubit map
+        void readHeader();
+
+    public:
+        explicit MappedSnapshot(const std::string &path);
+        ~MappedSnapshot();
+        MappedSnapshot(const MappedSnapshot&) = delete;
+        MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+        int qubitCount() const { return header.qubit_count; }
+        Precision precision() const { return static_cast<Precision>(header.precision); }
+        size_t amplitudeCount() const { return header.amplitude_count; }
+        const std::vector<int>& qubitMap() const { return qubit_map; }
+        bool hasIdentityMap() const;
+
+        //zero-copy view of the amplitudes, only for double precision snapshots
+        const std::complex<double>* amplitudes() const;
+        //copies the amplitudes into state_vector in logical qubit order, widening single precision
+        void copyTo(std::vector<std::complex<double>> &state_vector) const;
+        //copies amplitudes [first, first+count) as stored, only for identity qubit maps
+        void copyRange(size_t first, size_t count, std::complex<double> *out) const;
+    };
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef QUANTUMTHREADPOOL_H
+#define QUANTUMTHREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstddef>
+
+//Persistent workers for the per-gate kernels, so a gate costs a wake-up instead of an
+//OpenMP fork/join. The calling thread works along. A loop is cut into chunks of grain
+//iterations, every participant gets a contiguous share and claims its chunks from the
+//front; once it runs dry it steals the remaining chunks of the others. Between loops the
+//workers spin for a while, then sleep until the next one.
+class QuantumThreadPool {
+public:
+    struct Options {
+        int threads = 0;         //participants including the caller, 0 = omp_get_max_threads()
+        //participant i is pinned to cpus[i % size] (Linux only), empty = not pinned. Participant 0
+        //is the calling thread, which the pool leaves alone: cpus[0] is the core to keep it on
+        std::vector<int> cpus;
+        size_t spin_iterations = 1 << 16; //polls before a worker goes to sleep
+    };
+
+    explicit QuantumThreadPool(const Options &options);
+    QuantumThreadPool() : QuantumThreadPool(Options()) {}
+    ~QuantumThreadPool();
+    QuantumThreadPool(const QuantumThreadPool&) = delete;
+    QuantumThreadPool& operator=(const QuantumThreadPool&) = delete;
+
+    //the pool used by QuantumCircuitParallel, created on first use
+    static QuantumThreadPool& shared();
+    //options of the shared pool, only before its first use
+    static void configureShared(const Options &options);
+
+    int size() const { return participants; }
+
+    //body(begin, end) over [0, count) in chunks of grain. Runs inline when there is a
+    //single chunk or when called from inside a pool loop. One loop at a time, concurrent
+    //callers queue up. The first exception of body is rethrown.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+private:
+    //each participant's share of chunks, on its own cache line
+    struct alignas(64) Share {
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+    };
+
+    int participants;
+    size_t spin_iterations;
+    std::vector<std::thread> workers;
+    std::vector<Share> shares;
+
+    //the current loop
+    const std::function<void(size_t, size_t)> *body = nullptr;
+    size_t count = 0;
+    size_t grain = 1;
+    std::atomic<size_t> epoch{0};
+    std::atomic<int> active{0};
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    std::mutex dispatch_lock; //one loop at a time
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> stopping{false};
+
+    void workerLoop(int id, int cpu);
+    //own chunks first, then everybody else's
+    void participate(int id);
+};
+
+#endif
@@ -4,12 +4,27 @@
 #include <string>
 #include <complex>
 #include <vector>
+#include <utility>
 
 namespace QuantumVisualization{
 
     constexpr double PROB_THRESHOLD = 0.01;
+    //most states printed or plotted, whatever the qubit count
+    constexpr size_t MAX_LISTED_STATES = 64;
+    //the heat map shows at most 2^MAX_HEATMAP_QUBITS cells, grouped by the top qubits
+    constexpr int MAX_HEATMAP_QUBITS = 16;
+
+    //The k most likely basis states with probability >= min_probability as
+    //(index, probability), most likely first. One parallel pass with a bounded heap per thread.
+    std::vector<std::pair<size_t,double>> topK(const std::vector<std::complex<double>>& state_vector, size_t k, double min_probability = 0.0);
+    //Probabilities summed over 2^bins_log2 bins, bin b holds the states whose top
+    //bins_log2 qubits read b. Reduced in parallel.
+    std::vector<double> probabilityHistogram(const std::vector<std::complex<double>>& state_vector, int bins_log2);
+
     //Helper to generate the states
     std::vector<std::string> generateBasisStates(int n);
+    //Basis string of a single index, qubit 0 is the rightmost character
+    std::string basisString(size_t index, int qubit_count);
     //Prints the current states of the circuit
     void printState(const std::vector<std::complex<double>>& state_vector, int qubit_count);
     //prints the circuits
@@ -0,0 +1,158 @@
+#include <stdexcept>
+#include <MaQrel/QuantumAsyncCircuit.h>
+using namespace std;
+
+namespace {
+
+    //a * b, row major
+    array<complex<double>,4> multiply(const array<complex<double>,4> &a, const array<complex<double>,4> &b){
+        return {a[0]*b[0] + a[1]*b[2], a[0]*b[1] + a[1]*b[3],
+                a[2]*b[0] + a[3]*b[2], a[2]*b[1] + a[3]*b[3]};
+    }
+}
+
+QuantumAsyncCircuit::QuantumAsyncCircuit(QuantumCircuitBase &circuit, bool fuse) :
+    circuit(circuit), fuse(fuse), pending(circuit.getQubitCount())
+{
+    executor = thread([this]{ execute(); });
+}
+
+QuantumAsyncCircuit::~QuantumAsyncCircuit(){
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    executor.join();
+}
+
+void QuantumAsyncCircuit::submit(const GateOp &op){
+    QuantumGateInfo::check(op, circuit.getQubitCount());
+    Task task;
+    task.op = op;
+    if(QuantumGateInfo::arity(op.kind) == 1) task.op.qubit_2 = -1;
+    enqueue(move(task));
+    submitted_gates++;
+}
+
+void QuantumAsyncCircuit::submit(const QuantumProgram &program){
+    if(program.qubitCount() != circuit.getQubitCount()) throw invalid_argument("Program has " + to_string(program.qubitCount()) + " qubits, circuit has " + to_string(circuit.getQubitCount()) + ".");
+    for(const GateOp &op: program.ops()) submit(op);
+}
+
+void QuantumAsyncCircuit::enqueue(Task task){
+    {
+        lock_guard<mutex> guard(lock);
+        queue.push_back(move(task));
+    }
+    wake.notify_one();
+}
+
+future<void> QuantumAsyncCircuit::sync(){
+    return call([](QuantumCircuitBase &){});
+}
+
+future<double> QuantumAsyncCircuit::expectZ(const vector<int> &qubits){
+    return call([qubits](QuantumCircuitBase &target){ return target.expectZ(qubits); });
+}
+
+future<double> QuantumAsyncCircuit::expectation(const Observable &observable){
+    return call([observable](QuantumCircuitBase &target){ return target.expectation(observable); });
+}
+
+future<vector<double>> QuantumAsyncCircuit::marginalProbabilities(const vector<int> &qubits){
+    return call([qubits](QuantumCircuitBase &target){ return target.marginalProbabilities(qubits); });
+}
+
+future<int> QuantumAsyncCircuit::measure_single_qubit(int qubit){
+    return call([qubit](QuantumCircuitBase &target){ return target.measure_single_qubit(qubit); });
+}
+
+future<string> QuantumAsyncCircuit::collapse(){
+    return call([](QuantumCircuitBase &target){ return target.collapse(); });
+}
+
+future<map<string,int>> QuantumAsyncCircuit::run(int num_shots){
+    return call([num_shots](QuantumCircuitBase &target){ return target.run(num_shots); });
+}
+
+//Executor
+
+void QuantumAsyncCircuit::execute(){
+    deque<Task> batch;
+    while(true){
+        {
+            unique_lock<mutex> guard(lock);
+            //the queued gates are applied while waiting, more gates cannot join them anyway
+            if(queue.empty() && !error){
+                guard.unlock();
+                try{ flushAll(); }catch(...){ error = current_exception(); }
+                guard.lock();
+            }
+            wake.wait(guard, [this]{ return !queue.empty() || stopping; });
+            if(queue.empty()) break;
+            batch.swap(queue);
+        }
+
+        for(Task &task: batch){
+            if(!task.run){
+                if(error) continue;
+                try{ applyGate(task.op); }catch(...){ error = current_exception(); }
+                continue;
+            }
+            if(!error){
+                try{ flushAll(); }catch(...){ error = current_exception(); }
+            }
+            if(error){
+                task.fail(error);
+                error = nullptr;
+                for(auto &run: pending) run.count = 0;
+                continue;
+            }
+            task.run(circuit);
+        }
+        batch.clear();
+    }
+    //nobody is left to report an error to
+    if(!error){
+        try{ flushAll(); }catch(...){}
+    }
+}
+
+void QuantumAsyncCircuit::applyGate(const GateOp &op){
+    if(!fuse){
+        QuantumGateInfo::apply(circuit, op);
+        applied_gates++;
+        return;
+    }
+    if(QuantumGateInfo::arity(op.kind) == 2){
+        flushQubit(op.qubit_1);
+        flushQubit(op.qubit_2);
+        QuantumGateInfo::apply(circuit, op);
+        applied_gates++;
+        return;
+    }
+    PendingRun &run = pending[op.qubit_1];
+    array<complex<double>,4> u = QuantumGateInfo::matrix(op);
+    if(run.count == 0){
+        run.product = u;
+        run.first = op;
+    }else{
+        run.product = multiply(u, run.product);
+    }
+    run.count++;
+}
+
+void QuantumAsyncCircuit::flushQubit(int qubit){
+    PendingRun &run = pending[qubit];
+    if(run.count == 0) return;
+    //a lone gate keeps its own kernel and diagram box
+    if(run.count == 1) QuantumGateInfo::apply(circuit, run.first);
+    else circuit.U(qubit, run.product);
+    run.count = 0;
+    applied_gates++;
+}
+
+void QuantumAsyncCircuit::flushAll(){
+    for(int q=0; q<(int)pending.size(); q++) flushQubit(q);
+}
@@ -0,0 +1,123 @@
+#include <omp.h>
+#include <algorithm>
+#include <random>
+#include <exception>
+#include <stdexcept>
+#include <MaQrel/QuantumBatch.h>
+#include <MaQrel/QuantumCircuitBase.h>
+#include <MaQrel/QuantumCircuitParallel.h>
+#include <MaQrel/QuantumVisualization.h>
+#include <MaQrel/QuantumOptimizer.h>
+using namespace std;
+
+//Serial state-vector circuit that can be put back to |0...0> and reused
+class QuantumBatchRunner::RecycledCircuit : public QuantumCircuitBase {
+public:
+    RecycledCircuit(int n) : QuantumCircuitBase(n) { setDiagramEnabled(false); }
+    const vector<complex<double>>& state() const { return state_vector; }
+};
+
+namespace {
+
+    mt19937_64 streamFor(uint64_t seed, size_t job){
+        seed_seq sequence{(uint32_t)seed, (uint32_t)(seed>>32), (uint32_t)job, (uint32_t)(job>>32)};
+        return mt19937_64(sequence);
+    }
+
+    //applies the program of the job, returns the gates the optimizer removed
+    size_t applyJob(const BatchJob &job, QuantumCircuitBase &circuit){
+        if(!job.optimize){
+            job.program.applyTo(circuit);
+            return 0;
+        }
+        QuantumOptimizer::Report report;
+        QuantumOptimizer::optimize(job.program, &report).applyTo(circuit);
+        return report.removed();
+    }
+
+    //observables and shots of a finished job
+    BatchResult measure(QuantumCircuitBase &circuit, const vector<complex<double>> &state, const BatchJob &job, uint64_t seed, size_t index){
+        BatchResult result;
+        for(const Observable &observable: job.observables) result.expectations.push_back(circuit.expectation(observable));
+        if(job.shots > 0){
+            vector<double> cdf(state.size());
+            double sum = 0.0;
+            for(size_t i=0; i<state.size(); i++){
+                sum += norm(state[i]);
+                cdf[i] = sum;
+            }
+            mt19937_64 gen = streamFor(seed, index);
+            uniform_real_distribution<double> uniform(0.0, 1.0);
+            int n = job.program.qubitCount();
+            for(int shot=0; shot<job.shots; shot++){
+                double r = uniform(gen) * cdf.back();
+                size_t outcome = min<size_t>(upper_bound(cdf.begin(), cdf.end(), r) - cdf.begin(), cdf.size()-1);
+                result.counts[QuantumVisualization::basisString(outcome, n)]++;
+            }
+        }
+        return result;
+    }
+}
+
+QuantumBatchRunner::QuantumBatchRunner(const Options &options) : options(options) {
+    if(this->options.threads <= 0) this->options.threads = omp_get_max_threads();
+    recycled.resize(this->options.threads);
+}
+
+QuantumBatchRunner::~QuantumBatchRunner() = default;
+
+void QuantumBatchRunner::releaseStates(){
+    for(auto &circuits: recycled) circuits.clear();
+}
+
+vector<BatchResult> QuantumBatchRunner::run(const vector<QuantumProgram> &programs, const vector<Observable> &observables, int shots){
+    vector<BatchJob> jobs;
+    jobs.reserve(programs.size());
+    for(const QuantumProgram &program: programs) jobs.push_back({program, observables, shots});
+    return run(jobs);
+}
+
+vector<BatchResult> QuantumBatchRunner::run(const vector<BatchJob> &jobs){
+    vector<BatchResult> results(jobs.size());
+    vector<size_t> small, large;
+    for(size_t j=0; j<jobs.size(); j++){
+        if(jobs[j].shots < 0) throw invalid_argument("Number of shots cannot be negative.");
+        (jobs[j].program.qubitCount() < options.parallel_qubits ? small : large).push_back(j);
+    }
+
+    //one job per thread, the first failure is rethrown once the batch is done
+    exception_ptr error;
+    #pragma omp parallel num_threads(options.threads)
+    {
+        map<int, unique_ptr<RecycledCircuit>> &circuits = recycled[omp_get_thread_num()];
+        #pragma omp for schedule(dynamic)
+        for(size_t k=0; k<small.size(); k++){
+            size_t j = small[k];
+            const BatchJob &job = jobs[j];
+            try{
+                int n = job.program.qubitCount();
+                auto &circuit = circuits[n];
+                if(!circuit) circuit = make_unique<RecycledCircuit>(n);
+                else circuit->resetAll(0);
+                size_t removed = applyJob(job, *circuit);
+                results[j] = measure(*circuit, circuit->state(), job, options.seed, j);
+                results[j].gates_removed = removed;
+            }catch(...){
+                #pragma omp critical
+                if(!error) error = current_exception();
+            }
+        }
+    }
+    if(error) rethrow_exception(error);
+
+    //large enough to split every gate over the threads
+    for(size_t j: large){
+        const BatchJob &job = jobs[j];
+        QuantumCircuitParallel circuit(job.program.qubitCount());
+        circuit.setDiagramEnabled(false);
+        size_t removed = applyJob(job, circuit);
+        results[j] = measure(circuit, circuit.exportState(), job, options.seed, j);
+        results[j].gates_removed = removed;
+    }
+    return results;
+}
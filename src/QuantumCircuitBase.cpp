@@ -7,37 +7,131 @@
 #include <MaQrel/QuantumCircuitBase.h>
 #include <MaQrel/QuantumGates.h>
 #include <MaQrel/QuantumVisualization.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumFourier.h>
+#include <MaQrel/QuantumProfiler.h>
 using namespace std;
 
 // Constructor with member initializer list
-QuantumCircuitBase::QuantumCircuitBase(int n) :
+QuantumCircuitBase::QuantumCircuitBase(int n) : QuantumCircuitBase(n, true) {}
+
+QuantumCircuitBase::QuantumCircuitBase(int n, bool allocate_state) :
     qubit_count(n)
 {
     if(n<=0) {
         throw invalid_argument("Number of qubits must be positive.");
     }
+    circuit.resize(qubit_count, "");
+    if(!allocate_state) return;
 
-    size_t state_size = 1<<n; //size is 2^n
+    size_t state_size = 1ULL<<n; //size is 2^n
     state_vector.resize(state_size,0);
-    circuit.resize(qubit_count, "");
 
     state_vector[0] = 1.0; //Initialize the system to first state.
 }
 
-double QuantumCircuitBase::expectZ(vector<int> &q){
-    double expect = 0,normal;
-    for(int i=0;i<state_vector.size();i++){
-        int parity=0;
-        for(int j:q){
-            parity^=((i>>j)&1);
+double QuantumCircuitBase::expectZ(const vector<int> &q){
+    size_t mask = 0;
+    for(int j:q){
+        if(j<0 || j>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask ^= 1ULL<<j; //Z.Z = I, a qubit listed twice cancels
+    }
+    return zParityExpectations({mask})[0];
+}
+
+double QuantumCircuitBase::expectation(const Observable &observable){
+    //queued gates first, otherwise the copy below would bring back the state without them
+    flush();
+    const vector<PauliTerm> &terms = observable.getTerms();
+    double expect = observable.getIdentityCoefficient();
+
+    for(auto &group: observable.qubitWiseGroups()){
+        size_t x_basis = 0, y_basis = 0;
+        vector<size_t> z_masks;
+        for(int t: group){
+            const PauliTerm &term = terms[t];
+            if(((term.x_mask|term.z_mask) >> qubit_count) != 0) throw out_of_range("Observable acts on qubits out of range.");
+            x_basis |= term.x_mask & ~term.z_mask;
+            y_basis |= term.x_mask & term.z_mask;
+            z_masks.push_back(term.x_mask | term.z_mask);
+        }
+
+        vector<double> values;
+        if((x_basis|y_basis) == 0){
+            values = zParityExpectations(z_masks);
+        }else{
+            //measure the whole group in its rotated basis on a copy of the state
+            vector<complex<double>> saved = state_vector;
+            rotateToZBasis(x_basis, y_basis);
+            values = zParityExpectations(z_masks);
+            state_vector.swap(saved);
         }
-        normal = norm(state_vector[i]);
-        expect += (parity ? -normal:normal);
+
+        for(size_t k=0; k<group.size(); k++) expect += terms[group[k]].coefficient * values[k];
     }
     return expect;
 }
 
+void QuantumCircuitBase::rotateToZBasis(size_t x_basis, size_t y_basis){
+    for(int q=0; q<qubit_count; q++){
+        if((x_basis>>q) & 1) applySingleQubitOp(q, QuantumGates::H_Function());
+        else if((y_basis>>q) & 1) applySingleQubitOp(q, QuantumGates::YBasis_Function());
+    }
+}
+
+vector<double> QuantumCircuitBase::zParityExpectations(const vector<size_t> &z_masks){
+    MAQREL_PROFILE_KERNEL("serial z-parity", sizeof(complex<double>)*state_vector.size());
+    size_t support = 0;
+    for(size_t m: z_masks) support |= m;
+
+    if(PauliParity::useHistogram(z_masks.size(), support)){
+        //one pass builds the distribution over the support, one transform gives every parity
+        vector<double> hist = maskedMarginal(support);
+        PauliParity::walshHadamard(hist);
+        return PauliParity::fromTransformed(hist, z_masks, support);
+    }
+
+    vector<double> values(z_masks.size(), 0.0);
+    for(size_t i=0; i<state_vector.size(); i++){
+        double p = norm(state_vector[i]);
+        for(size_t t=0; t<z_masks.size(); t++){
+            values[t] += QuantumBits::parity(i & z_masks[t]) ? -p : p;
+        }
+    }
+    return values;
+}
+
+vector<double> QuantumCircuitBase::maskedMarginal(size_t mask){
+    vector<double> hist(1ULL<<QuantumBits::popcount(mask), 0.0);
+    for(size_t i=0; i<state_vector.size(); i++){
+        hist[QuantumBits::compactBits(i, mask)] += norm(state_vector[i]);
+    }
+    return hist;
+}
+
+vector<double> QuantumCircuitBase::marginalProbabilities(const vector<int> &qubits){
+    checkRegister(qubits);
+    size_t mask = 0;
+    for(int q: qubits){
+        if(q >= 64) throw out_of_range("Marginals only cover the first 64 qubits.");
+        mask |= 1ULL<<q;
+    }
+    vector<double> by_position = maskedMarginal(mask);
+
+    //bit rank[j] of the compacted index is qubits[j]
+    vector<int> rank(qubits.size());
+    for(size_t j=0; j<qubits.size(); j++) rank[j] = QuantumBits::popcount(mask & ((1ULL<<qubits[j])-1));
+    vector<double> marginal(by_position.size());
+    for(size_t b=0; b<by_position.size(); b++){
+        size_t value = 0;
+        for(size_t j=0; j<rank.size(); j++) value |= ((b>>rank[j]) & 1ULL) << j;
+        marginal[value] = by_position[b];
+    }
+    return marginal;
+}
+
 void QuantumCircuitBase::addCircuit(int qubit, const string &gate){
+    if(!diagram_enabled) return;
     string box_name = "["+gate+"]";
     int gate_width = box_name.length();
 
@@ -49,6 +143,7 @@ void QuantumCircuitBase::addCircuit(int qubit, const string &gate){
 }
 
 void QuantumCircuitBase::addCircuit(int qubit1,const string &gate1, int qubit2,const string &gate2){
+    if(!diagram_enabled) return;
 
     int max_gate_width = max(gate1.length(),gate2.length());
     string seperator = "-+" + string(max_gate_width+1,'-');
@@ -67,6 +162,21 @@ void QuantumCircuitBase::addCircuit(int qubit1,const string &gate1, int qubit2,c
     }
 }
 
+void QuantumCircuitBase::addCircuit(const vector<int> &qubits, const string &gate){
+    if(!diagram_enabled) return;
+    string box_name = "["+gate+"]";
+    int gate_width = box_name.length();
+    int lowest = *min_element(qubits.begin(), qubits.end());
+    int highest = *max_element(qubits.begin(), qubits.end());
+
+    alignCircuitColumns();
+    for(int i=0;i<qubit_count;i++){
+        if(find(qubits.begin(), qubits.end(), i) != qubits.end()) circuit[i]+=box_name;
+        else if(i>lowest && i<highest) circuit[i]+="-+"+string(gate_width-2,'-');
+        else circuit[i]+=string(gate_width,'-');
+    }
+}
+
 void QuantumCircuitBase::alignCircuitColumns(){
     size_t max_length = 0;
     for(auto &line:circuit) max_length = max(max_length, line.length()); 
@@ -79,7 +189,6 @@ void QuantumCircuitBase::printCircuit(){
 
 //collapse
 string QuantumCircuitBase::collapse(){
-    vector<string> basis_states = QuantumVisualization::generateBasisStates(qubit_count);
     vector<double> weights;
     for(auto &a:state_vector){
         weights.push_back(norm(a));
@@ -92,21 +201,12 @@ string QuantumCircuitBase::collapse(){
     int index = dist(gen);
     
     resetAll(index);
-    cout << basis_states[index] << "\n";
+    string basis_state = QuantumVisualization::basisString(index, qubit_count);
+    cout << basis_state << "\n";
     for(int i=0; i<qubit_count; i++){
        circuit[i] += "[M]";
     }
-    return basis_states[index];
-}
-
-string index_to_basis_string(size_t index, int qubit_count) {
-    string basis_str(qubit_count, '0');
-    for (int i = 0; i < qubit_count; ++i) {
-        if ((index >> i) & 1) {
-            basis_str[qubit_count - 1 - i] = '1';
-        }
-    }
-    return basis_str;
+    return basis_state;
 }
 
 map<string,int> QuantumCircuitBase::run(int num_shots){
@@ -122,7 +222,7 @@ map<string,int> QuantumCircuitBase::run(int num_shots){
     map<string,int> result;
     for(int i=0;i<num_shots;i++){
         int value = dist(gen);
-        result[index_to_basis_string(value, qubit_count)]++;
+        result[QuantumVisualization::basisString(value, qubit_count)]++;
     }
 
     for(int i=0; i<qubit_count; i++){
@@ -181,31 +281,21 @@ void QuantumCircuitBase::resetAll(int index = 0){
 string QuantumCircuitBase::measure_range_of_qubits(const vector<int> &qubits){
 
     size_t mask = 0;
-    for(auto& q:qubits) mask |= 1<<q;
-    map<size_t,double> prob;
-
-    size_t num_states = 1<<qubit_count;
-
-    for(size_t i=0; i<num_states; i++){
-        prob[i&mask] += norm(state_vector[i]);
-    }
-
-    vector<size_t> outcomes;
-    vector<double> weights;
-
-    for(auto &a: prob){
-        outcomes.push_back(a.first);
-        weights.push_back(a.second);
+    for(auto& q:qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask |= 1ULL<<q;
     }
+    vector<double> weights = maskedMarginal(mask);
 
     static random_device rd;
     static mt19937 gen(rd());
-    discrete_distribution<> dist(weights.begin(),weights.end());
-    size_t index = dist(gen);
-    double norm_factor = sqrt(weights[index]);
-    size_t measurement = outcomes[index];
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+    size_t outcome = dist(gen);
+    double norm_factor = sqrt(weights[outcome]);
+    size_t measurement = QuantumBits::depositBits(outcome, mask);
 
-    for(int i=0; i<num_states; i++){
+    size_t num_states = state_vector.size();
+    for(size_t i=0; i<num_states; i++){
         if((i&mask) == measurement){
             state_vector[i] /= norm_factor;
         }else{
@@ -225,33 +315,20 @@ string QuantumCircuitBase::measure_range_of_qubits(const vector<int> &qubits){
 map<string,int> QuantumCircuitBase::run_range_of_qubits(int num_shots, const vector<int> &qubits){
 
     size_t mask = 0;
-    for(auto& q:qubits) mask |= 1<<q;
-    map<size_t,double> prob;
-
-    size_t num_states = 1<<qubit_count;
-
-    for(size_t i=0; i<num_states; i++){
-        prob[i&mask] += norm(state_vector[i]);
-    }
-
-    vector<size_t> outcomes;
-    vector<double> weights;
-
-    for(auto &a: prob){
-        outcomes.push_back(a.first);
-        weights.push_back(a.second);
+    for(auto& q:qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask |= 1ULL<<q;
     }
+    vector<double> weights = maskedMarginal(mask);
 
     map<string,int> result;
 
     static random_device rd;
     static mt19937 gen(rd());
-    discrete_distribution<> dist(weights.begin(),weights.end());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
 
     for(int i=0;i<num_shots;i++){
-        size_t index = dist(gen);
-        double norm_factor = sqrt(weights[index]);
-        size_t measurement = outcomes[index];
+        size_t measurement = QuantumBits::depositBits(dist(gen), mask);
 
         string output;
         for(int q:qubits){
@@ -264,6 +341,65 @@ map<string,int> QuantumCircuitBase::run_range_of_qubits(int num_shots, const vec
 }
 
 
+void QuantumCircuitBase::saveState(const string &path, QuantumSnapshot::Precision precision){
+    QuantumSnapshot::write(path, state_vector, qubit_count, precision);
+}
+
+void QuantumCircuitBase::loadState(const string &path){
+    QuantumSnapshot::MappedSnapshot snapshot(path);
+    if(snapshot.qubitCount() != qubit_count) throw invalid_argument("Snapshot has " + to_string(snapshot.qubitCount()) + " qubits, circuit has " + to_string(qubit_count) + ".");
+    snapshot.copyTo(state_vector);
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[L]";
+    }
+}
+
+vector<complex<double>> QuantumCircuitBase::exportState(){
+    return state_vector;
+}
+
+void QuantumCircuitBase::importState(const vector<complex<double>> &amplitudes){
+    checkStateSize(amplitudes.size());
+    state_vector = amplitudes;
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitBase::clone(){
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitBase(*this));
+}
+
+//Overlaps
+
+const vector<complex<double>>& QuantumCircuitBase::denseAmplitudes(QuantumCircuitBase &circuit, vector<complex<double>> &buffer){
+    circuit.flush();
+    if(circuit.qubit_count < 64 && circuit.state_vector.size() == 1ULL<<circuit.qubit_count) return circuit.state_vector;
+    buffer = circuit.exportState();
+    return buffer;
+}
+
+complex<double> QuantumCircuitBase::innerProduct(QuantumCircuitBase &other){
+    checkSameQubits(other);
+    vector<complex<double>> buffer, other_buffer;
+    const vector<complex<double>> &a = denseAmplitudes(*this, buffer);
+    const vector<complex<double>> &b = denseAmplitudes(other, other_buffer);
+    complex<double> sum = 0.0;
+    for(size_t i=0; i<a.size(); i++) sum += conj(a[i]) * b[i];
+    return sum;
+}
+
+double QuantumCircuitBase::stateNorm(){
+    vector<complex<double>> buffer;
+    const vector<complex<double>> &a = denseAmplitudes(*this, buffer);
+    double sum = 0.0;
+    for(const complex<double> &x: a) sum += norm(x);
+    return sqrt(sum);
+}
+
+complex<double> QuantumCircuitBase::amplitude(size_t index){
+    if(qubit_count < 64 && index >= 1ULL<<qubit_count) throw out_of_range("Basis state index out of range.");
+    vector<complex<double>> buffer;
+    return denseAmplitudes(*this, buffer)[index];
+}
+
 void QuantumCircuitBase::displayGraph() {
     QuantumVisualization::displayGraph(state_vector,qubit_count);
 }
@@ -284,6 +420,7 @@ void QuantumCircuitBase::printState() {
 
 void QuantumCircuitBase::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
     if(target_qubit<0 || target_qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+    MAQREL_PROFILE_KERNEL("serial single-qubit", 2*sizeof(complex<double>)*state_vector.size());
 
     size_t block_size = 1ULL<<target_qubit;
     size_t stride = 1ULL<<(target_qubit+1);
@@ -300,6 +437,7 @@ void QuantumCircuitBase::applySingleQubitOp(int target_qubit, function<void(comp
 void QuantumCircuitBase::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
     if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
     if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    MAQREL_PROFILE_KERNEL("serial two-qubit", 2*sizeof(complex<double>)*state_vector.size());
 
     size_t q_b = max(qubit_1,qubit_2);
     size_t q_a = min(qubit_1,qubit_2);
@@ -332,6 +470,8 @@ void QuantumCircuitBase::applyTwoQubitOp(int qubit_1, int qubit_2, function<void
 void QuantumCircuitBase::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
     if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0) throw out_of_range("Qubits out of range.");
     if(control_qubit == target_qubit) throw invalid_argument("Control and target qubits cannot be the same.");
+    //only the half with the control set is read and written
+    MAQREL_PROFILE_KERNEL("serial controlled", sizeof(complex<double>)*state_vector.size());
 
     size_t control_mask = 1ULL << control_qubit;
     size_t block_size = 1ULL << target_qubit;
@@ -347,16 +487,19 @@ void QuantumCircuitBase::applyControlledQubitOp(int control_qubit, int target_qu
 //Type 1: Pauli Gates
 
 void QuantumCircuitBase::X(int target_qubit) {
+    MAQREL_PROFILE_GATE("X");
     applySingleQubitOp(target_qubit,QuantumGates::X_Function());
     addCircuit(target_qubit, "X");
 }
 
 void QuantumCircuitBase::Y(int target_qubit){
+    MAQREL_PROFILE_GATE("Y");
     applySingleQubitOp(target_qubit,QuantumGates::Y_Function());
     addCircuit(target_qubit, "Y");
 }
 
 void QuantumCircuitBase::Z(int target_qubit){
+    MAQREL_PROFILE_GATE("Z");
     applySingleQubitOp(target_qubit,QuantumGates::Z_Function());
     addCircuit(target_qubit, "Z");
 }
@@ -364,6 +507,7 @@ void QuantumCircuitBase::Z(int target_qubit){
 //Type 2: Superposition Gate
 
 void QuantumCircuitBase::H(int target_qubit){
+    MAQREL_PROFILE_GATE("H");
     applySingleQubitOp(target_qubit,QuantumGates::H_Function());
     addCircuit(target_qubit, "H");
 }
@@ -371,112 +515,297 @@ void QuantumCircuitBase::H(int target_qubit){
 //Type 3: Phase Gate 
 
 void QuantumCircuitBase::S(int target_qubit){
+    MAQREL_PROFILE_GATE("S");
     applySingleQubitOp(target_qubit,QuantumGates::Phase_Function(QuantumGates::I));
     addCircuit(target_qubit, "S");
 }
 
 void QuantumCircuitBase::Sdg(int target_qubit){
+    MAQREL_PROFILE_GATE("Sdg");
     applySingleQubitOp(target_qubit,QuantumGates::Phase_Function(-1.0 * QuantumGates::I));
     addCircuit(target_qubit, "S");
 }
 
 void QuantumCircuitBase::T(int target_qubit) {
+    MAQREL_PROFILE_GATE("T");
     applySingleQubitOp(target_qubit,QuantumGates::Phase_Function(polar(1.0, M_PI / 4.0)));
     addCircuit(target_qubit, "T");
 }
 
 void QuantumCircuitBase::Tdg(int target_qubit) {
+    MAQREL_PROFILE_GATE("Tdg");
     applySingleQubitOp(target_qubit,QuantumGates::Phase_Function(polar(1.0, -M_PI / 4.0)));
     addCircuit(target_qubit, "Tdg");
 }
 
 void QuantumCircuitBase::P(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("P");
     applySingleQubitOp(target_qubit,QuantumGates::Phase_Function(polar(1.0,theta)));
     addCircuit(target_qubit, "P");
 }
 
 void QuantumCircuitBase::Rz(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("Rz");
     applySingleQubitOp(target_qubit,QuantumGates::Rz_Function(theta));
     addCircuit(target_qubit,"Rz("+to_string(theta)+")");
 }
 
 void QuantumCircuitBase::Rx(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("Rx");
     applySingleQubitOp(target_qubit,QuantumGates::Rx_Function(theta));
     addCircuit(target_qubit,"Rx("+to_string(theta)+")");
 }
 
 void QuantumCircuitBase::Ry(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("Ry");
     applySingleQubitOp(target_qubit,QuantumGates::Ry_Function(theta));
     addCircuit(target_qubit,"Ry("+to_string(theta)+")");
 }
 
+void QuantumCircuitBase::U(int target_qubit, const array<complex<double>,4> &matrix){
+    MAQREL_PROFILE_GATE("U");
+    applySingleQubitOp(target_qubit,QuantumGates::Matrix_Function(matrix));
+    addCircuit(target_qubit, "U");
+}
+
 //Type 4: Entangling gate
 
 void QuantumCircuitBase::CX(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CX");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::X_Function());
     addCircuit(control_qubit, "C", target_qubit, "X");
 }
 
 void QuantumCircuitBase::CY(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CY");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Y_Function());
     addCircuit(control_qubit, "C", target_qubit, "Y");
 }
 
 void QuantumCircuitBase::CZ(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CZ");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Z_Function());
     addCircuit(control_qubit, "C", target_qubit, "Z");
 }
 
 void QuantumCircuitBase::CH(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CH");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::H_Function());
     addCircuit(control_qubit, "C", target_qubit, "H");
 }
 
 void QuantumCircuitBase::CS(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CS");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Phase_Function(QuantumGates::I));
     addCircuit(control_qubit, "C", target_qubit, "S");
 }
 
 void QuantumCircuitBase::CSdg(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CSdg");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Phase_Function(-1.0*QuantumGates::I));
     addCircuit(control_qubit, "C", target_qubit, "Sdg");
 }
 
 void QuantumCircuitBase::CT(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CT");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Phase_Function(polar(1.0,M_PI/4.0)));
     addCircuit(control_qubit, "C", target_qubit, "T");
 }
 
 void QuantumCircuitBase::CTdg(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CTdg");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Phase_Function(polar(1.0,-M_PI/4.0)));
     addCircuit(control_qubit, "C", target_qubit, "Tdg");
 }
 
 void QuantumCircuitBase::CP(int control_qubit, int target_qubit,const double theta){
+    MAQREL_PROFILE_GATE("CP");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Phase_Function(polar(1.0,theta)));
     addCircuit(control_qubit, "C", target_qubit, "P("+to_string(theta)+")");
 }
 
 void QuantumCircuitBase::CRz(int control_qubit, int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("CRz");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Rz_Function(theta));
     addCircuit(control_qubit, "C", target_qubit, "Rz("+to_string(theta)+")");
 }
 
 void QuantumCircuitBase::CRx(int control_qubit, int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("CRx");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Rx_Function(theta));
     addCircuit(control_qubit, "C", target_qubit, "Rx("+to_string(theta)+")");
 }
 
 void QuantumCircuitBase::CRy(int control_qubit, int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("CRy");
     applyControlledQubitOp(control_qubit,target_qubit, QuantumGates::Ry_Function(theta));
     addCircuit(control_qubit, "C", target_qubit, "Ry("+to_string(theta)+")");
 }
 
 void QuantumCircuitBase::SWAP(int qubit_1, int qubit_2){
+    MAQREL_PROFILE_GATE("SWAP");
     applyTwoQubitOp(qubit_1, qubit_2, QuantumGates::SWAP_Function());
 }
 
 void QuantumCircuitBase::iSWAP(int qubit_1, int qubit_2){
+    MAQREL_PROFILE_GATE("iSWAP");
     applyTwoQubitOp(qubit_1, qubit_2, QuantumGates::iSWAP_Function());
 }
 
+//Type 5: Register operations
+
+void QuantumCircuitBase::checkStateSize(size_t size) const {
+    if(qubit_count >= 64 || size != 1ULL<<qubit_count) throw invalid_argument("State has " + to_string(size) + " amplitudes, circuit has " + to_string(qubit_count) + " qubits.");
+}
+
+void QuantumCircuitBase::checkSameQubits(const QuantumCircuitBase &other) const {
+    if(other.qubit_count != qubit_count) throw invalid_argument("Circuits have " + to_string(qubit_count) + " and " + to_string(other.qubit_count) + " qubits.");
+}
+
+void QuantumCircuitBase::checkRegister(const vector<int> &qubits) const {
+    if(qubits.empty()) throw invalid_argument("Register cannot be empty.");
+    vector<bool> seen(qubit_count, false);
+    for(int q: qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        if(seen[q]) throw invalid_argument("Register qubits must be distinct.");
+        seen[q] = true;
+    }
+}
+
+void QuantumCircuitBase::applyQFTGates(const vector<int> &qubits, bool inverse){
+    int k = qubits.size();
+    if(!inverse){
+        for(int i=k-1;i>=0;i--){
+            H(qubits[i]);
+            for(int j=i-1;j>=0;j--) CP(qubits[j], qubits[i], M_PI / pow(2.0, i-j));
+        }
+        for(int i=0;i<k/2;i++) SWAP(qubits[i], qubits[k-1-i]);
+    }else{
+        //the forward gates reversed, with the angles negated
+        for(int i=0;i<k/2;i++) SWAP(qubits[i], qubits[k-1-i]);
+        for(int i=0;i<k;i++){
+            for(int j=0;j<i;j++) CP(qubits[j], qubits[i], -M_PI / pow(2.0, i-j));
+            H(qubits[i]);
+        }
+    }
+}
+
+void QuantumCircuitBase::QFT(const vector<int> &qubits, bool inverse){
+    checkRegister(qubits);
+    MAQREL_PROFILE_GATE("QFT");
+    QuantumFourier::Plan plan = QuantumFourier::makePlan(qubits, inverse);
+    {
+        MAQREL_PROFILE_KERNEL("serial qft", 2*sizeof(complex<double>)*state_vector.size());
+        QuantumFourier::apply(state_vector.data(), state_vector.size(), plan);
+    }
+    addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+}
+
+//Pauli rotations
+
+void QuantumCircuitBase::applyPauliRotation(size_t x_mask, size_t z_mask, double theta){
+    if(state_vector.size() != (1ULL<<qubit_count)){
+        applyPauliRotationGates(x_mask, z_mask, theta);
+        return;
+    }
+    MAQREL_PROFILE_KERNEL("serial pauli rotation", 2*sizeof(complex<double>)*state_vector.size());
+
+    if(x_mask == 0){
+        auto op = QuantumGates::PauliPhase_Function(z_mask, theta);
+        for(size_t i=0; i<state_vector.size(); i++) op(i, state_vector[i]);
+        return;
+    }
+    //every pair j, j^x_mask once, with the highest bit of x_mask clear in j
+    int pivot = QuantumBits::highestBit(x_mask);
+    auto op = QuantumGates::PauliRotation_Function(x_mask, z_mask, theta);
+    for(size_t k=0; k<state_vector.size()/2; k++){
+        size_t j = QuantumBits::insertZeroBit(k, pivot);
+        op(j, state_vector[j], state_vector[j^x_mask]);
+    }
+}
+
+void QuantumCircuitBase::applyPauliRotationGates(size_t x_mask, size_t z_mask, double theta){
+    vector<int> support;
+    for(int q=0; q<qubit_count; q++){
+        if(((x_mask|z_mask)>>q) & 1) support.push_back(q);
+    }
+
+    //the caller draws the rotation, not the gates it is made of
+    bool enabled = diagram_enabled;
+    diagram_enabled = false;
+    try{
+        if(support.empty()){
+            //the identity, only a global phase
+            complex<double> phase = polar(1.0, -theta/2.0);
+            U(0, {phase, 0.0, 0.0, phase});
+        }else{
+            //X and Y to Z, the parity onto the highest qubit, Rz there and everything undone
+            int top = support.back();
+            for(int q: support){
+                if(!((x_mask>>q) & 1)) continue;
+                if((z_mask>>q) & 1) Sdg(q);
+                H(q);
+            }
+            for(int q: support) if(q != top) CX(q, top);
+            Rz(top, theta);
+            for(int k=support.size()-1; k>=0; k--) if(support[k] != top) CX(support[k], top);
+            for(int q: support){
+                if(!((x_mask>>q) & 1)) continue;
+                H(q);
+                if((z_mask>>q) & 1) S(q);
+            }
+        }
+    }catch(...){
+        diagram_enabled = enabled;
+        throw;
+    }
+    diagram_enabled = enabled;
+}
+
+void QuantumCircuitBase::PauliRotation(const string &paulis, const vector<int> &qubits, double theta){
+    checkRegister(qubits);
+    //parsed as an observable term so the strings follow the same rules
+    Observable term;
+    term.addTerm(1.0, paulis, qubits);
+    size_t x_mask = 0, z_mask = 0;
+    if(term.size() > 0){
+        x_mask = term.getTerms()[0].x_mask;
+        z_mask = term.getTerms()[0].z_mask;
+    }
+    MAQREL_PROFILE_GATE("PauliRotation");
+    applyPauliRotation(x_mask, z_mask, theta);
+    addCircuit(qubits, "R"+paulis+"("+to_string(theta)+")");
+}
+
+void QuantumCircuitBase::PauliRotation(const string &pauli_string, double theta){
+    vector<int> qubits(pauli_string.size());
+    for(size_t k=0; k<pauli_string.size(); k++) qubits[k] = pauli_string.size()-1-k;
+    PauliRotation(pauli_string, qubits, theta);
+}
+
+void QuantumCircuitBase::trotterStep(const Observable &hamiltonian, double dt, int order){
+    if(order != 1 && order != 2) throw invalid_argument("Only first and second order Trotter steps are supported.");
+    const vector<PauliTerm> &terms = hamiltonian.getTerms();
+    size_t support = 0;
+    for(const PauliTerm &term: terms) support |= term.x_mask | term.z_mask;
+    if(qubit_count < 64 && (support >> qubit_count)) throw out_of_range("The Hamiltonian acts on qubits out of range.");
+    MAQREL_PROFILE_GATE("trotterStep");
+
+    //exp(-i c P dt) is the rotation by 2 c dt, the identity part is a global phase
+    if(hamiltonian.getIdentityCoefficient() != 0.0) applyPauliRotation(0, 0, 2.0*hamiltonian.getIdentityCoefficient()*dt);
+    if(order == 1){
+        for(const PauliTerm &term: terms) applyPauliRotation(term.x_mask, term.z_mask, 2.0*term.coefficient*dt);
+    }else if(!terms.empty()){
+        //half steps up to the last term, its two halves merged, and back down
+        size_t last = terms.size()-1;
+        for(size_t k=0; k<last; k++) applyPauliRotation(terms[k].x_mask, terms[k].z_mask, terms[k].coefficient*dt);
+        applyPauliRotation(terms[last].x_mask, terms[last].z_mask, 2.0*terms[last].coefficient*dt);
+        for(size_t k=last; k-- > 0;) applyPauliRotation(terms[k].x_mask, terms[k].z_mask, terms[k].coefficient*dt);
+    }
+
+    vector<int> qubits;
+    for(int q=0; q<qubit_count; q++){
+        if((support>>q) & 1) qubits.push_back(q);
+    }
+    if(!qubits.empty()) addCircuit(qubits, "Trotter("+to_string(dt)+")");
+}
@@ -0,0 +1,222 @@
+#include <MaQrel/QuantumCircuitFile.h>
+#include <MaQrel/QuantumCircuitBase.h>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+namespace QuantumCircuitFile {
+
+    //records per block write
+    constexpr size_t WRITE_BLOCK_RECORDS = 1 << 16;
+
+    Writer::Writer(const string &path, int qubit_count) : path(path), header() {
+        if(qubit_count <= 0) throw invalid_argument("Number of qubits must be positive.");
+        out.open(path, ios::binary | ios::trunc);
+        if(!out.is_open()) throw runtime_error("Could not open circuit file " + path);
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.qubit_count = qubit_count;
+        header.record_offset = sizeof(Header);
+        header.name = NO_STRING;
+        //placeholder until close() knows the sizes
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        pending.reserve(WRITE_BLOCK_RECORDS);
+    }
+
+    Writer::~Writer(){
+        try{
+            if(!closed) close();
+        }catch(...){}
+    }
+
+    void Writer::push(const Record &record){
+        if(closed) throw logic_error("Circuit file " + path + " is already closed.");
+        pending.push_back(record);
+        header.record_count++;
+        if(pending.size() == WRITE_BLOCK_RECORDS){
+            out.write(reinterpret_cast<const char*>(pending.data()), pending.size()*sizeof(Record));
+            pending.clear();
+        }
+    }
+
+    uint32_t Writer::addString(const string &text){
+        if(strings.size() + text.size() + 1 >= NO_STRING) throw length_error("Circuit file string table is full.");
+        uint32_t offset = strings.size();
+        strings += text;
+        strings += '\0';
+        return offset;
+    }
+
+    Writer& Writer::add(const GateOp &op){
+        QuantumGateInfo::check(op, header.qubit_count);
+        Record record = {};
+        record.opcode = static_cast<uint8_t>(op.kind);
+        record.qubit_1 = op.qubit_1;
+        record.qubit_2 = QuantumGateInfo::arity(op.kind) == 2 ? op.qubit_2 : -1;
+        record.theta = QuantumGateInfo::hasAngle(op.kind) ? op.theta : 0.0;
+        push(record);
+        return *this;
+    }
+
+    Writer& Writer::add(const QuantumProgram &program){
+        if(program.qubitCount() != (int)header.qubit_count) throw invalid_argument("Program and circuit file have different qubit counts.");
+        for(const GateOp &op: program.ops()) add(op);
+        return *this;
+    }
+
+    Writer& Writer::U(int q, const array<complex<double>,4> &matrix){
+        if(q < 0 || q >= (int)header.qubit_count) throw out_of_range("Qubit index out of range.");
+        Record record = {};
+        record.opcode = OPCODE_U;
+        record.qubit_1 = q;
+        record.qubit_2 = -1;
+        record.index = matrices.size();
+        matrices.push_back(matrix);
+        push(record);
+        return *this;
+    }
+
+    Writer& Writer::label(const string &text){
+        Record record = {};
+        record.opcode = OPCODE_LABEL;
+        record.qubit_1 = record.qubit_2 = -1;
+        record.index = addString(text);
+        push(record);
+        return *this;
+    }
+
+    Writer& Writer::setName(const string &name){
+        header.name = addString(name);
+        return *this;
+    }
+
+    void Writer::close(){
+        if(closed) return;
+        closed = true;
+        out.write(reinterpret_cast<const char*>(pending.data()), pending.size()*sizeof(Record));
+        pending.clear();
+        header.matrix_offset = header.record_offset + header.record_count*sizeof(Record);
+        header.matrix_count = matrices.size();
+        out.write(reinterpret_cast<const char*>(matrices.data()), matrices.size()*sizeof(matrices[0]));
+        header.string_offset = header.matrix_offset + header.matrix_count*sizeof(matrices[0]);
+        header.string_bytes = strings.size();
+        out.write(strings.data(), strings.size());
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.close();
+        if(out.fail()) throw runtime_error("Failed writing circuit file " + path);
+    }
+
+    void write(const string &path, const QuantumProgram &program){
+        Writer writer(path, program.qubitCount());
+        writer.add(program);
+        writer.close();
+    }
+
+    MappedCircuit::MappedCircuit(const string &path){
+    #ifdef _WIN32
+        ifstream in(path, ios::binary | ios::ate);
+        if(!in.is_open()) throw runtime_error("Could not open circuit file " + path);
+        fallback.resize(in.tellg());
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(fallback.data()), fallback.size());
+        data = fallback.data();
+        length = fallback.size();
+    #else
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw runtime_error("Could not open circuit file " + path);
+        struct stat info;
+        if(fstat(fd, &info) != 0){
+            close(fd);
+            throw runtime_error("Could not stat circuit file " + path);
+        }
+        length = info.st_size;
+        void *mapped = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if(mapped == MAP_FAILED) throw runtime_error("Could not map circuit file " + path);
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        data = static_cast<const unsigned char*>(mapped);
+    #endif
+
+        //the destructor does not run when the constructor throws
+        try{
+            readHeader();
+        }catch(...){
+        #ifndef _WIN32
+            munmap(const_cast<unsigned char*>(data), length);
+        #endif
+            throw;
+        }
+    }
+
+    void MappedCircuit::readHeader(){
+        if(length < sizeof(Header)) throw runtime_error("Circuit file is truncated.");
+        memcpy(&header, data, sizeof(Header));
+        if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw runtime_error("Not a MaQrel circuit file.");
+        if(header.version != VERSION) throw runtime_error("Unsupported circuit file version " + to_string(header.version));
+        if(header.qubit_count == 0 || header.record_offset < sizeof(Header)) throw runtime_error("Circuit file header is inconsistent.");
+        //each section is bounded by the bytes left after it starts, so the sums below cannot wrap
+        if(header.record_offset > length || header.record_count > (length - header.record_offset) / sizeof(Record))
+            throw runtime_error("Circuit file is truncated.");
+        if(header.matrix_offset != header.record_offset + header.record_count*sizeof(Record))
+            throw runtime_error("Circuit file header is inconsistent.");
+        if(header.matrix_count > (length - header.matrix_offset) / sizeof(array<complex<double>,4>))
+            throw runtime_error("Circuit file is truncated.");
+        if(header.string_offset != header.matrix_offset + header.matrix_count*sizeof(array<complex<double>,4>))
+            throw runtime_error("Circuit file header is inconsistent.");
+        if(header.string_bytes > length - header.string_offset) throw runtime_error("Circuit file is truncated.");
+        if(header.string_bytes > 0 && data[header.string_offset + header.string_bytes - 1] != '\0')
+            throw runtime_error("Circuit file string table is not terminated.");
+    }
+
+    MappedCircuit::~MappedCircuit(){
+    #ifndef _WIN32
+        if(data) munmap(const_cast<unsigned char*>(data), length);
+    #endif
+    }
+
+    Record MappedCircuit::record(size_t i) const {
+        if(i >= header.record_count) throw out_of_range("Record index out of range.");
+        Record record;
+        memcpy(&record, data + header.record_offset + i*sizeof(Record), sizeof(Record));
+        return record;
+    }
+
+    array<complex<double>,4> MappedCircuit::matrix(uint32_t index) const {
+        if(index >= header.matrix_count) throw out_of_range("Matrix index out of range.");
+        array<complex<double>,4> m;
+        memcpy(m.data(), data + header.matrix_offset + index*sizeof(m), sizeof(m));
+        return m;
+    }
+
+    string MappedCircuit::stringAt(uint32_t offset) const {
+        if(offset == NO_STRING) return "";
+        if(offset >= header.string_bytes) throw out_of_range("String offset out of range.");
+        return string(reinterpret_cast<const char*>(data + header.string_offset + offset));
+    }
+
+    void MappedCircuit::replay(QuantumCircuitBase &circuit, size_t first, size_t last) const {
+        if(circuit.getQubitCount() != (int)header.qubit_count) throw invalid_argument("The circuit has " + to_string(circuit.getQubitCount()) + " qubits, the file " + to_string(header.qubit_count) + ".");
+        last = min<size_t>(last, header.record_count);
+        const unsigned char *cursor = data + header.record_offset + first*sizeof(Record);
+        constexpr uint8_t LAST_GATE = static_cast<uint8_t>(GateKind::iSWAP);
+        for(size_t i=first; i<last; i++, cursor += sizeof(Record)){
+            Record record;
+            memcpy(&record, cursor, sizeof(Record));
+            if(record.opcode <= LAST_GATE){
+                QuantumGateInfo::apply(circuit, {static_cast<GateKind>(record.opcode), record.qubit_1, record.qubit_2, record.theta});
+            }else if(record.opcode == OPCODE_U){
+                circuit.U(record.qubit_1, matrix(record.index));
+            }else if(record.opcode != OPCODE_LABEL){
+                throw runtime_error("Unknown opcode " + to_string(record.opcode) + " in circuit file record " + to_string(i));
+            }
+        }
+    }
+}
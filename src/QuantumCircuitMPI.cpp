@@ -1,12 +1,37 @@
 #include <mpi.h>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
+#include <exception>
 #include <MaQrel/QuantumCircuitMPI.h>
 #include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumProfiler.h>
+#include <MaQrel/QuantumFourier.h>
 using namespace std;
 
 QuantumCircuitMPI::QuantumCircuitMPI(int n) : QuantumCircuitBase(n) {}
 
+void QuantumCircuitMPI::saveState(const string &path, QuantumSnapshot::Precision precision) {
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    // rank 0 writes; the others wait for its result instead of a barrier it may never reach
+    exception_ptr error;
+    int ok = 1;
+    if(rank == 0){
+        try{
+            QuantumCircuitBase::saveState(path, precision);
+        }catch(...){
+            error = current_exception();
+            ok = 0;
+        }
+    }
+    // nobody reads the file before it is complete
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if(error) rethrow_exception(error);
+    if(!ok) throw runtime_error("Could not save snapshot file " + path + " on rank 0.");
+}
+
 void QuantumCircuitMPI::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op) {
     // if(target_qubit<0 || target_qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
     
@@ -64,33 +89,42 @@ void QuantumCircuitMPI::applySingleQubitOp(int target_qubit, function<void(compl
     if(rank == 0) sendptr = state_vector.data();
 
     
-    MPI_Scatterv( 
-        sendptr , 
-        counts_elems.data() , 
-        displs_elems.data() , 
-        MPI_CXX_DOUBLE_COMPLEX ,
-        (local_elems > 0 ? local_buf.data() : nullptr) , 
-        local_elems , 
-        MPI_CXX_DOUBLE_COMPLEX ,
-        0 , 
-        MPI_COMM_WORLD
-    );
+    {
+        MAQREL_PROFILE_COMM("MPI_Scatterv", sizeof(complex<double>)*local_elems);
+        MPI_Scatterv( 
+            sendptr , 
+            counts_elems.data() , 
+            displs_elems.data() , 
+            MPI_CXX_DOUBLE_COMPLEX ,
+            (local_elems > 0 ? local_buf.data() : nullptr) , 
+            local_elems , 
+            MPI_CXX_DOUBLE_COMPLEX ,
+            0 , 
+            MPI_COMM_WORLD
+        );
+    }
 
-    for(int offset = 0; offset < local_elems; offset += (int)stride){
-        for(int j=0;j<block_size;j++){
-            op(local_buf[offset + j], local_buf[offset + j + block_size]);
+    {
+        MAQREL_PROFILE_KERNEL("mpi single-qubit", 2*sizeof(complex<double>)*local_elems);
+        for(int offset = 0; offset < local_elems; offset += (int)stride){
+            for(int j=0;j<block_size;j++){
+                op(local_buf[offset + j], local_buf[offset + j + block_size]);
+            }
         }
     }
 
-    MPI_Gatherv( 
-    (local_elems > 0 ? local_buf.data() : nullptr) , 
-    local_elems , 
-    MPI_CXX_DOUBLE_COMPLEX , 
-    sendptr ,
-    counts_elems.data() , 
-    displs_elems.data() , 
-    MPI_CXX_DOUBLE_COMPLEX , 
-    0 , MPI_COMM_WORLD);
+    {
+        MAQREL_PROFILE_COMM("MPI_Gatherv", sizeof(complex<double>)*local_elems);
+        MPI_Gatherv( 
+        (local_elems > 0 ? local_buf.data() : nullptr) , 
+        local_elems , 
+        MPI_CXX_DOUBLE_COMPLEX , 
+        sendptr ,
+        counts_elems.data() , 
+        displs_elems.data() , 
+        MPI_CXX_DOUBLE_COMPLEX , 
+        0 , MPI_COMM_WORLD);
+    }
 
 }
 
@@ -151,33 +185,339 @@ void QuantumCircuitMPI::applyControlledQubitOp(int control_qubit, int target_qub
     complex<double> *sendptr = nullptr;
     if(rank == 0) sendptr = state_vector.data();
 
-    MPI_Scatterv(
-        sendptr,
-        counts_elems.data(),
-        displs_elems.data(),
-        MPI_CXX_DOUBLE_COMPLEX,
-        (local_elems > 0 ? local_buf.data() : nullptr),
-        local_elems,
-        MPI_CXX_DOUBLE_COMPLEX,
-        0,
-        MPI_COMM_WORLD
-    );
-
-    for(int offset = 0; offset < local_elems; offset += (int)stride){
-        for(int j=0;j<block_size;j++){
-            if(((offset+j)&control_mask)!=0) op(local_buf[offset + j], local_buf[offset + j + block_size]);
-        }
-    }
-
-    MPI_Gatherv(
-        (local_elems > 0 ? local_buf.data() :nullptr),
-        local_elems,
-        MPI_CXX_DOUBLE_COMPLEX,
-        sendptr,
-        counts_elems.data(),
-        displs_elems.data(),
-        MPI_CXX_DOUBLE_COMPLEX,
-        0,
-        MPI_COMM_WORLD
-    );
-}
\ No newline at end of file
+    {
+        MAQREL_PROFILE_COMM("MPI_Scatterv", sizeof(complex<double>)*local_elems);
+        MPI_Scatterv(
+            sendptr,
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            (local_elems > 0 ? local_buf.data() : nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+
+    {
+        MAQREL_PROFILE_KERNEL("mpi controlled", sizeof(complex<double>)*local_elems);
+        for(int offset = 0; offset < local_elems; offset += (int)stride){
+            for(int j=0;j<block_size;j++){
+                if(((offset+j)&control_mask)!=0) op(local_buf[offset + j], local_buf[offset + j + block_size]);
+            }
+        }
+    }
+
+    {
+        MAQREL_PROFILE_COMM("MPI_Gatherv", sizeof(complex<double>)*local_elems);
+        MPI_Gatherv(
+            (local_elems > 0 ? local_buf.data() :nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            sendptr,
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+}
+
+size_t QuantumCircuitMPI::scatterState(vector<complex<double>> &local_buf) {
+    int rank = 0; int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    size_t N = state_vector.size();
+    MPI_Bcast(&N, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    vector<int> counts_elems(size), displs_elems(size);
+    {
+        size_t base = N / size;
+        size_t rem = N % size;
+        for(int r=0;r<size;r++) {
+            counts_elems[r] = base + (r < (int)rem ? 1 : 0);
+            displs_elems[r] = (r == 0) ? 0 : displs_elems[r-1] + counts_elems[r-1];
+        }
+    }
+
+    int local_elems = counts_elems[rank];
+    local_buf.resize(local_elems);
+
+    {
+        MAQREL_PROFILE_COMM("MPI_Scatterv", sizeof(complex<double>)*local_elems);
+        MPI_Scatterv(
+            (rank == 0 ? state_vector.data() : nullptr),
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            (local_elems > 0 ? local_buf.data() : nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+    return displs_elems[rank];
+}
+
+vector<double> QuantumCircuitMPI::maskedMarginal(size_t mask) {
+    vector<complex<double>> local_buf;
+    size_t offset = scatterState(local_buf);
+
+    vector<double> hist(1ULL<<QuantumBits::popcount(mask), 0.0);
+    {
+        MAQREL_PROFILE_KERNEL("mpi marginal", sizeof(complex<double>)*local_buf.size());
+        for(size_t i=0; i<local_buf.size(); i++){
+            hist[QuantumBits::compactBits(offset+i, mask)] += norm(local_buf[i]);
+        }
+    }
+    {
+        MAQREL_PROFILE_COMM("MPI_Allreduce", sizeof(double)*hist.size());
+        MPI_Allreduce(MPI_IN_PLACE, hist.data(), (int)hist.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    return hist;
+}
+
+vector<double> QuantumCircuitMPI::zParityExpectations(const vector<size_t> &z_masks) {
+    vector<complex<double>> local_buf;
+    size_t offset = scatterState(local_buf);
+
+    size_t support = 0;
+    for(size_t m: z_masks) support |= m;
+
+    // every rank allocates and reduces the whole histogram, so it may not outgrow a rank's slice;
+    // the slice size is the same on every rank, so they all take the same branch
+    int size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    int local_qubits = 0;
+    while((2ULL<<local_qubits) <= (1ULL<<qubit_count)/size) local_qubits++;
+
+    // every rank ends up with the full result
+    if(PauliParity::useHistogram(z_masks.size(), support, local_qubits)){
+        vector<double> hist(1ULL<<QuantumBits::popcount(support), 0.0);
+        for(size_t i=0; i<local_buf.size(); i++){
+            hist[QuantumBits::compactBits(offset+i, support)] += norm(local_buf[i]);
+        }
+        {
+            MAQREL_PROFILE_COMM("MPI_Allreduce", sizeof(double)*hist.size());
+            MPI_Allreduce(MPI_IN_PLACE, hist.data(), (int)hist.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        }
+        PauliParity::walshHadamard(hist);
+        return PauliParity::fromTransformed(hist, z_masks, support);
+    }
+
+    vector<double> values(z_masks.size(), 0.0);
+    for(size_t i=0; i<local_buf.size(); i++){
+        double p = norm(local_buf[i]);
+        for(size_t t=0; t<z_masks.size(); t++){
+            values[t] += QuantumBits::parity((offset+i) & z_masks[t]) ? -p : p;
+        }
+    }
+    {
+        MAQREL_PROFILE_COMM("MPI_Allreduce", sizeof(double)*values.size());
+        MPI_Allreduce(MPI_IN_PLACE, values.data(), (int)values.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    return values;
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitMPI::clone() {
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitMPI(*this));
+}
+
+complex<double> QuantumCircuitMPI::innerProduct(QuantumCircuitBase &other) {
+    checkSameQubits(other);
+    complex<double> sum = 0.0;
+    QuantumCircuitMPI *distributed = dynamic_cast<QuantumCircuitMPI*>(&other);
+    if (distributed) {
+        // both states are split the same way
+        vector<complex<double>> local_buf, other_buf;
+        scatterState(local_buf);
+        distributed->scatterState(other_buf);
+        {
+            MAQREL_PROFILE_KERNEL("mpi inner product", 2*sizeof(complex<double>)*local_buf.size());
+            for(size_t i=0; i<local_buf.size(); i++) sum += conj(local_buf[i]) * other_buf[i];
+        }
+        {
+            MAQREL_PROFILE_COMM("MPI_Allreduce", sizeof(complex<double>));
+            MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_CXX_DOUBLE_COMPLEX, MPI_SUM, MPI_COMM_WORLD);
+        }
+        return sum;
+    }
+
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) sum = QuantumCircuitBase::innerProduct(other);
+    MPI_Bcast(&sum, 1, MPI_CXX_DOUBLE_COMPLEX, 0, MPI_COMM_WORLD);
+    return sum;
+}
+
+double QuantumCircuitMPI::stateNorm() {
+    vector<complex<double>> local_buf;
+    scatterState(local_buf);
+    double sum = 0.0;
+    for(const complex<double> &a: local_buf) sum += norm(a);
+    {
+        MAQREL_PROFILE_COMM("MPI_Allreduce", sizeof(double));
+        MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    return sqrt(sum);
+}
+
+complex<double> QuantumCircuitMPI::amplitude(size_t index) {
+    if (index >= state_vector.size()) throw out_of_range("Basis state index out of range.");
+    // only rank 0 holds the state
+    complex<double> a = state_vector[index];
+    MPI_Bcast(&a, 1, MPI_CXX_DOUBLE_COMPLEX, 0, MPI_COMM_WORLD);
+    return a;
+}
+
+void QuantumCircuitMPI::applyPauliRotation(size_t x_mask, size_t z_mask, double theta) {
+    int rank = 0; int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int pivot = (x_mask == 0) ? -1 : QuantumBits::highestBit(x_mask);
+
+    // parts of 2^local_bits amplitudes, a power of two of them, each holding whole pairs
+    int parts = 1, local_bits = qubit_count;
+    while(parts*2 <= size && local_bits-1 > pivot) {
+        parts *= 2;
+        local_bits--;
+    }
+
+    const int part_size = 1 << local_bits;
+    vector<int> counts_elems(size, 0), displs_elems(size, 0);
+    for(int r = 0; r < parts; r++) {
+        counts_elems[r] = part_size;
+        displs_elems[r] = r * part_size;
+    }
+
+    int local_elems = counts_elems[rank];
+    vector<complex<double>> local_buf(local_elems);
+    complex<double> *sendptr = (rank == 0 ? state_vector.data() : nullptr);
+
+    {
+        MAQREL_PROFILE_COMM("MPI_Scatterv", sizeof(complex<double>)*local_elems);
+        MPI_Scatterv(
+            sendptr,
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            (local_elems > 0 ? local_buf.data() : nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+
+    if(local_elems > 0) {
+        MAQREL_PROFILE_KERNEL("mpi pauli rotation", 2*sizeof(complex<double>)*local_elems);
+        // the signs depend on the global index
+        size_t offset = displs_elems[rank];
+        if(x_mask == 0) {
+            auto op = QuantumGates::PauliPhase_Function(z_mask, theta);
+            for(int i = 0; i < local_elems; i++) op(offset + i, local_buf[i]);
+        } else {
+            auto op = QuantumGates::PauliRotation_Function(x_mask, z_mask, theta);
+            for(size_t k = 0; k < (size_t)local_elems/2; k++) {
+                size_t j = QuantumBits::insertZeroBit(k, pivot);
+                op(offset + j, local_buf[j], local_buf[j^x_mask]);
+            }
+        }
+    }
+
+    {
+        MAQREL_PROFILE_COMM("MPI_Gatherv", sizeof(complex<double>)*local_elems);
+        MPI_Gatherv(
+            (local_elems > 0 ? local_buf.data() : nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            sendptr,
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+}
+
+void QuantumCircuitMPI::QFT(const vector<int> &qubits, bool inverse) {
+    checkRegister(qubits);
+    MAQREL_PROFILE_GATE("QFT");
+
+    int rank = 0; int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    QuantumFourier::Plan plan = QuantumFourier::makePlan(qubits, inverse);
+    int top = *max_element(qubits.begin(), qubits.end());
+
+    // the state is cut into parts of 2^local_bits amplitudes, a power of two of them so
+    // that every slice of the register stays inside one part
+    int parts = 1, local_bits = qubit_count;
+    while(parts*2 <= size && local_bits-1 > top) {
+        parts *= 2;
+        local_bits--;
+    }
+
+    if(parts == 1) {
+        if(rank == 0) {
+            MAQREL_PROFILE_KERNEL("mpi qft", 2*sizeof(complex<double>)*state_vector.size());
+            QuantumFourier::apply(state_vector.data(), state_vector.size(), plan);
+        }
+        addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+        return;
+    }
+
+    const int part_size = 1 << local_bits;
+    vector<int> counts_elems(size, 0), displs_elems(size, 0);
+    for(int r = 0; r < parts; r++) {
+        counts_elems[r] = part_size;
+        displs_elems[r] = r * part_size;
+    }
+
+    int local_elems = counts_elems[rank];
+    vector<complex<double>> local_buf(local_elems);
+    complex<double> *sendptr = (rank == 0 ? state_vector.data() : nullptr);
+
+    {
+        MAQREL_PROFILE_COMM("MPI_Scatterv", sizeof(complex<double>)*local_elems);
+        MPI_Scatterv(
+            sendptr,
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            (local_elems > 0 ? local_buf.data() : nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+
+    if(local_elems > 0) {
+        MAQREL_PROFILE_KERNEL("mpi qft", 2*sizeof(complex<double>)*local_elems);
+        QuantumFourier::apply(local_buf.data(), local_elems, plan);
+    }
+
+    {
+        MAQREL_PROFILE_COMM("MPI_Gatherv", sizeof(complex<double>)*local_elems);
+        MPI_Gatherv(
+            (local_elems > 0 ? local_buf.data() : nullptr),
+            local_elems,
+            MPI_CXX_DOUBLE_COMPLEX,
+            sendptr,
+            counts_elems.data(),
+            displs_elems.data(),
+            MPI_CXX_DOUBLE_COMPLEX,
+            0,
+            MPI_COMM_WORLD
+        );
+    }
+    addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+}
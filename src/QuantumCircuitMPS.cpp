@@ -0,0 +1,785 @@
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+#include <MaQrel/QuantumCircuitMPS.h>
+#include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumVisualization.h>
+using namespace std;
+
+namespace {
+
+    //A (rows x cols, row major) = U diag(S) V^H with U rows x k and V cols x k (row major),
+    //k = min(rows, cols) and S sorted in decreasing order. One-sided Jacobi, accurate for
+    //the small singular values that decide the truncation.
+    void svd(const vector<complex<double>> &a, size_t rows, size_t cols,
+             vector<complex<double>> &u, vector<double> &s, vector<complex<double>> &v){
+        if(cols > rows){
+            //A^H = V S U^H
+            vector<complex<double>> adjoint(cols*rows);
+            for(size_t r=0; r<rows; r++){
+                for(size_t c=0; c<cols; c++) adjoint[c*rows+r] = conj(a[r*cols+c]);
+            }
+            svd(adjoint, cols, rows, v, s, u);
+            return;
+        }
+
+        //columns are orthogonalised in place, stored column major
+        vector<complex<double>> w(rows*cols), vc(cols*cols, 0.0);
+        for(size_t r=0; r<rows; r++){
+            for(size_t c=0; c<cols; c++) w[c*rows+r] = a[r*cols+c];
+        }
+        for(size_t c=0; c<cols; c++) vc[c*cols+c] = 1.0;
+
+        for(int sweep=0; sweep<60; sweep++){
+            bool rotated = false;
+            for(size_t i=0; i+1<cols; i++){
+                for(size_t j=i+1; j<cols; j++){
+                    complex<double> *wi = &w[i*rows], *wj = &w[j*rows];
+                    double alpha = 0.0, beta = 0.0;
+                    complex<double> gamma = 0.0;
+                    for(size_t r=0; r<rows; r++){
+                        alpha += norm(wi[r]);
+                        beta += norm(wj[r]);
+                        gamma += conj(wi[r]) * wj[r];
+                    }
+                    double g = abs(gamma);
+                    if(g <= 1e-15*sqrt(alpha*beta) || g < 1e-300) continue;
+                    rotated = true;
+
+                    //column j is turned by the phase of gamma, then a real rotation
+                    complex<double> phase = conj(gamma) / g;
+                    double zeta = (beta - alpha) / (2.0*g);
+                    double t = (zeta >= 0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta*zeta));
+                    double c = 1.0 / sqrt(1.0 + t*t), sn = c*t;
+                    for(size_t r=0; r<rows; r++){
+                        complex<double> x = wi[r], y = wj[r]*phase;
+                        wi[r] = c*x - sn*y;
+                        wj[r] = sn*x + c*y;
+                    }
+                    complex<double> *vi = &vc[i*cols], *vj = &vc[j*cols];
+                    for(size_t r=0; r<cols; r++){
+                        complex<double> x = vi[r], y = vj[r]*phase;
+                        vi[r] = c*x - sn*y;
+                        vj[r] = sn*x + c*y;
+                    }
+                }
+            }
+            if(!rotated) break;
+        }
+
+        vector<double> lengths(cols);
+        for(size_t c=0; c<cols; c++){
+            double sum = 0.0;
+            for(size_t r=0; r<rows; r++) sum += norm(w[c*rows+r]);
+            lengths[c] = sqrt(sum);
+        }
+        vector<size_t> order(cols);
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&](size_t x, size_t y){ return lengths[x] > lengths[y]; });
+
+        u.assign(rows*cols, 0.0);
+        v.assign(cols*cols, 0.0);
+        s.resize(cols);
+        for(size_t k=0; k<cols; k++){
+            size_t c = order[k];
+            s[k] = lengths[c];
+            if(s[k] > 0){
+                for(size_t r=0; r<rows; r++) u[r*cols+k] = w[c*rows+r] / s[k];
+            }
+            for(size_t r=0; r<cols; r++) v[r*cols+k] = vc[c*cols+r];
+        }
+    }
+
+    //number of singular values to keep, discarded gets their share of the total weight
+    size_t keepCount(const vector<double> &s, size_t max_keep, double cutoff, double &discarded){
+        double total = 0.0;
+        for(double x: s) total += x*x;
+        discarded = 0.0;
+        size_t k = s.size();
+        if(total <= 0) return 1;
+        while(k > 1){
+            double weight = s[k-1]*s[k-1] / total;
+            if(k > max_keep || s[k-1] <= 1e-14*s[0] || discarded + weight <= cutoff){
+                discarded += weight;
+                k--;
+            }else break;
+        }
+        return k;
+    }
+}
+
+QuantumCircuitMPS::QuantumCircuitMPS(int n, int max_bond_dim, double cutoff) :
+    QuantumCircuitBase(n, false),
+    max_bond_dim(max_bond_dim),
+    cutoff(cutoff)
+{
+    if(max_bond_dim <= 0) throw invalid_argument("Bond dimension must be positive.");
+    if(cutoff < 0) throw invalid_argument("Cutoff cannot be negative.");
+    resetTo(vector<int>(n, 0));
+}
+
+void QuantumCircuitMPS::checkQubit(int qubit) const {
+    if(qubit<0 || qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+}
+
+void QuantumCircuitMPS::checkDense() const {
+    if(qubit_count > MAX_DENSE_QUBITS) throw logic_error("The state of " + to_string(qubit_count) + " qubits is too large to expand into a state vector.");
+}
+
+int QuantumCircuitMPS::getBondDimension(int qubit) const {
+    if(qubit<0 || qubit>=qubit_count-1) throw out_of_range("Bond is out of range.");
+    return sites[qubit].right;
+}
+
+int QuantumCircuitMPS::getMaxBondDimension() const {
+    int bond = 1;
+    for(auto &site: sites) bond = max(bond, site.right);
+    return bond;
+}
+
+void QuantumCircuitMPS::resetTo(const vector<int> &bits){
+    sites.assign(qubit_count, Site());
+    for(int q=0; q<qubit_count; q++){
+        sites[q].data = {0.0, 0.0};
+        sites[q].data[bits[q]] = 1.0;
+    }
+    center = 0;
+}
+
+void QuantumCircuitMPS::resetAll(int index){
+    vector<int> bits(qubit_count, 0);
+    for(int q=0; q<qubit_count && q<31; q++) bits[q] = (index>>q) & 1;
+    resetTo(bits);
+    truncation_error = 0.0;
+}
+
+//Canonical form
+
+void QuantumCircuitMPS::moveCenter(int qubit){
+    vector<complex<double>> u, v;
+    vector<double> s;
+    double discarded;
+
+    while(center < qubit){
+        //A = U (S V^H), U stays and S V^H moves into the next site
+        Site &site = sites[center], &next = sites[center+1];
+        size_t rows = 2*site.left, cols = site.right;
+        svd(site.data, rows, cols, u, s, v);
+        size_t full = s.size(), k = keepCount(s, SIZE_MAX, 0.0, discarded);
+
+        vector<complex<double>> a(rows*k);
+        for(size_t r=0; r<rows; r++){
+            for(size_t j=0; j<k; j++) a[r*k+j] = u[r*full+j];
+        }
+        vector<complex<double>> moved(k*2*next.right, 0.0);
+        for(size_t j=0; j<k; j++){
+            for(size_t m=0; m<cols; m++){
+                complex<double> carry = s[j] * conj(v[m*full+j]);
+                for(size_t rest=0; rest<2*(size_t)next.right; rest++) moved[j*2*next.right+rest] += carry * next.data[m*2*next.right+rest];
+            }
+        }
+        site.data.swap(a);
+        site.right = k;
+        next.data.swap(moved);
+        next.left = k;
+        center++;
+    }
+
+    while(center > qubit){
+        //A = (U S) V^H, V^H stays and U S moves into the previous site
+        Site &site = sites[center], &prev = sites[center-1];
+        size_t rows = site.left, cols = 2*site.right;
+        svd(site.data, rows, cols, u, s, v);
+        size_t full = s.size(), k = keepCount(s, SIZE_MAX, 0.0, discarded);
+
+        vector<complex<double>> b(k*cols);
+        for(size_t j=0; j<k; j++){
+            for(size_t c=0; c<cols; c++) b[j*cols+c] = conj(v[c*full+j]);
+        }
+        size_t prev_rows = 2*prev.left;
+        vector<complex<double>> moved(prev_rows*k, 0.0);
+        for(size_t r=0; r<prev_rows; r++){
+            for(size_t m=0; m<rows; m++){
+                complex<double> x = prev.data[r*rows+m];
+                for(size_t j=0; j<k; j++) moved[r*k+j] += x * u[m*full+j] * s[j];
+            }
+        }
+        site.data.swap(b);
+        site.left = k;
+        prev.data.swap(moved);
+        prev.right = k;
+        center--;
+    }
+}
+
+//Gate application
+
+void QuantumCircuitMPS::applyMatrix(int qubit, const Matrix2 &u){
+    //a unitary on the physical index keeps the site canonical
+    Site &site = sites[qubit];
+    for(int l=0; l<site.left; l++){
+        for(int r=0; r<site.right; r++){
+            complex<double> &a = site.data[(l*2)*site.right+r];
+            complex<double> &b = site.data[(l*2+1)*site.right+r];
+            complex<double> a_old = a, b_old = b;
+            a = u[0]*a_old + u[1]*b_old;
+            b = u[2]*a_old + u[3]*b_old;
+        }
+    }
+}
+
+void QuantumCircuitMPS::applyAdjacent(int left, const Matrix4 &u){
+    if(center != left && center != left+1) moveCenter(left);
+    Site &a = sites[left], &b = sites[left+1];
+    size_t dl = a.left, dm = a.right, dr = b.right;
+
+    //theta[l][s1][s2][r], which is also the (2*dl) x (2*dr) matrix to split
+    vector<complex<double>> theta(dl*4*dr, 0.0);
+    for(size_t l=0; l<dl; l++){
+        for(size_t s1=0; s1<2; s1++){
+            for(size_t m=0; m<dm; m++){
+                complex<double> x = a.data[(l*2+s1)*dm+m];
+                if(x == 0.0) continue;
+                for(size_t rest=0; rest<2*dr; rest++) theta[(l*2+s1)*2*dr+rest] += x * b.data[m*2*dr+rest];
+            }
+        }
+    }
+    for(size_t l=0; l<dl; l++){
+        for(size_t r=0; r<dr; r++){
+            complex<double> in[4], out[4];
+            for(int k=0; k<4; k++) in[k] = theta[((l*2+(k>>1))*2+(k&1))*dr+r];
+            for(int row=0; row<4; row++){
+                out[row] = u[row*4]*in[0] + u[row*4+1]*in[1] + u[row*4+2]*in[2] + u[row*4+3]*in[3];
+            }
+            for(int k=0; k<4; k++) theta[((l*2+(k>>1))*2+(k&1))*dr+r] = out[k];
+        }
+    }
+
+    vector<complex<double>> us, vs;
+    vector<double> s;
+    svd(theta, 2*dl, 2*dr, us, s, vs);
+    double discarded;
+    size_t full = s.size(), k = keepCount(s, max_bond_dim, cutoff, discarded);
+    truncation_error += discarded;
+
+    double kept = 0.0;
+    for(size_t j=0; j<k; j++) kept += s[j]*s[j];
+    double scale = 1.0 / sqrt(kept);
+
+    a.data.assign(dl*2*k, 0.0);
+    for(size_t r=0; r<2*dl; r++){
+        for(size_t j=0; j<k; j++) a.data[r*k+j] = us[r*full+j];
+    }
+    b.data.assign(k*2*dr, 0.0);
+    for(size_t j=0; j<k; j++){
+        for(size_t c=0; c<2*dr; c++) b.data[j*2*dr+c] = s[j] * scale * conj(vs[c*full+j]);
+    }
+    a.right = k;
+    b.left = k;
+    center = left+1;
+}
+
+void QuantumCircuitMPS::applyMatrix(int qubit_1, int qubit_2, const Matrix4 &u){
+    if(qubit_1 > qubit_2){
+        //reorder the basis to (qubit_2, qubit_1)
+        Matrix4 swapped;
+        auto flip = [](int i){ return ((i&1)<<1) | (i>>1); };
+        for(int r=0; r<4; r++){
+            for(int c=0; c<4; c++) swapped[flip(r)*4+flip(c)] = u[r*4+c];
+        }
+        applyMatrix(qubit_2, qubit_1, swapped);
+        return;
+    }
+
+    static const Matrix4 swap_gate = {1,0,0,0, 0,0,1,0, 0,1,0,0, 0,0,0,1};
+    //walk qubit_1 next to qubit_2, apply, and walk it back
+    for(int site=qubit_1; site<qubit_2-1; site++) applyAdjacent(site, swap_gate);
+    applyAdjacent(qubit_2-1, u);
+    for(int site=qubit_2-2; site>=qubit_1; site--) applyAdjacent(site, swap_gate);
+}
+
+void QuantumCircuitMPS::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
+    checkQubit(target_qubit);
+    applyMatrix(target_qubit, QuantumGates::singleQubitMatrix(op));
+}
+
+void QuantumCircuitMPS::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    applyMatrix(qubit_1, qubit_2, QuantumGates::twoQubitMatrix(op));
+}
+
+void QuantumCircuitMPS::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
+    if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0) throw out_of_range("Qubits out of range.");
+    if(control_qubit == target_qubit) throw invalid_argument("Control and target qubits cannot be the same.");
+
+    Matrix2 m = QuantumGates::singleQubitMatrix(op);
+    Matrix4 u = {1,0,0,0, 0,1,0,0, 0,0,m[0],m[1], 0,0,m[2],m[3]};
+    applyMatrix(control_qubit, target_qubit, u);
+}
+
+void QuantumCircuitMPS::QFT(const vector<int> &qubits, bool inverse){
+    checkRegister(qubits);
+    applyQFTGates(qubits, inverse);
+}
+
+//Measurement
+
+string QuantumCircuitMPS::bitString(const vector<int> &bits) const {
+    string basis(qubit_count, '0');
+    for(int q=0; q<qubit_count; q++){
+        if(bits[q]) basis[qubit_count-1-q] = '1';
+    }
+    return basis;
+}
+
+vector<int> QuantumCircuitMPS::sampleBits(mt19937_64 &gen){
+    //with the center on qubit 0 everything to the right is right canonical, so the
+    //probability of each next bit only needs the contraction of the bits fixed so far
+    moveCenter(0);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<int> bits(qubit_count);
+    vector<complex<double>> env = {1.0};
+    for(int q=0; q<qubit_count; q++){
+        const Site &site = sites[q];
+        vector<complex<double>> branch[2];
+        double weight[2];
+        for(int s=0; s<2; s++){
+            branch[s].assign(site.right, 0.0);
+            for(int l=0; l<site.left; l++){
+                if(env[l] == 0.0) continue;
+                for(int r=0; r<site.right; r++) branch[s][r] += env[l] * site.data[(l*2+s)*site.right+r];
+            }
+            weight[s] = 0.0;
+            for(auto &x: branch[s]) weight[s] += norm(x);
+        }
+        int bit = uniform(gen) * (weight[0]+weight[1]) < weight[1] ? 1 : 0;
+        bits[q] = bit;
+        double scale = 1.0 / sqrt(weight[bit]);
+        env.swap(branch[bit]);
+        for(auto &x: env) x *= scale;
+    }
+    return bits;
+}
+
+map<string,int> QuantumCircuitMPS::run(int num_shots){
+    static random_device rd;
+    static mt19937_64 gen(rd());
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        result[bitString(sampleBits(gen))]++;
+    }
+
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return result;
+}
+
+map<string,int> QuantumCircuitMPS::run_range_of_qubits(int num_shots, const vector<int> &qubits){
+    for(int q: qubits) checkQubit(q);
+    static random_device rd;
+    static mt19937_64 gen(rd());
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        vector<int> bits = sampleBits(gen);
+        string output;
+        for(int q:qubits){
+            output += bits[q] ? '1' : '0'; //Measurement returned in the same order as the qubits input vector
+        }
+        result[output]++;
+    }
+    for(auto &q: qubits) circuit[q] += "[M]";
+    return result;
+}
+
+string QuantumCircuitMPS::collapse(){
+    static random_device rd;
+    static mt19937_64 gen(rd());
+    vector<int> bits = sampleBits(gen);
+    resetTo(bits);
+
+    string basis_state = bitString(bits);
+    cout << basis_state << "\n";
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return basis_state;
+}
+
+int QuantumCircuitMPS::measureQubit(int qubit){
+    checkQubit(qubit);
+    moveCenter(qubit);
+    Site &site = sites[qubit];
+
+    double prob_of_one = 0.0, total = 0.0;
+    for(int l=0; l<site.left; l++){
+        for(int r=0; r<site.right; r++){
+            prob_of_one += norm(site.data[(l*2+1)*site.right+r]);
+            total += norm(site.data[(l*2)*site.right+r]) + norm(site.data[(l*2+1)*site.right+r]);
+        }
+    }
+    prob_of_one /= total;
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    bernoulli_distribution dist(prob_of_one);
+    int measurement = dist(gen);
+
+    double norm_factor = sqrt(measurement == 1 ? prob_of_one*total : (1.0-prob_of_one)*total);
+    for(int l=0; l<site.left; l++){
+        for(int r=0; r<site.right; r++){
+            site.data[(l*2+measurement)*site.right+r] /= norm_factor;
+            site.data[(l*2+1-measurement)*site.right+r] = 0.0;
+        }
+    }
+    return measurement;
+}
+
+int QuantumCircuitMPS::measure_single_qubit(int qubit){
+    int measurement = measureQubit(qubit);
+    addCircuit(qubit,"M");
+    return measurement;
+}
+
+string QuantumCircuitMPS::measure_range_of_qubits(const vector<int> &qubits){
+    for(int q: qubits) checkQubit(q);
+    string output;
+    for(int q: qubits){
+        output += measureQubit(q) ? '1' : '0'; //Measurement returned in the same order as the qubits input vector
+        circuit[q] += "[M]";
+    }
+    cout << "Measurement in order given: " << output;
+    return output;
+}
+
+//Expectation values
+
+complex<double> QuantumCircuitMPS::expectOperators(const vector<const Matrix2*> &ops){
+    int first = 0, last = qubit_count-1;
+    while(first < qubit_count && !ops[first]) first++;
+    if(first == qubit_count) return 1.0;
+    while(!ops[last]) last--;
+
+    //left of first is left canonical and right of last right canonical, so only
+    //the sites in between are contracted
+    moveCenter(first);
+    int d = sites[first].left;
+    vector<complex<double>> env(d*d, 0.0);
+    for(int l=0; l<d; l++) env[l*d+l] = 1.0;
+
+    for(int q=first; q<=last; q++){
+        const Site &site = sites[q];
+        int dl = site.left, dr = site.right;
+        //ket[l][t][r'] = sum_l' env[l][l'] A[l'][t][r']
+        vector<complex<double>> ket(dl*2*dr, 0.0);
+        for(int l=0; l<dl; l++){
+            for(int m=0; m<dl; m++){
+                complex<double> e = env[l*dl+m];
+                if(e == 0.0) continue;
+                for(int rest=0; rest<2*dr; rest++) ket[l*2*dr+rest] += e * site.data[m*2*dr+rest];
+            }
+        }
+        if(ops[q]){
+            const Matrix2 &op = *ops[q];
+            for(int l=0; l<dl; l++){
+                for(int r=0; r<dr; r++){
+                    complex<double> a = ket[(l*2)*dr+r], b = ket[(l*2+1)*dr+r];
+                    ket[(l*2)*dr+r] = op[0]*a + op[1]*b;
+                    ket[(l*2+1)*dr+r] = op[2]*a + op[3]*b;
+                }
+            }
+        }
+        //env'[r][r'] = sum_{l,s} conj(A[l][s][r]) ket[l][s][r']
+        vector<complex<double>> next(dr*dr, 0.0);
+        for(int ls=0; ls<2*dl; ls++){
+            for(int r=0; r<dr; r++){
+                complex<double> bra = conj(site.data[ls*dr+r]);
+                if(bra == 0.0) continue;
+                for(int rp=0; rp<dr; rp++) next[r*dr+rp] += bra * ket[ls*dr+rp];
+            }
+        }
+        env.swap(next);
+    }
+
+    complex<double> trace = 0.0;
+    int dr = sites[last].right;
+    for(int r=0; r<dr; r++) trace += env[r*dr+r];
+    return trace;
+}
+
+namespace {
+    const array<complex<double>,4> PAULI_X = {0.0, 1.0, 1.0, 0.0};
+    const array<complex<double>,4> PAULI_Y = {0.0, complex<double>(0,-1), complex<double>(0,1), 0.0};
+    const array<complex<double>,4> PAULI_Z = {1.0, 0.0, 0.0, -1.0};
+}
+
+double QuantumCircuitMPS::expectZ(const vector<int> &q){
+    vector<const Matrix2*> ops(qubit_count, nullptr);
+    for(int j: q){
+        if(j<0 || j>=qubit_count) throw out_of_range("Qubits out of range.");
+        //Z twice is the identity
+        ops[j] = ops[j] ? nullptr : &PAULI_Z;
+    }
+    return expectOperators(ops).real();
+}
+
+vector<double> QuantumCircuitMPS::zParityExpectations(const vector<size_t> &z_masks){
+    vector<double> values;
+    for(size_t mask: z_masks){
+        vector<const Matrix2*> ops(qubit_count, nullptr);
+        for(int q=0; q<qubit_count && q<64; q++){
+            if((mask>>q) & 1) ops[q] = &PAULI_Z;
+        }
+        values.push_back(expectOperators(ops).real());
+    }
+    return values;
+}
+
+vector<double> QuantumCircuitMPS::maskedMarginal(size_t mask){
+    vector<double> hist(1ULL<<QuantumBits::popcount(mask), 0.0);
+    if(mask == 0){
+        hist[0] = 1.0;
+        return hist;
+    }
+    int first = __builtin_ctzll(mask), last = 63 - __builtin_clzll(mask);
+    if(last >= qubit_count) throw out_of_range("Qubits out of range.");
+
+    //same contraction as expectOperators, but the register sites are projected on
+    //|0> and |1> separately, so every outcome so far keeps its own environment
+    moveCenter(first);
+    int d = sites[first].left;
+    vector<vector<complex<double>>> envs(1, vector<complex<double>>(d*d, 0.0));
+    for(int l=0; l<d; l++) envs[0][l*d+l] = 1.0;
+
+    //env'[r][r'] += sum_l conj(A[l][s][r]) sum_m env[l][m] A[m][s][r']
+    auto project = [](const vector<complex<double>> &env, const Site &site, int s, vector<complex<double>> &next){
+        int dl = site.left, dr = site.right;
+        vector<complex<double>> ket(dl*dr, 0.0);
+        for(int l=0; l<dl; l++){
+            for(int m=0; m<dl; m++){
+                complex<double> e = env[l*dl+m];
+                if(e == 0.0) continue;
+                for(int r=0; r<dr; r++) ket[l*dr+r] += e * site.data[(m*2+s)*dr+r];
+            }
+        }
+        for(int l=0; l<dl; l++){
+            for(int r=0; r<dr; r++){
+                complex<double> bra = conj(site.data[(l*2+s)*dr+r]);
+                if(bra == 0.0) continue;
+                for(int rr=0; rr<dr; rr++) next[r*dr+rr] += bra * ket[l*dr+rr];
+            }
+        }
+    };
+
+    for(int q=first; q<=last; q++){
+        const Site &site = sites[q];
+        size_t dr = site.right;
+        bool measured = (mask>>q) & 1;
+        //the bit of q goes above those of the earlier register qubits, as in compactBits
+        vector<vector<complex<double>>> next(envs.size() * (measured ? 2 : 1), vector<complex<double>>(dr*dr, 0.0));
+        for(size_t o=0; o<envs.size(); o++){
+            for(int s=0; s<2; s++) project(envs[o], site, s, measured ? next[o | ((size_t)s << QuantumBits::popcount(mask & ((1ULL<<q)-1)))] : next[o]);
+        }
+        envs.swap(next);
+    }
+
+    //right of last is right canonical, so the trace of each environment is its probability
+    double total = 0.0;
+    for(size_t o=0; o<envs.size(); o++){
+        int dr = sites[last].right;
+        double p = 0.0;
+        for(int r=0; r<dr; r++) p += envs[o][r*dr+r].real();
+        hist[o] = max(p, 0.0);
+        total += hist[o];
+    }
+    for(auto &p: hist) p /= total;
+    return hist;
+}
+
+double QuantumCircuitMPS::expectation(const Observable &observable){
+    double expect = observable.getIdentityCoefficient();
+    for(auto &term: observable.getTerms()){
+        if(qubit_count < 64 && ((term.x_mask|term.z_mask) >> qubit_count) != 0) throw out_of_range("Observable acts on qubits out of range.");
+        vector<const Matrix2*> ops(qubit_count, nullptr);
+        for(int q=0; q<qubit_count && q<64; q++){
+            bool x = (term.x_mask>>q) & 1, z = (term.z_mask>>q) & 1;
+            if(x || z) ops[q] = x ? (z ? &PAULI_Y : &PAULI_X) : &PAULI_Z;
+        }
+        expect += term.coefficient * expectOperators(ops).real();
+    }
+    return expect;
+}
+
+//Dense conversion
+
+vector<complex<double>> QuantumCircuitMPS::toStateVector(){
+    checkDense();
+    //psi[index][bond], qubit q is bit q of index
+    vector<complex<double>> psi = {1.0};
+    size_t size = 1;
+    for(int q=0; q<qubit_count; q++){
+        const Site &site = sites[q];
+        vector<complex<double>> next(2*size*site.right, 0.0);
+        for(size_t index=0; index<size; index++){
+            for(int l=0; l<site.left; l++){
+                complex<double> x = psi[index*site.left+l];
+                if(x == 0.0) continue;
+                for(int s=0; s<2; s++){
+                    size_t target = index | ((size_t)s<<q);
+                    for(int r=0; r<site.right; r++) next[target*site.right+r] += x * site.data[(l*2+s)*site.right+r];
+                }
+            }
+        }
+        psi.swap(next);
+        size *= 2;
+    }
+    return psi;
+}
+
+void QuantumCircuitMPS::saveState(const string &path, QuantumSnapshot::Precision precision){
+    QuantumSnapshot::write(path, toStateVector(), qubit_count, precision);
+}
+
+void QuantumCircuitMPS::loadState(const string &path){
+    checkDense();
+    QuantumSnapshot::MappedSnapshot snapshot(path);
+    if(snapshot.qubitCount() != qubit_count) throw invalid_argument("Snapshot has " + to_string(snapshot.qubitCount()) + " qubits, circuit has " + to_string(qubit_count) + ".");
+    vector<complex<double>> amplitudes;
+    snapshot.copyTo(amplitudes);
+    importState(amplitudes);
+
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[L]";
+    }
+}
+
+vector<complex<double>> QuantumCircuitMPS::exportState(){
+    return toStateVector();
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitMPS::clone(){
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitMPS(*this));
+}
+
+complex<double> QuantumCircuitMPS::innerProduct(QuantumCircuitBase &other){
+    checkSameQubits(other);
+    QuantumCircuitMPS *mps = dynamic_cast<QuantumCircuitMPS*>(&other);
+    if(!mps) return QuantumCircuitBase::innerProduct(other);
+
+    //env[la*B.left+lb], the contraction of the sites left of q
+    vector<complex<double>> env = {1.0};
+    for(int q=0; q<qubit_count; q++){
+        const Site &a = sites[q], &b = mps->sites[q];
+        //half[(la*2+s)*b.right+rb] = sum_lb env[la][lb] B[lb][s][rb]
+        vector<complex<double>> half(a.left*2*b.right, 0.0);
+        for(int la=0; la<a.left; la++){
+            for(int lb=0; lb<b.left; lb++){
+                complex<double> e = env[la*b.left+lb];
+                if(e == 0.0) continue;
+                for(int s=0; s<2; s++){
+                    for(int rb=0; rb<b.right; rb++) half[(la*2+s)*b.right+rb] += e * b.data[(lb*2+s)*b.right+rb];
+                }
+            }
+        }
+        vector<complex<double>> next(a.right*b.right, 0.0);
+        for(int la=0; la<a.left; la++){
+            for(int s=0; s<2; s++){
+                for(int ra=0; ra<a.right; ra++){
+                    complex<double> x = conj(a.data[(la*2+s)*a.right+ra]);
+                    if(x == 0.0) continue;
+                    for(int rb=0; rb<b.right; rb++) next[ra*b.right+rb] += x * half[(la*2+s)*b.right+rb];
+                }
+            }
+        }
+        env.swap(next);
+    }
+    return env[0];
+}
+
+double QuantumCircuitMPS::stateNorm(){
+    return sqrt(max(0.0, innerProduct(*this).real()));
+}
+
+complex<double> QuantumCircuitMPS::amplitude(size_t index){
+    if(qubit_count < 64 && (index >> qubit_count)) throw out_of_range("Basis state index out of range.");
+    vector<complex<double>> row = {1.0};
+    for(int q=0; q<qubit_count; q++){
+        const Site &site = sites[q];
+        int s = (index >> q) & 1;
+        vector<complex<double>> next(site.right, 0.0);
+        for(int l=0; l<site.left; l++){
+            if(row[l] == 0.0) continue;
+            for(int r=0; r<site.right; r++) next[r] += row[l] * site.data[(l*2+s)*site.right+r];
+        }
+        row.swap(next);
+    }
+    return row[0];
+}
+
+void QuantumCircuitMPS::importState(const vector<complex<double>> &amplitudes){
+    checkDense();
+    checkStateSize(amplitudes.size());
+    vector<complex<double>> rest = amplitudes;
+
+    //peel off one qubit at a time from the left with an SVD
+    vector<complex<double>> u, v;
+    vector<double> s;
+    size_t bond = 1;
+    for(int q=0; q<qubit_count-1; q++){
+        size_t cols = rest.size() / (2*bond);
+        //row (l, bit q), column = remaining qubits
+        vector<complex<double>> matrix(2*bond*cols);
+        for(size_t l=0; l<bond; l++){
+            for(size_t c=0; c<cols; c++){
+                for(size_t b=0; b<2; b++) matrix[(l*2+b)*cols+c] = rest[l*2*cols + c*2 + b];
+            }
+        }
+        svd(matrix, 2*bond, cols, u, s, v);
+        double discarded;
+        size_t full = s.size(), k = keepCount(s, max_bond_dim, cutoff, discarded);
+        truncation_error += discarded;
+
+        sites[q].left = bond;
+        sites[q].right = k;
+        sites[q].data.assign(2*bond*k, 0.0);
+        for(size_t r=0; r<2*bond; r++){
+            for(size_t j=0; j<k; j++) sites[q].data[r*k+j] = u[r*full+j];
+        }
+        rest.assign(k*cols, 0.0);
+        for(size_t j=0; j<k; j++){
+            for(size_t c=0; c<cols; c++) rest[j*cols+c] = s[j] * conj(v[c*full+j]);
+        }
+        bond = k;
+    }
+    Site &last = sites[qubit_count-1];
+    last.left = bond;
+    last.right = 1;
+    last.data = rest;
+
+    //renormalise whatever the truncation removed
+    double total = 0.0;
+    for(auto &x: last.data) total += norm(x);
+    for(auto &x: last.data) x /= sqrt(total);
+    center = qubit_count-1;
+}
+
+void QuantumCircuitMPS::printState(){
+    QuantumVisualization::printState(toStateVector(), qubit_count);
+}
+
+void QuantumCircuitMPS::printProbabilities(){
+    QuantumVisualization::printProbabilities(toStateVector(), qubit_count);
+}
+
+void QuantumCircuitMPS::displayGraph(){
+    QuantumVisualization::displayGraph(toStateVector(), qubit_count);
+}
+
+void QuantumCircuitMPS::displayHeatMap(){
+    QuantumVisualization::displayHeatMap(toStateVector(), qubit_count);
+}
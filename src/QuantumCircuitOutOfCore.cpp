@@ -0,0 +1,561 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <future>
+#include <stdexcept>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <MaQrel/QuantumCircuitOutOfCore.h>
+#include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumFourier.h>
+#include <MaQrel/QuantumVisualization.h>
+using namespace std;
+
+namespace {
+
+    //k with a zero bit inserted at position bit
+    inline size_t insertZero(size_t k, int bit){
+        return ((k >> bit) << (bit+1)) | (k & ((1ULL<<bit)-1));
+    }
+
+    void singleKernel(complex<double> *buf, size_t size, int target, const function<void(complex<double>&,complex<double>&)> &op){
+        size_t block_size = 1ULL<<target;
+        #pragma omp parallel for
+        for(size_t k=0; k<size/2; k++){
+            size_t i = insertZero(k, target);
+            op(buf[i], buf[i|block_size]);
+        }
+    }
+
+    void controlledKernel(complex<double> *buf, size_t size, int control, int target, const function<void(complex<double>&,complex<double>&)> &op){
+        size_t control_mask = 1ULL<<control;
+        size_t block_size = 1ULL<<target;
+        int lo = min(control, target), hi = max(control, target);
+        #pragma omp parallel for
+        for(size_t k=0; k<size/4; k++){
+            size_t i = insertZero(insertZero(k, lo), hi) | control_mask;
+            op(buf[i], buf[i|block_size]);
+        }
+    }
+
+    void twoQubitKernel(complex<double> *buf, size_t size, int qubit_1, int qubit_2,
+                        const function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> &op){
+        size_t bit_1 = 1ULL<<qubit_1, bit_2 = 1ULL<<qubit_2;
+        int lo = min(qubit_1, qubit_2), hi = max(qubit_1, qubit_2);
+        //same argument order as QuantumCircuitBase::applyTwoQubitOp
+        #pragma omp parallel for
+        for(size_t k=0; k<size/4; k++){
+            size_t i = insertZero(insertZero(k, lo), hi);
+            op(buf[i], buf[i|bit_2], buf[i|bit_1], buf[i|bit_1|bit_2]);
+        }
+    }
+
+    void fileIO(int fd, void *buffer, size_t bytes, size_t offset, bool store){
+        char *ptr = static_cast<char*>(buffer);
+        while(bytes > 0){
+            ssize_t done = store ? pwrite(fd, ptr, bytes, offset) : pread(fd, ptr, bytes, offset);
+            if(done <= 0) throw runtime_error(store ? "Failed writing the out-of-core state." : "Failed reading the out-of-core state.");
+            ptr += done;
+            offset += done;
+            bytes -= done;
+        }
+    }
+}
+
+QuantumCircuitOutOfCore::QuantumCircuitOutOfCore(int n, const string &backing_file, int chunk_qubits) :
+    QuantumCircuitBase(n, false),
+    backing_file(backing_file),
+    chunk_qubits(min(chunk_qubits, n))
+{
+    if(n >= 64) throw invalid_argument("Number of qubits must be below 64.");
+    if(chunk_qubits <= 0) throw invalid_argument("Chunks must hold at least one qubit.");
+    chunk_size = 1ULL<<this->chunk_qubits;
+
+    fd = open(backing_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) throw runtime_error("Could not open backing file " + backing_file);
+
+    vector<int> identity(n);
+    for(int q=0; q<n; q++) identity[q] = q;
+    vector<unsigned char> head = QuantumSnapshot::encodeHeader(n, identity, QuantumSnapshot::Precision::Double);
+    data_offset = head.size();
+    fileIO(fd, head.data(), head.size(), 0, true);
+    resetTo(0);
+}
+
+QuantumCircuitOutOfCore::~QuantumCircuitOutOfCore(){
+    if(fd >= 0){
+        close(fd);
+        unlink(backing_file.c_str());
+    }
+}
+
+//Queueing gates
+
+void QuantumCircuitOutOfCore::enqueue(PendingOp op){
+    size_t high = 0;
+    if(op.qubit_1 >= chunk_qubits) high |= 1ULL<<op.qubit_1;
+    if(op.kind != OpKind::Single && op.qubit_2 >= chunk_qubits) high |= 1ULL<<op.qubit_2;
+
+    //too many chunks would have to be resident at once, finish the current batch first
+    if(QuantumBits::popcount(pending_high_mask | high) > MAX_GROUP_QUBITS) flush();
+    pending_high_mask |= high;
+    pending.push_back(move(op));
+}
+
+void QuantumCircuitOutOfCore::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
+    if(target_qubit<0 || target_qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+    enqueue({OpKind::Single, target_qubit, -1, move(op), nullptr});
+}
+
+void QuantumCircuitOutOfCore::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
+    if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0) throw out_of_range("Qubits out of range.");
+    if(control_qubit == target_qubit) throw invalid_argument("Control and target qubits cannot be the same.");
+    enqueue({OpKind::Controlled, control_qubit, target_qubit, move(op), nullptr});
+}
+
+void QuantumCircuitOutOfCore::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    enqueue({OpKind::Two, qubit_1, qubit_2, nullptr, move(op)});
+}
+
+int QuantumCircuitOutOfCore::bufferQubit(int qubit, size_t high_mask) const {
+    if(qubit < chunk_qubits) return qubit;
+    return chunk_qubits + QuantumBits::popcount(high_mask & ((1ULL<<qubit)-1));
+}
+
+void QuantumCircuitOutOfCore::flush(){
+    if(pending.empty()) return;
+    size_t high_mask = pending_high_mask;
+    vector<PendingOp> ops;
+    ops.swap(pending);
+    pending_high_mask = 0;
+
+    size_t group_size = chunk_size << QuantumBits::popcount(high_mask);
+    sweep(high_mask, [&](complex<double> *buf, size_t){
+        //every queued gate runs while the group is resident
+        for(auto &op: ops){
+            int q1 = bufferQubit(op.qubit_1, high_mask);
+            switch(op.kind){
+                case OpKind::Single: singleKernel(buf, group_size, q1, op.op); break;
+                case OpKind::Controlled: controlledKernel(buf, group_size, q1, bufferQubit(op.qubit_2, high_mask), op.op); break;
+                case OpKind::Two: twoQubitKernel(buf, group_size, q1, bufferQubit(op.qubit_2, high_mask), op.two_qubit_op); break;
+            }
+        }
+    }, true);
+}
+
+void QuantumCircuitOutOfCore::QFT(const vector<int> &qubits, bool inverse){
+    checkRegister(qubits);
+    size_t high_mask = 0;
+    for(int q: qubits){
+        if(q >= chunk_qubits) high_mask |= 1ULL<<q;
+    }
+    if(QuantumBits::popcount(high_mask) > MAX_GROUP_QUBITS){
+        applyQFTGates(qubits, inverse);
+        return;
+    }
+    flush();
+
+    //the register as positions inside a resident group
+    vector<int> buffer_qubits;
+    for(int q: qubits) buffer_qubits.push_back(bufferQubit(q, high_mask));
+    QuantumFourier::Plan plan = QuantumFourier::makePlan(buffer_qubits, inverse);
+    size_t group_size = chunk_size << QuantumBits::popcount(high_mask);
+    sweep(high_mask, [&](complex<double> *buf, size_t){
+        QuantumFourier::apply(buf, group_size, plan);
+    }, true);
+    addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+}
+
+//Streaming over the file
+
+void QuantumCircuitOutOfCore::transferChunk(size_t chunk, complex<double> *buffer, bool store){
+    fileIO(fd, buffer, chunk_size*sizeof(complex<double>), data_offset + chunk*chunk_size*sizeof(complex<double>), store);
+}
+
+void QuantumCircuitOutOfCore::sweep(size_t high_mask, const function<void(complex<double>*, size_t)> &body, bool write_back){
+    size_t num_chunks = 1ULL<<(qubit_count-chunk_qubits);
+    size_t group_mask = high_mask >> chunk_qubits; //as chunk index bits
+    size_t members = 1ULL<<QuantumBits::popcount(group_mask);
+    size_t free_mask = (num_chunks-1) & ~group_mask;
+    size_t num_groups = num_chunks / members;
+
+    for(auto &buffer: buffers) buffer.resize(members*chunk_size);
+
+    auto transfer = [&](size_t group, complex<double> *buffer, bool store){
+        size_t first = QuantumBits::depositBits(group, free_mask);
+        for(size_t m=0; m<members; m++){
+            transferChunk(first | QuantumBits::depositBits(m, group_mask), buffer + m*chunk_size, store);
+        }
+    };
+
+    //the next group is read and the previous one written back while body runs
+    future<void> loading = async(launch::async, transfer, 0, buffers[0].data(), false);
+    future<void> storing[2];
+    for(size_t g=0; g<num_groups; g++){
+        int current = g & 1;
+        loading.get();
+        if(g+1 < num_groups){
+            int next = current ^ 1;
+            if(storing[next].valid()) storing[next].get();
+            loading = async(launch::async, transfer, g+1, buffers[next].data(), false);
+        }
+        body(buffers[current].data(), QuantumBits::depositBits(g, free_mask));
+        if(write_back) storing[current] = async(launch::async, transfer, g, buffers[current].data(), true);
+    }
+    for(auto &store: storing){
+        if(store.valid()) store.get();
+    }
+    sweep_count++;
+}
+
+void QuantumCircuitOutOfCore::resetTo(size_t index){
+    pending.clear();
+    pending_high_mask = 0;
+    //dropping the data and growing the file again gives zeros without writing them
+    size_t bytes = (1ULL<<qubit_count)*sizeof(complex<double>);
+    if(ftruncate(fd, data_offset) != 0 || ftruncate(fd, data_offset + bytes) != 0) throw runtime_error("Could not resize the backing file.");
+    complex<double> one = 1.0;
+    fileIO(fd, &one, sizeof(one), data_offset + index*sizeof(complex<double>), true);
+}
+
+void QuantumCircuitOutOfCore::resetAll(int index){
+    if(index < 0 || (size_t)index >= (1ULL<<qubit_count)) throw out_of_range("Index out of range.");
+    resetTo(index);
+}
+
+//Measurements
+
+int QuantumCircuitOutOfCore::measure_single_qubit(int qubit){
+    if(qubit<0 || qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+    flush();
+
+    auto bitOf = [&](size_t chunk, size_t local){
+        return qubit >= chunk_qubits ? (chunk >> (qubit-chunk_qubits)) & 1 : (local >> qubit) & 1;
+    };
+
+    double prob_of_one = 0.0;
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        for(size_t i=0; i<chunk_size; i++){
+            if(bitOf(chunk, i)) prob_of_one += norm(buf[i]);
+        }
+    }, false);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    bernoulli_distribution dist(prob_of_one);
+    int measurement = dist(gen);
+    double norm_factor = measurement == 1 ? sqrt(prob_of_one) : sqrt(1.0-prob_of_one);
+
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        for(size_t i=0; i<chunk_size; i++){
+            if((int)bitOf(chunk, i) == measurement) buf[i] /= norm_factor;
+            else buf[i] = 0.0;
+        }
+    }, true);
+
+    addCircuit(qubit,"M");
+    return measurement;
+}
+
+vector<size_t> QuantumCircuitOutOfCore::sample(int num_shots){
+    flush();
+    size_t num_chunks = 1ULL<<(qubit_count-chunk_qubits);
+    vector<double> chunk_prob(num_chunks, 0.0);
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        double sum = 0.0;
+        for(size_t i=0; i<chunk_size; i++) sum += norm(buf[i]);
+        chunk_prob[chunk] = sum;
+    }, false);
+
+    //sorted uniform draws, then one more pass finds the index under each of them
+    static random_device rd;
+    static mt19937 gen(rd());
+    double total = 0.0;
+    for(double p: chunk_prob) total += p;
+    uniform_real_distribution<> dist(0.0, total);
+    vector<double> draws(num_shots);
+    for(auto &d: draws) d = dist(gen);
+    sort(draws.begin(), draws.end());
+
+    //draws [first_draw[c], first_draw[c+1]) land in chunk c
+    vector<size_t> first_draw(num_chunks+1, draws.size());
+    vector<double> chunk_start(num_chunks, 0.0);
+    {
+        double cumulative = 0.0;
+        size_t d = 0;
+        for(size_t c=0; c<num_chunks; c++){
+            first_draw[c] = d;
+            chunk_start[c] = cumulative;
+            cumulative += chunk_prob[c];
+            while(d < draws.size() && (draws[d] < cumulative || c == num_chunks-1)) d++;
+        }
+    }
+
+    vector<size_t> indices;
+    indices.reserve(num_shots);
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        size_t d = first_draw[chunk], end = first_draw[chunk+1];
+        double cumulative = chunk_start[chunk];
+        for(size_t i=0; i<chunk_size && d<end; i++){
+            cumulative += norm(buf[i]);
+            while(d < end && (draws[d] < cumulative || i == chunk_size-1)){
+                indices.push_back((chunk<<chunk_qubits) | i);
+                d++;
+            }
+        }
+    }, false);
+    return indices;
+}
+
+map<string,int> QuantumCircuitOutOfCore::run(int num_shots){
+    map<string,int> result;
+    for(size_t index: sample(num_shots)){
+        result[QuantumVisualization::basisString(index, qubit_count)]++;
+    }
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return result;
+}
+
+string QuantumCircuitOutOfCore::collapse(){
+    size_t index = sample(1)[0];
+    resetTo(index);
+    string basis_state = QuantumVisualization::basisString(index, qubit_count);
+    cout << basis_state << "\n";
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return basis_state;
+}
+
+vector<double> QuantumCircuitOutOfCore::maskedMarginal(size_t mask){
+    if(QuantumBits::popcount(mask) > PauliParity::HISTOGRAM_MAX_QUBITS) throw invalid_argument("Too many qubits in the range.");
+    flush();
+    vector<double> prob(1ULL<<QuantumBits::popcount(mask), 0.0);
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        size_t base = chunk<<chunk_qubits;
+        for(size_t i=0; i<chunk_size; i++) prob[QuantumBits::compactBits(base|i, mask)] += norm(buf[i]);
+    }, false);
+    return prob;
+}
+
+string QuantumCircuitOutOfCore::measure_range_of_qubits(const vector<int> &qubits){
+    size_t mask = 0;
+    for(auto& q:qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask |= 1ULL<<q;
+    }
+    vector<double> weights = maskedMarginal(mask);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+    size_t outcome = dist(gen);
+    double norm_factor = sqrt(weights[outcome]);
+    size_t measurement = QuantumBits::depositBits(outcome, mask);
+
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        size_t base = chunk<<chunk_qubits;
+        for(size_t i=0; i<chunk_size; i++){
+            if(((base|i)&mask) == measurement) buf[i] /= norm_factor;
+            else buf[i] = 0.0;
+        }
+    }, true);
+
+    for(auto &q: qubits) circuit[q] += "[M]";
+    string output;
+    for(int q:qubits){
+        output += (((measurement>>q) & 1) ? '1' : '0');
+    }
+    cout << "Measurement in order given: " << output;
+    return output;
+}
+
+map<string,int> QuantumCircuitOutOfCore::run_range_of_qubits(int num_shots, const vector<int> &qubits){
+    size_t mask = 0;
+    for(auto& q:qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask |= 1ULL<<q;
+    }
+    vector<double> weights = maskedMarginal(mask);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        size_t measurement = QuantumBits::depositBits(dist(gen), mask);
+        string output;
+        for(int q:qubits){
+            output += (((measurement>>q) & 1) ? '1' : '0');
+        }
+        result[output]++;
+    }
+    for(auto &q: qubits) circuit[q] += "[M]";
+    return result;
+}
+
+vector<double> QuantumCircuitOutOfCore::zParityExpectations(const vector<size_t> &z_masks){
+    flush();
+    size_t support = 0;
+    for(size_t m: z_masks) support |= m;
+
+    if(PauliParity::useHistogram(z_masks.size(), support) && QuantumBits::popcount(support) <= PauliParity::HISTOGRAM_MAX_QUBITS){
+        vector<double> hist = maskedMarginal(support);
+        PauliParity::walshHadamard(hist);
+        return PauliParity::fromTransformed(hist, z_masks, support);
+    }
+
+    vector<double> values(z_masks.size(), 0.0);
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        size_t base = chunk<<chunk_qubits;
+        for(size_t i=0; i<chunk_size; i++){
+            double p = norm(buf[i]);
+            for(size_t t=0; t<z_masks.size(); t++){
+                values[t] += QuantumBits::parity((base|i) & z_masks[t]) ? -p : p;
+            }
+        }
+    }, false);
+    return values;
+}
+
+double QuantumCircuitOutOfCore::expectation(const Observable &observable){
+    const vector<PauliTerm> &terms = observable.getTerms();
+    double expect = observable.getIdentityCoefficient();
+
+    for(auto &group: observable.qubitWiseGroups()){
+        size_t x_basis = 0, y_basis = 0;
+        vector<size_t> z_masks;
+        for(int t: group){
+            const PauliTerm &term = terms[t];
+            if(((term.x_mask|term.z_mask) >> qubit_count) != 0) throw out_of_range("Observable acts on qubits out of range.");
+            x_basis |= term.x_mask & ~term.z_mask;
+            y_basis |= term.x_mask & term.z_mask;
+            z_masks.push_back(term.x_mask | term.z_mask);
+        }
+
+        //there is no room for a copy, so the rotation is undone instead; the inverse
+        //rotation is queued and rides along with the next sweep
+        rotateToZBasis(x_basis, y_basis);
+        vector<double> values = zParityExpectations(z_masks);
+        for(int q=0; q<qubit_count; q++){
+            if((x_basis>>q) & 1) applySingleQubitOp(q, QuantumGates::H_Function());
+            else if((y_basis>>q) & 1){
+                applySingleQubitOp(q, QuantumGates::H_Function());
+                applySingleQubitOp(q, QuantumGates::Phase_Function(QuantumGates::I));
+            }
+        }
+
+        for(size_t k=0; k<group.size(); k++) expect += terms[group[k]].coefficient * values[k];
+    }
+    return expect;
+}
+
+//Snapshots
+
+void QuantumCircuitOutOfCore::saveState(const string &path, QuantumSnapshot::Precision precision){
+    flush();
+    int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out < 0) throw runtime_error("Could not open snapshot file " + path);
+
+    vector<int> identity(qubit_count);
+    for(int q=0; q<qubit_count; q++) identity[q] = q;
+    vector<unsigned char> head = QuantumSnapshot::encodeHeader(qubit_count, identity, precision);
+    size_t offset = 0;
+    vector<complex<float>> narrow;
+    try{
+        fileIO(out, head.data(), head.size(), offset, true);
+        offset += head.size();
+        sweep(0, [&](complex<double> *buf, size_t){
+            if(precision == QuantumSnapshot::Precision::Double){
+                fileIO(out, buf, chunk_size*sizeof(complex<double>), offset, true);
+                offset += chunk_size*sizeof(complex<double>);
+                return;
+            }
+            narrow.resize(chunk_size);
+            for(size_t i=0; i<chunk_size; i++) narrow[i] = complex<float>(buf[i]);
+            fileIO(out, narrow.data(), chunk_size*sizeof(complex<float>), offset, true);
+            offset += chunk_size*sizeof(complex<float>);
+        }, false);
+    }catch(...){
+        close(out);
+        throw;
+    }
+    close(out);
+}
+
+void QuantumCircuitOutOfCore::loadState(const string &path){
+    QuantumSnapshot::MappedSnapshot snapshot(path);
+    if(snapshot.qubitCount() != qubit_count) throw invalid_argument("Snapshot has " + to_string(snapshot.qubitCount()) + " qubits, circuit has " + to_string(qubit_count) + ".");
+    pending.clear();
+    pending_high_mask = 0;
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        snapshot.copyRange(chunk<<chunk_qubits, chunk_size, buf);
+    }, true);
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[L]";
+    }
+}
+
+vector<complex<double>> QuantumCircuitOutOfCore::exportState(){
+    flush();
+    vector<complex<double>> amplitudes(1ULL<<qubit_count);
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        copy(buf, buf+chunk_size, amplitudes.begin() + (chunk<<chunk_qubits));
+    }, false);
+    return amplitudes;
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitOutOfCore::clone(){
+    throw logic_error("Out-of-core circuits cannot be cloned, copy the state with saveState and loadState.");
+}
+
+void QuantumCircuitOutOfCore::importState(const vector<complex<double>> &amplitudes){
+    checkStateSize(amplitudes.size());
+    pending.clear();
+    pending_high_mask = 0;
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        auto first = amplitudes.begin() + (chunk<<chunk_qubits);
+        copy(first, first+chunk_size, buf);
+    }, true);
+}
+
+//Output
+
+void QuantumCircuitOutOfCore::printState(){
+    flush();
+    cout << "Current State Vector" << "\n";
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        for(size_t i=0; i<chunk_size; i++){
+            cout << "|" << QuantumVisualization::basisString((chunk<<chunk_qubits)|i, qubit_count) << "> :" << buf[i] << "\n";
+        }
+    }, false);
+}
+
+void QuantumCircuitOutOfCore::printProbabilities(){
+    flush();
+    cout << fixed << setprecision(6);
+    cout << qubit_count << "-Qubit Measurement Results" << "\n";
+    sweep(0, [&](complex<double> *buf, size_t chunk){
+        for(size_t i=0; i<chunk_size; i++){
+            double prob = norm(buf[i]);
+            if(prob >= QuantumVisualization::PROB_THRESHOLD) cout << "Probability of |" << QuantumVisualization::basisString((chunk<<chunk_qubits)|i, qubit_count) << ">: " << prob << "\n";
+        }
+    }, false);
+    cout << "----------------------------\n";
+}
+
+void QuantumCircuitOutOfCore::displayGraph(){
+    throw logic_error("displayGraph is not supported by the out-of-core backend, use printProbabilities.");
+}
+
+void QuantumCircuitOutOfCore::displayHeatMap(){
+    throw logic_error("displayHeatMap is not supported by the out-of-core backend, use printProbabilities.");
+}
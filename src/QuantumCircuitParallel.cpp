@@ -1,42 +1,389 @@
-#include <omp.h>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
 #include <MaQrel/QuantumCircuitParallel.h>
 #include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumProfiler.h>
+#include <MaQrel/QuantumFourier.h>
+#include <MaQrel/QuantumThreadPool.h>
 
 using namespace std;
 
-QuantumCircuitParallel::QuantumCircuitParallel(int n) : QuantumCircuitBase(n) {}
+QuantumCircuitParallel::QuantumCircuitParallel(int n) : QuantumCircuitParallel(n, QuantumThreadPool::shared()) {}
 
-//Function for applying single qubit operations
+QuantumCircuitParallel::QuantumCircuitParallel(int n, QuantumThreadPool &pool) :
+    QuantumCircuitBase(n),
+    pool(pool)
+{
+    //a few blocks per thread, so the queue still spreads over the pool
+    int split_bits = 2;
+    while((1 << split_bits) < 4*pool.size()) split_bits++;
+    local_qubits = max(0, min(MAX_LOCAL_QUBITS, n - split_bits));
+}
+
+//Gate kernels, one pool loop over the amplitude pairs
 
 void QuantumCircuitParallel::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
     if(target_qubit<0 || target_qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+    if(target_qubit < local_qubits){
+        pending.push_back({-1, target_qubit, move(op)});
+        return;
+    }
+    flush();
+    MAQREL_PROFILE_KERNEL("parallel single-qubit", 2*sizeof(complex<double>)*state_vector.size());
 
-    size_t block_size = 1ULL<<target_qubit;
-    size_t stride = 1ULL<<(target_qubit+1);
-
-    #pragma omp parallel for
-    for(int i=0;i<state_vector.size();i+=stride){
-        for(int j=0;j<block_size;j++){
-            op(state_vector[i+j],state_vector[i+j+block_size]);
+    size_t bit = 1ULL<<target_qubit;
+    complex<double> *state = state_vector.data();
+    pool.parallelFor(state_vector.size()/2, GRAIN, [&](size_t first, size_t last){
+        for(size_t k=first; k<last; k++){
+            size_t i = QuantumBits::insertZeroBit(k, target_qubit);
+            op(state[i], state[i|bit]);
         }
-    }
+    });
 }
 
 //Funcion for applying controlled operations
 
 void QuantumCircuitParallel::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
     if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0 || control_qubit == target_qubit) throw out_of_range("Qubits out of range.");
+    if(control_qubit < local_qubits && target_qubit < local_qubits){
+        pending.push_back({control_qubit, target_qubit, move(op)});
+        return;
+    }
+    flush();
+    //only the quarter with the control set and the target clear is visited
+    MAQREL_PROFILE_KERNEL("parallel controlled", sizeof(complex<double>)*state_vector.size());
 
-    size_t control_mask = 1ULL << control_qubit;
-    size_t block_size = 1ULL << target_qubit;
-    size_t stride = 1ULL <<(target_qubit+1);
+    size_t control_bit = 1ULL<<control_qubit, bit = 1ULL<<target_qubit;
+    int low = min(control_qubit, target_qubit), high = max(control_qubit, target_qubit);
+    complex<double> *state = state_vector.data();
+    pool.parallelFor(state_vector.size()/4, GRAIN, [&](size_t first, size_t last){
+        for(size_t k=first; k<last; k++){
+            size_t i = QuantumBits::insertZeroBit(QuantumBits::insertZeroBit(k, low), high) | control_bit;
+            op(state[i], state[i|bit]);
+        }
+    });
+}
 
-    #pragma omp parallel for
-    for(int i=0;i<state_vector.size();i+=stride){
-        for(int j=0;j<block_size;j++){
-            if(((i+j)&control_mask)!=0) op(state_vector[i+j],state_vector[i+j+block_size]);
+void QuantumCircuitParallel::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    flush();
+    MAQREL_PROFILE_KERNEL("parallel two-qubit", 2*sizeof(complex<double>)*state_vector.size());
+
+    int q_a = min(qubit_1, qubit_2), q_b = max(qubit_1, qubit_2);
+    size_t bit_a = 1ULL<<q_a, bit_b = 1ULL<<q_b;
+    complex<double> *state = state_vector.data();
+    pool.parallelFor(state_vector.size()/4, GRAIN, [&](size_t first, size_t last){
+        for(size_t k=first; k<last; k++){
+            size_t i = QuantumBits::insertZeroBit(QuantumBits::insertZeroBit(k, q_a), q_b);
+            //same argument order as the serial kernel
+            if(q_b == qubit_1) op(state[i], state[i|bit_a], state[i|bit_b], state[i|bit_a|bit_b]);
+            else op(state[i], state[i|bit_b], state[i|bit_a], state[i|bit_a|bit_b]);
         }
+    });
+}
+
+//Pauli rotation, every pair of amplitudes it mixes once
+
+void QuantumCircuitParallel::applyPauliRotation(size_t x_mask, size_t z_mask, double theta){
+    flush();
+    MAQREL_PROFILE_KERNEL("parallel pauli rotation", 2*sizeof(complex<double>)*state_vector.size());
+    complex<double> *state = state_vector.data();
+
+    if(x_mask == 0){
+        auto op = QuantumGates::PauliPhase_Function(z_mask, theta);
+        pool.parallelFor(state_vector.size(), GRAIN, [&](size_t first, size_t last){
+            for(size_t i=first; i<last; i++) op(i, state[i]);
+        });
+        return;
     }
-}
\ No newline at end of file
+    int pivot = QuantumBits::highestBit(x_mask);
+    auto op = QuantumGates::PauliRotation_Function(x_mask, z_mask, theta);
+    pool.parallelFor(state_vector.size()/2, GRAIN, [&](size_t first, size_t last){
+        for(size_t k=first; k<last; k++){
+            size_t j = QuantumBits::insertZeroBit(k, pivot);
+            op(j, state[j], state[j^x_mask]);
+        }
+    });
+}
+
+//Queued local gates, every block runs the whole queue
+
+void QuantumCircuitParallel::flush(){
+    if(pending.empty()) return;
+    MAQREL_PROFILE_KERNEL("parallel local batch", 2*sizeof(complex<double>)*state_vector.size());
+
+    size_t block_size = 1ULL<<local_qubits;
+    complex<double> *state = state_vector.data();
+    pool.parallelFor(state_vector.size() >> local_qubits, 1, [&](size_t first, size_t last){
+        for(size_t b=first; b<last; b++){
+            complex<double> *block = state + b*block_size;
+            for(const LocalOp &local: pending){
+                size_t bit = 1ULL<<local.target;
+                if(local.control < 0){
+                    for(size_t k=0; k<block_size/2; k++){
+                        size_t i = QuantumBits::insertZeroBit(k, local.target);
+                        local.op(block[i], block[i|bit]);
+                    }
+                }else{
+                    size_t control_bit = 1ULL<<local.control;
+                    int low = min(local.control, local.target), high = max(local.control, local.target);
+                    for(size_t k=0; k<block_size/4; k++){
+                        size_t i = QuantumBits::insertZeroBit(QuantumBits::insertZeroBit(k, low), high) | control_bit;
+                        local.op(block[i], block[i|bit]);
+                    }
+                }
+            }
+        }
+    });
+    pending.clear();
+}
+
+//Everything else reads or replaces the state, so the queue goes first
+
+string QuantumCircuitParallel::collapse(){
+    flush();
+    return QuantumCircuitBase::collapse();
+}
+
+map<string,int> QuantumCircuitParallel::run(int num_shots){
+    flush();
+    return QuantumCircuitBase::run(num_shots);
+}
+
+int QuantumCircuitParallel::measure_single_qubit(int qubit){
+    flush();
+    return QuantumCircuitBase::measure_single_qubit(qubit);
+}
+
+void QuantumCircuitParallel::resetAll(int index){
+    pending.clear();
+    QuantumCircuitBase::resetAll(index);
+}
+
+void QuantumCircuitParallel::saveState(const string &path, QuantumSnapshot::Precision precision){
+    flush();
+    QuantumCircuitBase::saveState(path, precision);
+}
+
+void QuantumCircuitParallel::loadState(const string &path){
+    pending.clear();
+    QuantumCircuitBase::loadState(path);
+}
+
+vector<complex<double>> QuantumCircuitParallel::exportState(){
+    flush();
+    return QuantumCircuitBase::exportState();
+}
+
+void QuantumCircuitParallel::importState(const vector<complex<double>> &amplitudes){
+    pending.clear();
+    QuantumCircuitBase::importState(amplitudes);
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitParallel::clone(){
+    flush();
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitParallel(*this));
+}
+
+complex<double> QuantumCircuitParallel::innerProduct(QuantumCircuitBase &other){
+    checkSameQubits(other);
+    vector<complex<double>> buffer, other_buffer;
+    const complex<double> *a = denseAmplitudes(*this, buffer).data();
+    const complex<double> *b = denseAmplitudes(other, other_buffer).data();
+    MAQREL_PROFILE_KERNEL("parallel inner product", 2*sizeof(complex<double>)*state_vector.size());
+
+    size_t num_states = state_vector.size();
+    vector<complex<double>> partial((num_states + GRAIN - 1) / GRAIN, 0.0);
+    //the pool hands out whole chunks, or everything at once when it runs inline
+    pool.parallelFor(num_states, GRAIN, [&](size_t first, size_t last){
+        for(size_t chunk=first; chunk<last; chunk+=GRAIN){
+            complex<double> sum = 0.0;
+            for(size_t i=chunk; i<min(last, chunk+GRAIN); i++) sum += conj(a[i]) * b[i];
+            partial[chunk / GRAIN] = sum;
+        }
+    });
+    complex<double> total = 0.0;
+    for(const complex<double> &p: partial) total += p;
+    return total;
+}
+
+double QuantumCircuitParallel::stateNorm(){
+    flush();
+    MAQREL_PROFILE_KERNEL("parallel norm", sizeof(complex<double>)*state_vector.size());
+    size_t num_states = state_vector.size();
+    const complex<double> *a = state_vector.data();
+    vector<double> partial((num_states + GRAIN - 1) / GRAIN, 0.0);
+    pool.parallelFor(num_states, GRAIN, [&](size_t first, size_t last){
+        for(size_t chunk=first; chunk<last; chunk+=GRAIN){
+            double sum = 0.0;
+            for(size_t i=chunk; i<min(last, chunk+GRAIN); i++) sum += norm(a[i]);
+            partial[chunk / GRAIN] = sum;
+        }
+    });
+    double total = 0.0;
+    for(double p: partial) total += p;
+    return sqrt(total);
+}
+
+void QuantumCircuitParallel::printState(){
+    flush();
+    QuantumCircuitBase::printState();
+}
+
+void QuantumCircuitParallel::printProbabilities(){
+    flush();
+    QuantumCircuitBase::printProbabilities();
+}
+
+void QuantumCircuitParallel::displayGraph(){
+    flush();
+    QuantumCircuitBase::displayGraph();
+}
+
+void QuantumCircuitParallel::displayHeatMap(){
+    flush();
+    QuantumCircuitBase::displayHeatMap();
+}
+
+//Marginals, per-block histograms merged bin-parallel
+
+vector<double> QuantumCircuitParallel::maskedMarginal(size_t mask){
+    flush();
+    int k = QuantumBits::popcount(mask);
+    size_t num_states = state_vector.size();
+    vector<double> hist(1ULL<<k, 0.0);
+    const complex<double> *a = state_vector.data();
+
+    if(k <= PauliParity::HISTOGRAM_MAX_QUBITS){
+        //one histogram per participant's block of the state, summed in block order
+        size_t blocks = min((size_t)pool.size(), (num_states + GRAIN - 1) / GRAIN);
+        size_t block_size = (num_states + blocks - 1) / blocks;
+        vector<vector<double>> locals(blocks);
+        pool.parallelFor(blocks, 1, [&](size_t first, size_t last){
+            for(size_t block=first; block<last; block++){
+                vector<double> &local = locals[block];
+                local.assign(hist.size(), 0.0);
+                for(size_t i=block*block_size; i<min(num_states, (block+1)*block_size); i++){
+                    local[QuantumBits::compactBits(i, mask)] += norm(a[i]);
+                }
+            }
+        });
+        pool.parallelFor(hist.size(), GRAIN, [&](size_t first, size_t last){
+            for(size_t b=first; b<last; b++){
+                double sum = 0.0;
+                for(auto &local: locals) sum += local[b];
+                hist[b] = sum;
+            }
+        });
+    }else{
+        //too large to copy per block, so each bin gathers its own amplitudes instead
+        size_t free_mask = (num_states-1) & ~mask;
+        size_t bin_grain = max<size_t>(1, GRAIN >> (qubit_count - k));
+        pool.parallelFor(hist.size(), bin_grain, [&](size_t first, size_t last){
+            for(size_t b=first; b<last; b++){
+                size_t base = QuantumBits::depositBits(b, mask);
+                double sum = 0.0;
+                size_t f = 0;
+                do{
+                    sum += norm(a[base | f]);
+                    f = (f - free_mask) & free_mask; //next subset of the free bits
+                }while(f != 0);
+                hist[b] = sum;
+            }
+        });
+    }
+    return hist;
+}
+
+//Parity expectations, per-chunk partial sums added in order
+
+vector<double> QuantumCircuitParallel::zParityExpectations(const vector<size_t> &z_masks){
+    flush();
+    MAQREL_PROFILE_KERNEL("parallel z-parity", sizeof(complex<double>)*state_vector.size());
+    size_t support = 0;
+    for(size_t m: z_masks) support |= m;
+    size_t num_states = state_vector.size();
+
+    if(PauliParity::useHistogram(z_masks.size(), support)){
+        vector<double> hist = maskedMarginal(support);
+
+        //the butterflies of each stage are independent
+        size_t n = hist.size();
+        double *h = hist.data();
+        for(size_t half=1; half<n; half<<=1){
+            pool.parallelFor(n/2, GRAIN, [&](size_t first, size_t last){
+                for(size_t j=first; j<last; j++){
+                    size_t lo = ((j & ~(half-1))<<1) | (j & (half-1));
+                    double a = h[lo], b = h[lo+half];
+                    h[lo] = a+b;
+                    h[lo+half] = a-b;
+                }
+            });
+        }
+        return PauliParity::fromTransformed(hist, z_masks, support);
+    }
+
+    size_t terms = z_masks.size();
+    const complex<double> *a = state_vector.data();
+    vector<double> partial(((num_states + GRAIN - 1) / GRAIN) * terms, 0.0);
+    pool.parallelFor(num_states, GRAIN, [&](size_t first, size_t last){
+        for(size_t chunk=first; chunk<last; chunk+=GRAIN){
+            double *local = &partial[(chunk / GRAIN) * terms];
+            for(size_t i=chunk; i<min(last, chunk+GRAIN); i++){
+                double p = norm(a[i]);
+                for(size_t t=0; t<terms; t++){
+                    local[t] += QuantumBits::parity(i & z_masks[t]) ? -p : p;
+                }
+            }
+        }
+    });
+    vector<double> values(terms, 0.0);
+    for(size_t c=0; c<partial.size(); c++) values[c % terms] += partial[c];
+    return values;
+}
+
+//QFT, one FFT per slice of the state
+
+void QuantumCircuitParallel::QFT(const vector<int> &qubits, bool inverse){
+    checkRegister(qubits);
+    flush();
+    MAQREL_PROFILE_GATE("QFT");
+    QuantumFourier::Plan plan = QuantumFourier::makePlan(qubits, inverse);
+    MAQREL_PROFILE_KERNEL("parallel qft", 2*sizeof(complex<double>)*state_vector.size());
+
+    size_t size = 1ULL<<plan.bits;
+    size_t free_mask = (state_vector.size()-1) & ~plan.register_mask;
+    size_t slices = state_vector.size() >> plan.bits;
+    complex<double> *state = state_vector.data();
+
+    if(slices >= (size_t)pool.size()){
+        pool.parallelFor(slices, 1, [&](size_t first, size_t last){
+            vector<complex<double>> buffer;
+            for(size_t s=first; s<last; s++){
+                QuantumFourier::transformSlice(state, QuantumBits::depositBits(s, free_mask), plan, buffer);
+            }
+        });
+    }else{
+        //few large slices, the gather, every butterfly stage and the scatter are split instead
+        vector<complex<double>> buffer(size);
+        complex<double> *data = buffer.data();
+        for(size_t s=0; s<slices; s++){
+            size_t base = QuantumBits::depositBits(s, free_mask);
+            pool.parallelFor(size, GRAIN, [&](size_t first, size_t last){
+                for(size_t y=first; y<last; y++) data[y] = state[base | plan.reversed_offsets[y]];
+            });
+            for(size_t half=1; half<size; half<<=1){
+                pool.parallelFor(size/2, GRAIN, [&](size_t first, size_t last){
+                    QuantumFourier::butterflyStage(data, plan, half, first, last);
+                });
+            }
+            pool.parallelFor(size, GRAIN, [&](size_t first, size_t last){
+                for(size_t y=first; y<last; y++) state[base | plan.offsets[y]] = data[y] * plan.scale;
+            });
+        }
+    }
+    addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+}
@@ -0,0 +1,515 @@
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+#include <MaQrel/QuantumCircuitSoA.h>
+#include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumFourier.h>
+#include <MaQrel/QuantumVisualization.h>
+#include <MaQrel/QuantumProfiler.h>
+using namespace std;
+
+namespace {
+
+    //shorter runs go through matrixPairs, one loop over every pair instead of a call per run
+    constexpr size_t MIN_RUN = 8;
+
+    //2x2 matrix as real and imaginary parts
+    struct SplitMatrix {
+        double u0r, u0i, u1r, u1i, u2r, u2i, u3r, u3i;
+        SplitMatrix(const array<complex<double>,4> &u) :
+            u0r(u[0].real()), u0i(u[0].imag()), u1r(u[1].real()), u1i(u[1].imag()),
+            u2r(u[2].real()), u2i(u[2].imag()), u3r(u[3].real()), u3i(u[3].imag()) {}
+
+        void apply(double &xr, double &xi, double &yr, double &yi) const {
+            double ar = xr, ai = xi, br = yr, bi = yi;
+            xr = u0r*ar - u0i*ai + u1r*br - u1i*bi;
+            xi = u0r*ai + u0i*ar + u1r*bi + u1i*br;
+            yr = u2r*ar - u2i*ai + u3r*br - u3i*bi;
+            yi = u2r*ai + u2i*ar + u3r*bi + u3i*br;
+        }
+    };
+}
+
+QuantumCircuitSoA::QuantumCircuitSoA(int n) :
+    QuantumCircuitBase(n, false)
+{
+    if(n >= 64) throw invalid_argument("Number of qubits must be below 64.");
+    re.assign(1ULL<<n, 0.0);
+    im.assign(1ULL<<n, 0.0);
+    re[0] = 1.0;
+}
+
+vector<double> QuantumCircuitSoA::probabilities() const {
+    vector<double> probs(re.size());
+    const double *xr = re.data(), *xi = im.data();
+    double *p = probs.data();
+    #pragma omp simd
+    for(size_t i=0; i<probs.size(); i++) p[i] = xr[i]*xr[i] + xi[i]*xi[i];
+    return probs;
+}
+
+void QuantumCircuitSoA::project(size_t mask, size_t value, double norm_factor){
+    double scale = 1.0/norm_factor;
+    double *xr = re.data(), *xi = im.data();
+    #pragma omp simd
+    for(size_t i=0; i<re.size(); i++){
+        double f = ((i & mask) == value) ? scale : 0.0;
+        xr[i] *= f;
+        xi[i] *= f;
+    }
+}
+
+//Gate kernels, every gate becomes a matrix that is applied to runs of contiguous amplitudes
+
+void QuantumCircuitSoA::matrixRun(size_t first, size_t length, size_t half, const array<complex<double>,4> &u){
+    double *ar = re.data() + first, *ai = im.data() + first;
+    double *br = ar + half, *bi = ai + half;
+    const SplitMatrix m(u);
+
+    if(u[1] == 0.0 && u[2] == 0.0){
+        //phases only, the two halves do not mix
+        #pragma omp simd
+        for(size_t k=0; k<length; k++){
+            double xr = ar[k], xi = ai[k], yr = br[k], yi = bi[k];
+            ar[k] = m.u0r*xr - m.u0i*xi;
+            ai[k] = m.u0r*xi + m.u0i*xr;
+            br[k] = m.u3r*yr - m.u3i*yi;
+            bi[k] = m.u3r*yi + m.u3i*yr;
+        }
+        return;
+    }
+    if(u[0] == 0.0 && u[3] == 0.0){
+        //the halves swap places, with phases
+        #pragma omp simd
+        for(size_t k=0; k<length; k++){
+            double xr = ar[k], xi = ai[k], yr = br[k], yi = bi[k];
+            ar[k] = m.u1r*yr - m.u1i*yi;
+            ai[k] = m.u1r*yi + m.u1i*yr;
+            br[k] = m.u2r*xr - m.u2i*xi;
+            bi[k] = m.u2r*xi + m.u2i*xr;
+        }
+        return;
+    }
+    #pragma omp simd
+    for(size_t k=0; k<length; k++) m.apply(ar[k], ai[k], br[k], bi[k]);
+}
+
+template<class F>
+void QuantumCircuitSoA::forEachQuartet(int qubit_1, int qubit_2, F body) const {
+    int low = min(qubit_1, qubit_2), high = max(qubit_1, qubit_2);
+    size_t low_bit = 1ULL<<low, high_bit = 1ULL<<high;
+    if(low_bit < MIN_RUN){
+        #pragma omp simd
+        for(size_t k=0; k<re.size()/4; k++) body(QuantumBits::insertZeroBit(QuantumBits::insertZeroBit(k, low), high));
+        return;
+    }
+    for(size_t i=0; i<re.size(); i+=2*high_bit){
+        for(size_t j=0; j<high_bit; j+=2*low_bit){
+            #pragma omp simd
+            for(size_t m=0; m<low_bit; m++) body(i+j+m);
+        }
+    }
+}
+
+void QuantumCircuitSoA::matrixPairs(size_t count, int low, int high, size_t set_bits, size_t half, const array<complex<double>,4> &u){
+    double *xr = re.data(), *xi = im.data();
+    const SplitMatrix m(u);
+    #pragma omp simd
+    for(size_t k=0; k<count; k++){
+        size_t i = QuantumBits::insertZeroBit(k, low);
+        if(high >= 0) i = QuantumBits::insertZeroBit(i, high);
+        i |= set_bits;
+        m.apply(xr[i], xi[i], xr[i+half], xi[i+half]);
+    }
+}
+
+void QuantumCircuitSoA::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
+    if(target_qubit<0 || target_qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+    MAQREL_PROFILE_KERNEL("soa single-qubit", 4*sizeof(double)*re.size());
+    auto u = QuantumGates::singleQubitMatrix(op);
+
+    size_t half = 1ULL<<target_qubit;
+    if(half < MIN_RUN){
+        matrixPairs(re.size()/2, target_qubit, -1, 0, half, u);
+        return;
+    }
+    for(size_t i=0; i<re.size(); i+=2*half) matrixRun(i, half, half, u);
+}
+
+void QuantumCircuitSoA::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
+    if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0) throw out_of_range("Qubits out of range.");
+    if(control_qubit == target_qubit) throw invalid_argument("Control and target qubits cannot be the same.");
+    //only the half with the control set is read and written
+    MAQREL_PROFILE_KERNEL("soa controlled", 2*sizeof(double)*re.size());
+    auto u = QuantumGates::singleQubitMatrix(op);
+
+    size_t control_bit = 1ULL<<control_qubit, half = 1ULL<<target_qubit;
+    if(min(control_bit, half) < MIN_RUN){
+        matrixPairs(re.size()/4, min(control_qubit, target_qubit), max(control_qubit, target_qubit), control_bit, half, u);
+        return;
+    }
+    for(size_t i=0; i<re.size(); i+=2*half){
+        if(control_qubit > target_qubit){
+            //the control is fixed for the whole block
+            if(i & control_bit) matrixRun(i, half, half, u);
+        }else{
+            //runs of 2^control amplitudes with the control set
+            for(size_t j=control_bit; j<half; j+=2*control_bit) matrixRun(i+j, control_bit, half, u);
+        }
+    }
+}
+
+void QuantumCircuitSoA::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    MAQREL_PROFILE_KERNEL("soa two-qubit", 4*sizeof(double)*re.size());
+    auto u = QuantumGates::twoQubitMatrix(op);
+    double ur[16], ui[16];
+    for(int k=0; k<16; k++){
+        ur[k] = u[k].real();
+        ui[k] = u[k].imag();
+    }
+    //permutations with phases (SWAP, iSWAP, diagonal gates) have one entry per row
+    int column[4];
+    bool monomial = true;
+    for(int r=0; r<4; r++){
+        int nonzero = 0;
+        for(int c=0; c<4; c++){
+            if(u[r*4+c] != 0.0){
+                column[r] = c;
+                nonzero++;
+            }
+        }
+        monomial = monomial && nonzero == 1;
+    }
+
+    //offset of row r of the matrix, r = 2*bit(qubit_1)+bit(qubit_2)
+    size_t bit_1 = 1ULL<<qubit_1, bit_2 = 1ULL<<qubit_2;
+    const size_t offsets[4] = {0, bit_2, bit_1, bit_1|bit_2};
+    double *xr = re.data(), *xi = im.data();
+
+    if(monomial){
+        //rows that keep their amplitude are skipped, SWAP only touches |01> and |10>
+        int count = 0;
+        size_t row_offsets[4], column_offsets[4];
+        double pr[4], pi[4];
+        for(int r=0; r<4; r++){
+            if(column[r] == r && u[r*4+r] == 1.0) continue;
+            row_offsets[count] = offsets[r];
+            column_offsets[count] = offsets[column[r]];
+            pr[count] = ur[r*4+column[r]];
+            pi[count] = ui[r*4+column[r]];
+            count++;
+        }
+        forEachQuartet(qubit_1, qubit_2, [&](size_t base){
+            double ar[4], ai[4];
+            for(int k=0; k<count; k++){
+                ar[k] = xr[base+column_offsets[k]];
+                ai[k] = xi[base+column_offsets[k]];
+            }
+            for(int k=0; k<count; k++){
+                xr[base+row_offsets[k]] = pr[k]*ar[k] - pi[k]*ai[k];
+                xi[base+row_offsets[k]] = pr[k]*ai[k] + pi[k]*ar[k];
+            }
+        });
+        return;
+    }
+    forEachQuartet(qubit_1, qubit_2, [&](size_t base){
+        double ar[4], ai[4];
+        for(int c=0; c<4; c++){
+            ar[c] = xr[base+offsets[c]];
+            ai[c] = xi[base+offsets[c]];
+        }
+        for(int r=0; r<4; r++){
+            double sr = 0.0, si = 0.0;
+            for(int c=0; c<4; c++){
+                sr += ur[r*4+c]*ar[c] - ui[r*4+c]*ai[c];
+                si += ur[r*4+c]*ai[c] + ui[r*4+c]*ar[c];
+            }
+            xr[base+offsets[r]] = sr;
+            xi[base+offsets[r]] = si;
+        }
+    });
+}
+
+void QuantumCircuitSoA::applyPauliRotation(size_t x_mask, size_t z_mask, double theta){
+    MAQREL_PROFILE_KERNEL("soa pauli rotation", 4*sizeof(double)*re.size());
+    if(x_mask == 0){
+        auto op = QuantumGates::PauliPhase_Function(z_mask, theta);
+        for(size_t i=0; i<re.size(); i++){
+            complex<double> a(re[i], im[i]);
+            op(i, a);
+            re[i] = a.real();
+            im[i] = a.imag();
+        }
+        return;
+    }
+    int pivot = QuantumBits::highestBit(x_mask);
+    auto op = QuantumGates::PauliRotation_Function(x_mask, z_mask, theta);
+    for(size_t k=0; k<re.size()/2; k++){
+        size_t j = QuantumBits::insertZeroBit(k, pivot), l = j^x_mask;
+        complex<double> a(re[j], im[j]), b(re[l], im[l]);
+        op(j, a, b);
+        re[j] = a.real(); im[j] = a.imag();
+        re[l] = b.real(); im[l] = b.imag();
+    }
+}
+
+void QuantumCircuitSoA::QFT(const vector<int> &qubits, bool inverse){
+    checkRegister(qubits);
+    MAQREL_PROFILE_GATE("QFT");
+    //the FFT runs on an interleaved copy, one conversion each way instead of O(k^2) gates
+    vector<complex<double>> state = exportState();
+    QuantumFourier::Plan plan = QuantumFourier::makePlan(qubits, inverse);
+    {
+        MAQREL_PROFILE_KERNEL("soa qft", 2*sizeof(complex<double>)*state.size());
+        QuantumFourier::apply(state.data(), state.size(), plan);
+    }
+    importState(state);
+    addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+}
+
+//Expectation values
+
+vector<double> QuantumCircuitSoA::zParityExpectations(const vector<size_t> &z_masks){
+    MAQREL_PROFILE_KERNEL("soa z-parity", 2*sizeof(double)*re.size());
+    size_t support = 0;
+    for(size_t m: z_masks) support |= m;
+
+    if(PauliParity::useHistogram(z_masks.size(), support)){
+        vector<double> hist = maskedMarginal(support);
+        PauliParity::walshHadamard(hist);
+        return PauliParity::fromTransformed(hist, z_masks, support);
+    }
+
+    vector<double> values(z_masks.size(), 0.0);
+    for(size_t t=0; t<z_masks.size(); t++){
+        size_t mask = z_masks[t];
+        double sum = 0.0;
+        #pragma omp simd reduction(+:sum)
+        for(size_t i=0; i<re.size(); i++){
+            double p = re[i]*re[i] + im[i]*im[i];
+            sum += QuantumBits::parity(i & mask) ? -p : p;
+        }
+        values[t] = sum;
+    }
+    return values;
+}
+
+vector<double> QuantumCircuitSoA::maskedMarginal(size_t mask){
+    vector<double> hist(1ULL<<QuantumBits::popcount(mask), 0.0);
+    for(size_t i=0; i<re.size(); i++){
+        hist[QuantumBits::compactBits(i, mask)] += re[i]*re[i] + im[i]*im[i];
+    }
+    return hist;
+}
+
+double QuantumCircuitSoA::expectation(const Observable &observable){
+    const vector<PauliTerm> &terms = observable.getTerms();
+    double expect = observable.getIdentityCoefficient();
+
+    for(auto &group: observable.qubitWiseGroups()){
+        size_t x_basis = 0, y_basis = 0;
+        vector<size_t> z_masks;
+        for(int t: group){
+            const PauliTerm &term = terms[t];
+            if(((term.x_mask|term.z_mask) >> qubit_count) != 0) throw out_of_range("Observable acts on qubits out of range.");
+            x_basis |= term.x_mask & ~term.z_mask;
+            y_basis |= term.x_mask & term.z_mask;
+            z_masks.push_back(term.x_mask | term.z_mask);
+        }
+
+        vector<double> values;
+        if((x_basis|y_basis) == 0){
+            values = zParityExpectations(z_masks);
+        }else{
+            vector<double> saved_re = re, saved_im = im;
+            rotateToZBasis(x_basis, y_basis);
+            values = zParityExpectations(z_masks);
+            re.swap(saved_re);
+            im.swap(saved_im);
+        }
+
+        for(size_t k=0; k<group.size(); k++) expect += terms[group[k]].coefficient * values[k];
+    }
+    return expect;
+}
+
+//Measurement
+
+string QuantumCircuitSoA::collapse(){
+    vector<double> weights = probabilities();
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(), weights.end());
+    size_t index = dist(gen);
+
+    resetAll(index);
+    string basis_state = QuantumVisualization::basisString(index, qubit_count);
+    cout << basis_state << "\n";
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return basis_state;
+}
+
+map<string,int> QuantumCircuitSoA::run(int num_shots){
+    vector<double> weights = probabilities();
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(), weights.end());
+
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        result[QuantumVisualization::basisString(dist(gen), qubit_count)]++;
+    }
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return result;
+}
+
+int QuantumCircuitSoA::measure_single_qubit(int qubit){
+    if(qubit<0 || qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+    size_t bit = 1ULL<<qubit;
+
+    //the blocks with the qubit set
+    double prob_of_one = 0.0;
+    for(size_t i=bit; i<re.size(); i+=2*bit){
+        const double *xr = re.data()+i, *xi = im.data()+i;
+        #pragma omp simd reduction(+:prob_of_one)
+        for(size_t m=0; m<bit; m++) prob_of_one += xr[m]*xr[m] + xi[m]*xi[m];
+    }
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    bernoulli_distribution dist(prob_of_one);
+    int measurement = dist(gen);
+
+    double norm_factor = measurement == 1 ? sqrt(prob_of_one) : sqrt(1.0-prob_of_one);
+    project(bit, measurement ? bit : 0, norm_factor);
+    addCircuit(qubit,"M");
+    return measurement;
+}
+
+string QuantumCircuitSoA::measure_range_of_qubits(const vector<int> &qubits){
+    size_t mask = 0;
+    for(auto& q:qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask |= 1ULL<<q;
+    }
+    vector<double> weights = maskedMarginal(mask);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+    size_t outcome = dist(gen);
+    size_t measurement = QuantumBits::depositBits(outcome, mask);
+    project(mask, measurement, sqrt(weights[outcome]));
+
+    for(auto &q: qubits) circuit[q] += "[M]";
+    string output;
+    for(int q:qubits){
+        output += (((measurement>>q) & 1) ? '1' : '0'); //Measurement returned in the same order as the qubits input vector
+    }
+    cout << "Measurement in order given: " << output;
+    return output;
+}
+
+map<string,int> QuantumCircuitSoA::run_range_of_qubits(int num_shots, const vector<int> &qubits){
+    size_t mask = 0;
+    for(auto& q:qubits){
+        if(q<0 || q>=qubit_count) throw out_of_range("Qubits out of range.");
+        mask |= 1ULL<<q;
+    }
+    vector<double> weights = maskedMarginal(mask);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        size_t measurement = QuantumBits::depositBits(dist(gen), mask);
+        string output;
+        for(int q:qubits){
+            output += (((measurement>>q) & 1) ? '1' : '0');
+        }
+        result[output]++;
+    }
+    for(auto &q: qubits) circuit[q] += "[M]";
+    return result;
+}
+
+void QuantumCircuitSoA::resetAll(int index){
+    if(index < 0 || (size_t)index >= re.size()) throw out_of_range("Basis state index out of range.");
+    fill(re.begin(), re.end(), 0.0);
+    fill(im.begin(), im.end(), 0.0);
+    re[index] = 1.0;
+}
+
+//Conversions at the API boundary
+
+vector<complex<double>> QuantumCircuitSoA::exportState(){
+    vector<complex<double>> state(re.size());
+    for(size_t i=0; i<re.size(); i++) state[i] = {re[i], im[i]};
+    return state;
+}
+
+void QuantumCircuitSoA::importState(const vector<complex<double>> &amplitudes){
+    checkStateSize(amplitudes.size());
+    for(size_t i=0; i<re.size(); i++){
+        re[i] = amplitudes[i].real();
+        im[i] = amplitudes[i].imag();
+    }
+}
+
+void QuantumCircuitSoA::saveState(const string &path, QuantumSnapshot::Precision precision){
+    QuantumSnapshot::write(path, exportState(), qubit_count, precision);
+}
+
+void QuantumCircuitSoA::loadState(const string &path){
+    QuantumSnapshot::MappedSnapshot snapshot(path);
+    if(snapshot.qubitCount() != qubit_count) throw invalid_argument("Snapshot has " + to_string(snapshot.qubitCount()) + " qubits, circuit has " + to_string(qubit_count) + ".");
+    vector<complex<double>> state;
+    snapshot.copyTo(state);
+    importState(state);
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[L]";
+    }
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitSoA::clone(){
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitSoA(*this));
+}
+
+double QuantumCircuitSoA::stateNorm(){
+    double sum = 0.0;
+    #pragma omp simd reduction(+:sum)
+    for(size_t i=0; i<re.size(); i++) sum += re[i]*re[i] + im[i]*im[i];
+    return sqrt(sum);
+}
+
+complex<double> QuantumCircuitSoA::amplitude(size_t index){
+    if(index >= re.size()) throw out_of_range("Basis state index out of range.");
+    return {re[index], im[index]};
+}
+
+void QuantumCircuitSoA::printState(){
+    QuantumVisualization::printState(exportState(), qubit_count);
+}
+
+void QuantumCircuitSoA::printProbabilities(){
+    QuantumVisualization::printProbabilities(exportState(), qubit_count);
+}
+
+void QuantumCircuitSoA::displayGraph(){
+    QuantumVisualization::displayGraph(exportState(), qubit_count);
+}
+
+void QuantumCircuitSoA::displayHeatMap(){
+    QuantumVisualization::displayHeatMap(exportState(), qubit_count);
+}
@@ -0,0 +1,568 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+#include <MaQrel/QuantumCircuitSparse.h>
+#include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumFourier.h>
+#include <MaQrel/QuantumVisualization.h>
+using namespace std;
+
+//Hash table
+
+void QuantumCircuitSparse::AmplitudeTable::clear(){
+    fill(keys.begin(), keys.end(), EMPTY);
+    count = 0;
+}
+
+void QuantumCircuitSparse::AmplitudeTable::reserve(size_t entries){
+    size_t capacity = 16;
+    while(capacity < 2*entries) capacity *= 2;
+    if(capacity > keys.size()) rehash(capacity);
+}
+
+void QuantumCircuitSparse::AmplitudeTable::rehash(size_t capacity){
+    vector<size_t> old_keys(capacity, EMPTY);
+    vector<complex<double>> old_values(capacity);
+    old_keys.swap(keys);
+    old_values.swap(values);
+    shift = 64 - QuantumBits::popcount(capacity-1);
+    count = 0;
+    for(size_t slot=0; slot<old_keys.size(); slot++){
+        if(old_keys[slot] != EMPTY) at(old_keys[slot]) = old_values[slot];
+    }
+}
+
+complex<double>& QuantumCircuitSparse::AmplitudeTable::at(size_t key){
+    if(2*(count+1) > keys.size()) rehash(max<size_t>(16, 2*keys.size()));
+    size_t mask = keys.size()-1;
+    size_t slot = slotOf(key);
+    while(keys[slot] != EMPTY && keys[slot] != key) slot = (slot+1) & mask;
+    if(keys[slot] == EMPTY){
+        keys[slot] = key;
+        values[slot] = 0.0;
+        count++;
+    }
+    return values[slot];
+}
+
+const complex<double>* QuantumCircuitSparse::AmplitudeTable::find(size_t key) const {
+    if(keys.empty()) return nullptr;
+    size_t mask = keys.size()-1;
+    size_t slot = slotOf(key);
+    while(keys[slot] != EMPTY){
+        if(keys[slot] == key) return &values[slot];
+        slot = (slot+1) & mask;
+    }
+    return nullptr;
+}
+
+//Circuit
+
+QuantumCircuitSparse::QuantumCircuitSparse(int n, double crossover, double threshold) :
+    QuantumCircuitBase(n, false),
+    crossover(crossover),
+    threshold(threshold)
+{
+    if(n >= 64) throw invalid_argument("Number of qubits must be below 64.");
+    if(crossover <= 0 || crossover > 1) throw invalid_argument("Crossover must be in (0, 1].");
+    if(threshold < 0) throw invalid_argument("Threshold cannot be negative.");
+    table.at(0) = 1.0;
+}
+
+size_t QuantumCircuitSparse::getNonzeroCount() const {
+    if(!dense) return table.size();
+    size_t count = 0;
+    for(auto &a: state_vector) count += (a != 0.0);
+    return count;
+}
+
+void QuantumCircuitSparse::checkQubit(int qubit) const {
+    if(qubit<0 || qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+}
+
+void QuantumCircuitSparse::prune(){
+    double limit = threshold*threshold;
+    table.clear();
+    table.reserve(scratch.size());
+    scratch.forEach([&](size_t index, const complex<double> &a){
+        if(norm(a) >= limit) table.at(index) = a;
+    });
+}
+
+void QuantumCircuitSparse::toDense(){
+    state_vector.assign(1ULL<<qubit_count, 0.0);
+    table.forEach([&](size_t index, const complex<double> &a){ state_vector[index] = a; });
+    table = AmplitudeTable();
+    scratch = AmplitudeTable();
+    dense = true;
+}
+
+void QuantumCircuitSparse::toSparse(){
+    double limit = threshold*threshold;
+    table.clear();
+    for(size_t i=0; i<state_vector.size(); i++){
+        if(norm(state_vector[i]) >= limit) table.at(i) = state_vector[i];
+    }
+    vector<complex<double>>().swap(state_vector);
+    dense = false;
+}
+
+void QuantumCircuitSparse::checkDensity(){
+    if(!dense && qubit_count <= MAX_DENSE_QUBITS && table.size() > crossover * (1ULL<<qubit_count)) toDense();
+}
+
+void QuantumCircuitSparse::checkSparsity(){
+    //a quarter of the crossover so the state does not flip back and forth
+    if(dense && getNonzeroCount() < crossover/4 * state_vector.size()) toSparse();
+}
+
+vector<complex<double>> QuantumCircuitSparse::denseCopy() const {
+    if(dense) return state_vector;
+    if(qubit_count > MAX_DENSE_QUBITS) throw logic_error("The state of " + to_string(qubit_count) + " qubits is too large to expand into a state vector.");
+    vector<complex<double>> copy(1ULL<<qubit_count, 0.0);
+    table.forEach([&](size_t index, const complex<double> &a){ copy[index] = a; });
+    return copy;
+}
+
+vector<pair<size_t,double>> QuantumCircuitSparse::probabilities() const {
+    vector<pair<size_t,double>> probs;
+    probs.reserve(table.size());
+    table.forEach([&](size_t index, const complex<double> &a){ probs.push_back({index, norm(a)}); });
+    sort(probs.begin(), probs.end());
+    return probs;
+}
+
+//Gate application, every nonzero amplitude is spread over the basis states the gate maps it to
+
+void QuantumCircuitSparse::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
+    if(dense){
+        QuantumCircuitBase::applySingleQubitOp(target_qubit, op);
+        return;
+    }
+    checkQubit(target_qubit);
+    auto u = QuantumGates::singleQubitMatrix(op);
+    size_t bit = 1ULL<<target_qubit;
+
+    scratch.clear();
+    scratch.reserve(2*table.size());
+    table.forEach([&](size_t index, const complex<double> &a){
+        int b = (index & bit) ? 1 : 0;
+        size_t index_0 = index & ~bit;
+        if(u[b] != 0.0) scratch.at(index_0) += u[b]*a;
+        if(u[2+b] != 0.0) scratch.at(index_0|bit) += u[2+b]*a;
+    });
+    prune();
+    checkDensity();
+}
+
+void QuantumCircuitSparse::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
+    if(dense){
+        QuantumCircuitBase::applyControlledQubitOp(control_qubit, target_qubit, op);
+        return;
+    }
+    if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0) throw out_of_range("Qubits out of range.");
+    if(control_qubit == target_qubit) throw invalid_argument("Control and target qubits cannot be the same.");
+    auto u = QuantumGates::singleQubitMatrix(op);
+    size_t control_mask = 1ULL<<control_qubit, bit = 1ULL<<target_qubit;
+
+    scratch.clear();
+    scratch.reserve(2*table.size());
+    table.forEach([&](size_t index, const complex<double> &a){
+        if(!(index & control_mask)){
+            scratch.at(index) += a;
+            return;
+        }
+        int b = (index & bit) ? 1 : 0;
+        size_t index_0 = index & ~bit;
+        if(u[b] != 0.0) scratch.at(index_0) += u[b]*a;
+        if(u[2+b] != 0.0) scratch.at(index_0|bit) += u[2+b]*a;
+    });
+    prune();
+    checkDensity();
+}
+
+void QuantumCircuitSparse::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
+    if(dense){
+        QuantumCircuitBase::applyTwoQubitOp(qubit_1, qubit_2, op);
+        return;
+    }
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    auto u = QuantumGates::twoQubitMatrix(op);
+    size_t bit_1 = 1ULL<<qubit_1, bit_2 = 1ULL<<qubit_2;
+
+    scratch.clear();
+    scratch.reserve(4*table.size());
+    table.forEach([&](size_t index, const complex<double> &a){
+        int column = ((index & bit_1) ? 2 : 0) | ((index & bit_2) ? 1 : 0);
+        size_t index_00 = index & ~(bit_1|bit_2);
+        for(int row=0; row<4; row++){
+            complex<double> coefficient = u[row*4+column];
+            if(coefficient == 0.0) continue;
+            scratch.at(index_00 | ((row&2) ? bit_1 : 0) | ((row&1) ? bit_2 : 0)) += coefficient*a;
+        }
+    });
+    prune();
+    checkDensity();
+}
+
+void QuantumCircuitSparse::applyPauliRotation(size_t x_mask, size_t z_mask, double theta){
+    if(dense){
+        QuantumCircuitBase::applyPauliRotation(x_mask, z_mask, theta);
+        return;
+    }
+    auto op = QuantumGates::PauliRotation_Function(x_mask, z_mask, theta);
+
+    scratch.clear();
+    scratch.reserve(2*table.size());
+    table.forEach([&](size_t index, const complex<double> &a){
+        //the kernel on the pair with the partner still zero
+        complex<double> stay = a, moved = 0.0;
+        op(index, stay, moved);
+        if(stay != 0.0) scratch.at(index) += stay;
+        if(moved != 0.0) scratch.at(index ^ x_mask) += moved;
+    });
+    prune();
+    checkDensity();
+}
+
+//QFT, the amplitudes are grouped by the value of the other qubits and each group is
+//transformed as a dense register
+
+void QuantumCircuitSparse::QFT(const vector<int> &qubits, bool inverse){
+    if(dense){
+        QuantumCircuitBase::QFT(qubits, inverse);
+        return;
+    }
+    checkRegister(qubits);
+    QuantumFourier::Plan plan = QuantumFourier::makePlan(qubits, inverse);
+    size_t size = 1ULL<<plan.bits;
+
+    //(other qubits, bit reversed register value)
+    vector<pair<size_t,size_t>> keys;
+    keys.reserve(table.size());
+    table.forEach([&](size_t index, const complex<double> &){
+        keys.push_back({index & ~plan.register_mask, QuantumFourier::reverseBits(QuantumFourier::registerValue(index, plan), plan.bits)});
+    });
+    sort(keys.begin(), keys.end());
+
+    scratch.clear();
+    vector<complex<double>> buffer(size);
+    for(size_t first=0; first<keys.size();){
+        size_t rest = keys[first].first, last = first;
+        fill(buffer.begin(), buffer.end(), 0.0);
+        for(; last<keys.size() && keys[last].first == rest; last++){
+            buffer[keys[last].second] = *table.find(rest | plan.reversed_offsets[keys[last].second]);
+        }
+        QuantumFourier::transform(buffer.data(), plan);
+        for(size_t y=0; y<size; y++){
+            if(buffer[y] != 0.0) scratch.at(rest | plan.offsets[y]) = buffer[y];
+        }
+        first = last;
+    }
+    prune();
+    checkDensity();
+    addCircuit(qubits, inverse ? "QFTdg" : "QFT");
+}
+
+//Measurements
+
+vector<double> QuantumCircuitSparse::maskedMarginal(size_t mask){
+    if(dense) return QuantumCircuitBase::maskedMarginal(mask);
+    vector<double> hist(1ULL<<QuantumBits::popcount(mask), 0.0);
+    table.forEach([&](size_t index, const complex<double> &a){ hist[QuantumBits::compactBits(index, mask)] += norm(a); });
+    return hist;
+}
+
+string QuantumCircuitSparse::collapse(){
+    if(dense){
+        string basis_state = QuantumCircuitBase::collapse();
+        checkSparsity();
+        return basis_state;
+    }
+    auto probs = probabilities();
+    vector<double> weights;
+    for(auto &p: probs) weights.push_back(p.second);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(), weights.end());
+    size_t index = probs[dist(gen)].first;
+
+    table.clear();
+    table.at(index) = 1.0;
+    string basis_state = QuantumVisualization::basisString(index, qubit_count);
+    cout << basis_state << "\n";
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return basis_state;
+}
+
+map<string,int> QuantumCircuitSparse::run(int num_shots){
+    if(dense) return QuantumCircuitBase::run(num_shots);
+    auto probs = probabilities();
+    vector<double> weights;
+    for(auto &p: probs) weights.push_back(p.second);
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(), weights.end());
+
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        result[QuantumVisualization::basisString(probs[dist(gen)].first, qubit_count)]++;
+    }
+
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return result;
+}
+
+int QuantumCircuitSparse::measure_single_qubit(int qubit){
+    if(dense){
+        int measurement = QuantumCircuitBase::measure_single_qubit(qubit);
+        checkSparsity();
+        return measurement;
+    }
+    checkQubit(qubit);
+    size_t bit = 1ULL<<qubit;
+    double prob_of_one = 0.0;
+    table.forEach([&](size_t index, const complex<double> &a){
+        if(index & bit) prob_of_one += norm(a);
+    });
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    bernoulli_distribution dist(prob_of_one);
+    int measurement = dist(gen);
+
+    double norm_factor = measurement == 1 ? sqrt(prob_of_one) : sqrt(1.0-prob_of_one);
+    scratch.clear();
+    scratch.reserve(table.size());
+    table.forEach([&](size_t index, const complex<double> &a){
+        if(((index & bit) != 0) == (measurement == 1)) scratch.at(index) = a / norm_factor;
+    });
+    prune();
+
+    addCircuit(qubit,"M");
+    return measurement;
+}
+
+string QuantumCircuitSparse::measure_range_of_qubits(const vector<int> &qubits){
+    if(dense){
+        string output = QuantumCircuitBase::measure_range_of_qubits(qubits);
+        checkSparsity();
+        return output;
+    }
+    size_t mask = 0;
+    for(auto& q:qubits){
+        checkQubit(q);
+        mask |= 1ULL<<q;
+    }
+    map<size_t,double> prob;
+    table.forEach([&](size_t index, const complex<double> &a){ prob[index&mask] += norm(a); });
+
+    vector<size_t> outcomes;
+    vector<double> weights;
+    for(auto &a: prob){
+        outcomes.push_back(a.first);
+        weights.push_back(a.second);
+    }
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+    size_t index = dist(gen);
+    double norm_factor = sqrt(weights[index]);
+    size_t measurement = outcomes[index];
+
+    scratch.clear();
+    scratch.reserve(table.size());
+    table.forEach([&](size_t i, const complex<double> &a){
+        if((i&mask) == measurement) scratch.at(i) = a / norm_factor;
+    });
+    prune();
+
+    for(auto &q: qubits) circuit[q] += "[M]";
+    string output;
+    for(int q:qubits){
+        output += (((measurement>>q) & 1) ? '1' : '0'); //Measurement returned in the same order as the qubits input vector
+    }
+    cout << "Measurement in order given: " << output;
+    return output;
+}
+
+map<string,int> QuantumCircuitSparse::run_range_of_qubits(int num_shots, const vector<int> &qubits){
+    if(dense) return QuantumCircuitBase::run_range_of_qubits(num_shots, qubits);
+    size_t mask = 0;
+    for(auto& q:qubits){
+        checkQubit(q);
+        mask |= 1ULL<<q;
+    }
+    map<size_t,double> prob;
+    table.forEach([&](size_t index, const complex<double> &a){ prob[index&mask] += norm(a); });
+
+    vector<size_t> outcomes;
+    vector<double> weights;
+    for(auto &a: prob){
+        outcomes.push_back(a.first);
+        weights.push_back(a.second);
+    }
+
+    static random_device rd;
+    static mt19937 gen(rd());
+    discrete_distribution<size_t> dist(weights.begin(),weights.end());
+
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        size_t measurement = outcomes[dist(gen)];
+        string output;
+        for(int q:qubits){
+            output += (((measurement>>q) & 1) ? '1' : '0'); //Measurement returned in the same order as the qubits input vector
+        }
+        result[output]++;
+    }
+    for(auto &q: qubits) circuit[q] += "[M]";
+    return result;
+}
+
+void QuantumCircuitSparse::resetAll(int index){
+    if(dense) vector<complex<double>>().swap(state_vector);
+    dense = false;
+    table.clear();
+    table.at(index) = 1.0;
+}
+
+//Expectation values
+
+vector<double> QuantumCircuitSparse::zParityExpectations(const vector<size_t> &z_masks){
+    if(dense) return QuantumCircuitBase::zParityExpectations(z_masks);
+    vector<double> values(z_masks.size(), 0.0);
+    table.forEach([&](size_t index, const complex<double> &a){
+        double p = norm(a);
+        for(size_t t=0; t<z_masks.size(); t++){
+            values[t] += QuantumBits::parity(index & z_masks[t]) ? -p : p;
+        }
+    });
+    return values;
+}
+
+double QuantumCircuitSparse::expectation(const Observable &observable){
+    if(dense) return QuantumCircuitBase::expectation(observable);
+
+    //P|i> = i^{#Y} (-1)^{|i & z|} |i ^ x>, so each term is one lookup per nonzero
+    //instead of rotating the state, which would fill it in
+    static const complex<double> powers[4] = {1.0, QuantumGates::I, -1.0, -QuantumGates::I};
+    double expect = observable.getIdentityCoefficient();
+    for(auto &term: observable.getTerms()){
+        if(((term.x_mask|term.z_mask) >> qubit_count) != 0) throw out_of_range("Observable acts on qubits out of range.");
+        complex<double> phase = powers[QuantumBits::popcount(term.x_mask & term.z_mask) % 4];
+        complex<double> sum = 0.0;
+        table.forEach([&](size_t index, const complex<double> &a){
+            const complex<double> *partner = table.find(index ^ term.x_mask);
+            if(!partner) return;
+            complex<double> value = conj(*partner) * a;
+            sum += QuantumBits::parity(index & term.z_mask) ? -value : value;
+        });
+        expect += term.coefficient * (phase * sum).real();
+    }
+    return expect;
+}
+
+//Snapshots and output
+
+void QuantumCircuitSparse::saveState(const string &path, QuantumSnapshot::Precision precision){
+    QuantumSnapshot::write(path, denseCopy(), qubit_count, precision);
+}
+
+void QuantumCircuitSparse::loadState(const string &path){
+    if(qubit_count > MAX_DENSE_QUBITS) throw logic_error("The state of " + to_string(qubit_count) + " qubits is too large to expand into a state vector.");
+    QuantumSnapshot::MappedSnapshot snapshot(path);
+    if(snapshot.qubitCount() != qubit_count) throw invalid_argument("Snapshot has " + to_string(snapshot.qubitCount()) + " qubits, circuit has " + to_string(qubit_count) + ".");
+    snapshot.copyTo(state_vector);
+    dense = true;
+    checkSparsity();
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[L]";
+    }
+}
+
+vector<complex<double>> QuantumCircuitSparse::exportState(){
+    return denseCopy();
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitSparse::clone(){
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitSparse(*this));
+}
+
+complex<double> QuantumCircuitSparse::innerProduct(QuantumCircuitBase &other){
+    if(dense) return QuantumCircuitBase::innerProduct(other);
+    checkSameQubits(other);
+    complex<double> sum = 0.0;
+    table.forEach([&](size_t index, const complex<double> &a){ sum += conj(a) * other.amplitude(index); });
+    return sum;
+}
+
+double QuantumCircuitSparse::stateNorm(){
+    if(dense) return QuantumCircuitBase::stateNorm();
+    double sum = 0.0;
+    table.forEach([&](size_t, const complex<double> &a){ sum += norm(a); });
+    return sqrt(sum);
+}
+
+complex<double> QuantumCircuitSparse::amplitude(size_t index){
+    if(dense) return QuantumCircuitBase::amplitude(index);
+    if(index >> qubit_count) throw out_of_range("Basis state index out of range.");
+    const complex<double> *a = table.find(index);
+    return a ? *a : 0.0;
+}
+
+void QuantumCircuitSparse::importState(const vector<complex<double>> &amplitudes){
+    if(qubit_count > MAX_DENSE_QUBITS) throw logic_error("The state of " + to_string(qubit_count) + " qubits is too large to expand into a state vector.");
+    checkStateSize(amplitudes.size());
+    state_vector = amplitudes;
+    dense = true;
+    checkSparsity();
+}
+
+void QuantumCircuitSparse::printState(){
+    if(dense){
+        QuantumCircuitBase::printState();
+        return;
+    }
+    vector<pair<size_t,complex<double>>> entries;
+    table.forEach([&](size_t index, const complex<double> &a){ entries.push_back({index, a}); });
+    sort(entries.begin(), entries.end(), [](auto &x, auto &y){ return x.first < y.first; });
+
+    cout << "Current State Vector (nonzero amplitudes)" << "\n";
+    for(auto &e: entries){
+        cout << "|" << QuantumVisualization::basisString(e.first, qubit_count) << "> :" << e.second << "\n";
+    }
+}
+
+void QuantumCircuitSparse::printProbabilities(){
+    if(dense){
+        QuantumCircuitBase::printProbabilities();
+        return;
+    }
+    cout << fixed << setprecision(6);
+    cout << qubit_count << "-Qubit Measurement Results" << "\n";
+    for(auto &p: probabilities()){
+        if(p.second >= QuantumVisualization::PROB_THRESHOLD) cout << "Probability of |" << QuantumVisualization::basisString(p.first, qubit_count) << ">: " << p.second << "\n";
+    }
+    cout << "----------------------------\n";
+}
+
+void QuantumCircuitSparse::displayGraph(){
+    QuantumVisualization::displayGraph(denseCopy(), qubit_count);
+}
+
+void QuantumCircuitSparse::displayHeatMap(){
+    QuantumVisualization::displayHeatMap(denseCopy(), qubit_count);
+}
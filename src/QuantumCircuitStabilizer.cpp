@@ -0,0 +1,674 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <stdexcept>
+#include <MaQrel/QuantumCircuitStabilizer.h>
+#include <MaQrel/QuantumVisualization.h>
+#include <MaQrel/QuantumBits.h>
+#include <MaQrel/QuantumProfiler.h>
+using namespace std;
+
+QuantumCircuitStabilizer::QuantumCircuitStabilizer(int n) :
+    QuantumCircuitBase(n, false)
+{
+    //padding rows to 256 bits keeps every row aligned for vector loads
+    words = ((n + 63) / 64 + 3) / 4 * 4;
+    xs.assign((2*n+1)*words, 0);
+    zs.assign((2*n+1)*words, 0);
+    phases.assign(2*n+1, 0);
+    resetTableau();
+}
+
+void QuantumCircuitStabilizer::resetTableau(){
+    fill(xs.begin(), xs.end(), 0);
+    fill(zs.begin(), zs.end(), 0);
+    fill(phases.begin(), phases.end(), 0);
+    //|0...0>: destabilizers X_i, stabilizers Z_i
+    for(int q=0; q<qubit_count; q++){
+        xRow(q)[q>>6] |= 1ULL<<(q&63);
+        zRow(q+qubit_count)[q>>6] |= 1ULL<<(q&63);
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::checkQubit(int qubit) const {
+    if(qubit<0 || qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+}
+
+void QuantumCircuitStabilizer::checkPair(int qubit_1, int qubit_2) const {
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+}
+
+void QuantumCircuitStabilizer::notClifford(const string &gate) const {
+    throw invalid_argument(gate + " is not a Clifford gate, the stabilizer backend cannot simulate it.");
+}
+
+int QuantumCircuitStabilizer::quarterTurns(const string &gate, double theta) const {
+    double turns = theta / (M_PI/2.0);
+    double rounded = round(turns);
+    if(fabs(turns-rounded) > 1e-9) notClifford(gate + "(" + to_string(theta) + ")");
+    return (((long long)rounded % 4) + 4) % 4;
+}
+
+//Tableau updates, every row is conjugated by the gate
+
+void QuantumCircuitStabilizer::applyH(int q){
+    size_t w = q>>6;
+    uint64_t m = 1ULL<<(q&63);
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        uint64_t &x = xs[row*words+w], &z = zs[row*words+w];
+        bool xa = x & m, za = z & m;
+        phases[row] ^= xa & za;
+        if(xa != za){
+            x ^= m;
+            z ^= m;
+        }
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::applyS(int q){
+    size_t w = q>>6;
+    uint64_t m = 1ULL<<(q&63);
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        uint64_t &x = xs[row*words+w], &z = zs[row*words+w];
+        bool xa = x & m, za = z & m;
+        phases[row] ^= xa & za;
+        if(xa) z ^= m;
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::applySdg(int q){
+    size_t w = q>>6;
+    uint64_t m = 1ULL<<(q&63);
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        uint64_t &x = xs[row*words+w], &z = zs[row*words+w];
+        bool xa = x & m, za = z & m;
+        phases[row] ^= xa & !za;
+        if(xa) z ^= m;
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::applyPauli(int q, bool x_part, bool z_part){
+    size_t w = q>>6;
+    uint64_t m = 1ULL<<(q&63);
+    //a Pauli only flips the sign of the rows it anticommutes with
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        bool xa = xs[row*words+w] & m, za = zs[row*words+w] & m;
+        phases[row] ^= (x_part & za) ^ (z_part & xa);
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::applyCX(int c, int t){
+    size_t wc = c>>6, wt = t>>6;
+    uint64_t mc = 1ULL<<(c&63), mt = 1ULL<<(t&63);
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        uint64_t *x = xs.data()+row*words, *z = zs.data()+row*words;
+        bool xc = x[wc] & mc, zc = z[wc] & mc, xt = x[wt] & mt, zt = z[wt] & mt;
+        phases[row] ^= xc & zt & (xt ^ zc ^ 1);
+        if(xc) x[wt] ^= mt;
+        if(zt) z[wc] ^= mc;
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::applyCZ(int c, int t){
+    size_t wc = c>>6, wt = t>>6;
+    uint64_t mc = 1ULL<<(c&63), mt = 1ULL<<(t&63);
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        uint64_t *x = xs.data()+row*words, *z = zs.data()+row*words;
+        bool xc = x[wc] & mc, zc = z[wc] & mc, xt = x[wt] & mt, zt = z[wt] & mt;
+        phases[row] ^= xc & xt & (zc ^ zt);
+        if(xt) z[wc] ^= mc;
+        if(xc) z[wt] ^= mt;
+    }
+    sample_space.valid = false;
+}
+
+void QuantumCircuitStabilizer::applySwap(int a, int b){
+    size_t wa = a>>6, wb = b>>6;
+    uint64_t ma = 1ULL<<(a&63), mb = 1ULL<<(b&63);
+    for(size_t row=0; row<2*(size_t)qubit_count; row++){
+        for(uint64_t *bits: {xs.data()+row*words, zs.data()+row*words}){
+            bool ba = bits[wa] & ma, bb = bits[wb] & mb;
+            if(ba != bb){
+                bits[wa] ^= ma;
+                bits[wb] ^= mb;
+            }
+        }
+    }
+    sample_space.valid = false;
+}
+
+//Row operations
+
+void QuantumCircuitStabilizer::rowCopy(size_t target, size_t source){
+    copy(xRow(source), xRow(source)+words, xRow(target));
+    copy(zRow(source), zRow(source)+words, zRow(target));
+    phases[target] = phases[source];
+    if(!deps.empty()) copy(deps.begin()+source*dep_words, deps.begin()+(source+1)*dep_words, deps.begin()+target*dep_words);
+}
+
+void QuantumCircuitStabilizer::rowClear(size_t row){
+    fill(xRow(row), xRow(row)+words, 0);
+    fill(zRow(row), zRow(row)+words, 0);
+    phases[row] = 0;
+    if(!deps.empty()) fill(deps.begin()+row*dep_words, deps.begin()+(row+1)*dep_words, 0);
+}
+
+void QuantumCircuitStabilizer::rowsum(size_t h, size_t i){
+    uint64_t *xh = xRow(h), *zh = zRow(h);
+    const uint64_t *xi = xRow(i), *zi = zRow(i);
+
+    //exponent of i picked up by each qubit of P_i * P_h, counted as +1 and -1 masks
+    long long sum = 2*phases[h] + 2*phases[i];
+    for(size_t w=0; w<words; w++){
+        uint64_t x1 = xi[w], z1 = zi[w], x2 = xh[w], z2 = zh[w];
+        uint64_t plus = (x1 & ~z1 & x2 & z2) | (x1 & z1 & ~x2 & z2) | (~x1 & z1 & x2 & ~z2);
+        uint64_t minus = (x1 & ~z1 & ~x2 & z2) | (x1 & z1 & x2 & ~z2) | (~x1 & z1 & x2 & z2);
+        sum += __builtin_popcountll(plus) - __builtin_popcountll(minus);
+        xh[w] = x1 ^ x2;
+        zh[w] = z1 ^ z2;
+    }
+    phases[h] = (((sum % 4) + 4) % 4) == 2;
+
+    if(!deps.empty()){
+        for(size_t w=0; w<dep_words; w++) deps[h*dep_words+w] ^= deps[i*dep_words+w];
+    }
+}
+
+bool QuantumCircuitStabilizer::anticommutes(size_t row, const vector<uint64_t> &x_bits, const vector<uint64_t> &z_bits) const {
+    int count = 0;
+    for(size_t w=0; w<x_bits.size() && w<words; w++){
+        count += __builtin_popcountll(xs[row*words+w] & z_bits[w]) + __builtin_popcountll(zs[row*words+w] & x_bits[w]);
+    }
+    return count & 1;
+}
+
+int QuantumCircuitStabilizer::measure(int qubit, int forced){
+    size_t n = qubit_count;
+    size_t scratch = 2*n;
+
+    size_t p = n;
+    while(p < 2*n && !xBit(p, qubit)) p++;
+
+    if(p < 2*n){
+        //random outcome: every other row that anticommutes with Z_qubit absorbs row p
+        for(size_t row=0; row<2*n; row++){
+            if(row != p && xBit(row, qubit)) rowsum(row, p);
+        }
+        rowCopy(p-n, p);
+        rowClear(p);
+        zRow(p)[qubit>>6] |= 1ULL<<(qubit&63);
+
+        int outcome = forced;
+        if(outcome < 0){
+            static random_device rd;
+            static mt19937 gen(rd());
+            bernoulli_distribution dist(0.5);
+            outcome = dist(gen);
+        }
+        phases[p] = outcome;
+        if(!deps.empty()){
+            //the outcome is a fresh random variable, numbered in the order they appear
+            deps[p*dep_words + dep_variables/64] |= 1ULL<<(dep_variables%64);
+            dep_variables++;
+            rowCopy(scratch, p);
+        }
+        sample_space.valid = false;
+        return outcome;
+    }
+
+    //deterministic: Z_qubit is already a product of stabilizers
+    rowClear(scratch);
+    for(size_t i=0; i<n; i++){
+        if(xBit(i, qubit)) rowsum(scratch, i+n);
+    }
+    return phases[scratch];
+}
+
+//Gates
+
+void QuantumCircuitStabilizer::H(int target_qubit){
+    MAQREL_PROFILE_GATE("H");
+    checkQubit(target_qubit);
+    applyH(target_qubit);
+    addCircuit(target_qubit, "H");
+}
+
+void QuantumCircuitStabilizer::X(int target_qubit){
+    MAQREL_PROFILE_GATE("X");
+    checkQubit(target_qubit);
+    applyPauli(target_qubit, true, false);
+    addCircuit(target_qubit, "X");
+}
+
+void QuantumCircuitStabilizer::Y(int target_qubit){
+    MAQREL_PROFILE_GATE("Y");
+    checkQubit(target_qubit);
+    applyPauli(target_qubit, true, true);
+    addCircuit(target_qubit, "Y");
+}
+
+void QuantumCircuitStabilizer::Z(int target_qubit){
+    MAQREL_PROFILE_GATE("Z");
+    checkQubit(target_qubit);
+    applyPauli(target_qubit, false, true);
+    addCircuit(target_qubit, "Z");
+}
+
+void QuantumCircuitStabilizer::S(int target_qubit){
+    MAQREL_PROFILE_GATE("S");
+    checkQubit(target_qubit);
+    applyS(target_qubit);
+    addCircuit(target_qubit, "S");
+}
+
+void QuantumCircuitStabilizer::Sdg(int target_qubit){
+    MAQREL_PROFILE_GATE("Sdg");
+    checkQubit(target_qubit);
+    applySdg(target_qubit);
+    addCircuit(target_qubit, "S");
+}
+
+void QuantumCircuitStabilizer::CX(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CX");
+    checkPair(control_qubit, target_qubit);
+    applyCX(control_qubit, target_qubit);
+    addCircuit(control_qubit, "C", target_qubit, "X");
+}
+
+void QuantumCircuitStabilizer::CY(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CY");
+    checkPair(control_qubit, target_qubit);
+    //Y = S X Sdg
+    applySdg(target_qubit);
+    applyCX(control_qubit, target_qubit);
+    applyS(target_qubit);
+    addCircuit(control_qubit, "C", target_qubit, "Y");
+}
+
+void QuantumCircuitStabilizer::CZ(int control_qubit, int target_qubit){
+    MAQREL_PROFILE_GATE("CZ");
+    checkPair(control_qubit, target_qubit);
+    applyCZ(control_qubit, target_qubit);
+    addCircuit(control_qubit, "C", target_qubit, "Z");
+}
+
+void QuantumCircuitStabilizer::SWAP(int qubit_1, int qubit_2){
+    MAQREL_PROFILE_GATE("SWAP");
+    checkPair(qubit_1, qubit_2);
+    applySwap(qubit_1, qubit_2);
+}
+
+void QuantumCircuitStabilizer::iSWAP(int qubit_1, int qubit_2){
+    MAQREL_PROFILE_GATE("iSWAP");
+    checkPair(qubit_1, qubit_2);
+    //iSWAP = (S x S) SWAP CZ
+    applyCZ(qubit_1, qubit_2);
+    applySwap(qubit_1, qubit_2);
+    applyS(qubit_1);
+    applyS(qubit_2);
+}
+
+void QuantumCircuitStabilizer::P(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("P");
+    checkQubit(target_qubit);
+    switch(quarterTurns("P", theta)){
+        case 1: applyS(target_qubit); break;
+        case 2: applyPauli(target_qubit, false, true); break;
+        case 3: applySdg(target_qubit); break;
+    }
+    addCircuit(target_qubit, "P");
+}
+
+void QuantumCircuitStabilizer::Rz(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("Rz");
+    checkQubit(target_qubit);
+    //equal to P(theta) up to a global phase
+    switch(quarterTurns("Rz", theta)){
+        case 1: applyS(target_qubit); break;
+        case 2: applyPauli(target_qubit, false, true); break;
+        case 3: applySdg(target_qubit); break;
+    }
+    addCircuit(target_qubit,"Rz("+to_string(theta)+")");
+}
+
+void QuantumCircuitStabilizer::Rx(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("Rx");
+    checkQubit(target_qubit);
+    int turns = quarterTurns("Rx", theta);
+    //Rx = H Rz H
+    applyH(target_qubit);
+    switch(turns){
+        case 1: applyS(target_qubit); break;
+        case 2: applyPauli(target_qubit, false, true); break;
+        case 3: applySdg(target_qubit); break;
+    }
+    applyH(target_qubit);
+    addCircuit(target_qubit,"Rx("+to_string(theta)+")");
+}
+
+void QuantumCircuitStabilizer::Ry(int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("Ry");
+    checkQubit(target_qubit);
+    int turns = quarterTurns("Ry", theta);
+    //Ry = S Rx Sdg
+    applySdg(target_qubit);
+    applyH(target_qubit);
+    switch(turns){
+        case 1: applyS(target_qubit); break;
+        case 2: applyPauli(target_qubit, false, true); break;
+        case 3: applySdg(target_qubit); break;
+    }
+    applyH(target_qubit);
+    applyS(target_qubit);
+    addCircuit(target_qubit,"Ry("+to_string(theta)+")");
+}
+
+void QuantumCircuitStabilizer::CP(int control_qubit, int target_qubit, const double theta){
+    MAQREL_PROFILE_GATE("CP");
+    checkPair(control_qubit, target_qubit);
+    int turns = quarterTurns("CP", theta);
+    if(turns % 2) notClifford("CP(" + to_string(theta) + ")");
+    if(turns == 2) applyCZ(control_qubit, target_qubit);
+    addCircuit(control_qubit, "C", target_qubit, "P("+to_string(theta)+")");
+}
+
+void QuantumCircuitStabilizer::T(int) { notClifford("T"); }
+void QuantumCircuitStabilizer::Tdg(int) { notClifford("Tdg"); }
+void QuantumCircuitStabilizer::U(int, const array<complex<double>,4> &) { notClifford("U"); }
+void QuantumCircuitStabilizer::CH(int, int) { notClifford("CH"); }
+void QuantumCircuitStabilizer::CS(int, int) { notClifford("CS"); }
+void QuantumCircuitStabilizer::CSdg(int, int) { notClifford("CSdg"); }
+void QuantumCircuitStabilizer::CT(int, int) { notClifford("CT"); }
+void QuantumCircuitStabilizer::CTdg(int, int) { notClifford("CTdg"); }
+void QuantumCircuitStabilizer::CRx(int, int, const double) { notClifford("CRx"); }
+void QuantumCircuitStabilizer::CRy(int, int, const double) { notClifford("CRy"); }
+void QuantumCircuitStabilizer::CRz(int, int, const double) { notClifford("CRz"); }
+
+void QuantumCircuitStabilizer::QFT(const vector<int> &qubits, bool){
+    checkRegister(qubits);
+    if(qubits.size() > 1) notClifford("QFT");
+    H(qubits[0]);
+}
+
+void QuantumCircuitStabilizer::applyPauliRotation(size_t x_mask, size_t z_mask, double theta){
+    //checked before the ladder starts changing the tableau
+    quarterTurns("PauliRotation", theta);
+    //the identity is a global phase, which the tableau does not track
+    if((x_mask|z_mask) == 0) return;
+    applyPauliRotationGates(x_mask, z_mask, theta);
+}
+
+//Measurements
+
+int QuantumCircuitStabilizer::measure_single_qubit(int qubit){
+    checkQubit(qubit);
+    int measurement = measure(qubit);
+    addCircuit(qubit,"M");
+    return measurement;
+}
+
+string QuantumCircuitStabilizer::collapse(){
+    vector<uint64_t> outcome(words, 0);
+    for(int q=0; q<qubit_count; q++){
+        if(measure(q)) outcome[q>>6] |= 1ULL<<(q&63);
+    }
+    string basis_state = outcomeString(outcome);
+    cout << basis_state << "\n";
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return basis_state;
+}
+
+string QuantumCircuitStabilizer::measure_range_of_qubits(const vector<int> &qubits){
+    for(int q: qubits) checkQubit(q);
+    string output;
+    for(int q: qubits){
+        output += measure(q) ? '1' : '0'; //Measurement returned in the same order as the qubits input vector
+        circuit[q] += "[M]";
+    }
+    cout << "Measurement in order given: " << output;
+    return output;
+}
+
+void QuantumCircuitStabilizer::buildSampleSpace(){
+    size_t n = qubit_count;
+    vector<uint64_t> saved_x = xs, saved_z = zs;
+    vector<uint8_t> saved_phases = phases;
+
+    //measure everything on the tableau with every random outcome set to 0 while tracking
+    //how each later outcome depends on the earlier random ones
+    dep_words = (n + 63) / 64;
+    deps.assign((2*n+1)*dep_words, 0);
+    dep_variables = 0;
+
+    sample_space.base.assign(words, 0);
+    vector<vector<uint64_t>> outcome_deps(n);
+    for(size_t q=0; q<n; q++){
+        if(measure(q, 0)) sample_space.base[q>>6] |= 1ULL<<(q&63);
+        outcome_deps[q].assign(deps.begin()+2*n*dep_words, deps.begin()+(2*n+1)*dep_words);
+    }
+
+    //generator j holds the outcomes that flip when random outcome j flips
+    sample_space.generators.assign(dep_variables, vector<uint64_t>(words, 0));
+    for(size_t q=0; q<n; q++){
+        for(size_t j=0; j<dep_variables; j++){
+            if((outcome_deps[q][j/64] >> (j%64)) & 1) sample_space.generators[j][q>>6] |= 1ULL<<(q&63);
+        }
+    }
+
+    deps.clear();
+    xs.swap(saved_x);
+    zs.swap(saved_z);
+    phases.swap(saved_phases);
+    sample_space.valid = true;
+}
+
+vector<uint64_t> QuantumCircuitStabilizer::sampleOutcome(mt19937_64 &gen){
+    vector<uint64_t> outcome = sample_space.base;
+    uint64_t bits = 0;
+    for(size_t j=0; j<sample_space.generators.size(); j++){
+        if(j % 64 == 0) bits = gen();
+        if((bits >> (j%64)) & 1){
+            const vector<uint64_t> &g = sample_space.generators[j];
+            for(size_t w=0; w<words; w++) outcome[w] ^= g[w];
+        }
+    }
+    return outcome;
+}
+
+vector<double> QuantumCircuitStabilizer::maskedMarginal(size_t mask){
+    if(!sample_space.valid) buildSampleSpace();
+    //the generators projected onto the mask, reduced to one per leading bit
+    size_t pivots[64] = {};
+    vector<size_t> basis;
+    for(auto &g: sample_space.generators){
+        size_t v = QuantumBits::compactBits(g[0], mask);
+        for(int bit=63; bit>=0 && v; bit--){
+            if(!((v>>bit) & 1)) continue;
+            if(!pivots[bit]){
+                pivots[bit] = v;
+                basis.push_back(v);
+                v = 0;
+            }else v ^= pivots[bit];
+        }
+    }
+
+    vector<double> hist(1ULL<<QuantumBits::popcount(mask), 0.0);
+    vector<size_t> points = {QuantumBits::compactBits(sample_space.base[0], mask)};
+    for(size_t b: basis){
+        size_t count = points.size();
+        for(size_t i=0; i<count; i++) points.push_back(points[i] ^ b);
+    }
+    for(size_t p: points) hist[p] = 1.0 / points.size();
+    return hist;
+}
+
+string QuantumCircuitStabilizer::outcomeString(const vector<uint64_t> &outcome) const {
+    string basis(qubit_count, '0');
+    for(int q=0; q<qubit_count; q++){
+        if((outcome[q>>6] >> (q&63)) & 1) basis[qubit_count-1-q] = '1';
+    }
+    return basis;
+}
+
+map<string,int> QuantumCircuitStabilizer::run(int num_shots){
+    if(!sample_space.valid) buildSampleSpace();
+
+    static random_device rd;
+    static mt19937_64 gen(rd());
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        result[outcomeString(sampleOutcome(gen))]++;
+    }
+
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[M]";
+    }
+    return result;
+}
+
+map<string,int> QuantumCircuitStabilizer::run_range_of_qubits(int num_shots, const vector<int> &qubits){
+    for(int q: qubits) checkQubit(q);
+    if(!sample_space.valid) buildSampleSpace();
+
+    static random_device rd;
+    static mt19937_64 gen(rd());
+    map<string,int> result;
+    for(int i=0;i<num_shots;i++){
+        vector<uint64_t> outcome = sampleOutcome(gen);
+        string output;
+        for(int q:qubits){
+            output += ((outcome[q>>6] >> (q&63)) & 1) ? '1' : '0';
+        }
+        result[output]++;
+    }
+    for(auto &q: qubits) circuit[q] += "[M]";
+    return result;
+}
+
+void QuantumCircuitStabilizer::resetAll(int index){
+    resetTableau();
+    for(int q=0; q<qubit_count && q<31; q++){
+        if((index>>q) & 1) applyPauli(q, true, false);
+    }
+}
+
+//Expectation values
+
+int QuantumCircuitStabilizer::pauliExpectation(const vector<uint64_t> &x_bits, const vector<uint64_t> &z_bits){
+    size_t n = qubit_count;
+    for(size_t row=n; row<2*n; row++){
+        if(anticommutes(row, x_bits, z_bits)) return 0;
+    }
+    //P commutes with the whole group, so it is +-1 times the product of the stabilizers
+    //whose destabilizers it anticommutes with
+    size_t scratch = 2*n;
+    rowClear(scratch);
+    for(size_t i=0; i<n; i++){
+        if(anticommutes(i, x_bits, z_bits)) rowsum(scratch, i+n);
+    }
+    return phases[scratch] ? -1 : 1;
+}
+
+double QuantumCircuitStabilizer::expectZ(const vector<int> &q){
+    vector<uint64_t> x_bits(words, 0), z_bits(words, 0);
+    for(int j: q){
+        checkQubit(j);
+        z_bits[j>>6] ^= 1ULL<<(j&63);
+    }
+    return pauliExpectation(x_bits, z_bits);
+}
+
+vector<double> QuantumCircuitStabilizer::zParityExpectations(const vector<size_t> &z_masks){
+    vector<double> values;
+    vector<uint64_t> x_bits(words, 0), z_bits(words, 0);
+    for(size_t mask: z_masks){
+        z_bits[0] = mask;
+        values.push_back(pauliExpectation(x_bits, z_bits));
+    }
+    return values;
+}
+
+double QuantumCircuitStabilizer::expectation(const Observable &observable){
+    double expect = observable.getIdentityCoefficient();
+    vector<uint64_t> x_bits(words, 0), z_bits(words, 0);
+    for(auto &term: observable.getTerms()){
+        if(qubit_count < 64 && ((term.x_mask|term.z_mask) >> qubit_count) != 0) throw out_of_range("Observable acts on qubits out of range.");
+        x_bits[0] = term.x_mask;
+        z_bits[0] = term.z_mask;
+        expect += term.coefficient * pauliExpectation(x_bits, z_bits);
+    }
+    return expect;
+}
+
+//Output
+
+void QuantumCircuitStabilizer::printState(){
+    cout << "Current Stabilizers" << "\n";
+    for(int row=qubit_count; row<2*qubit_count; row++){
+        string pauli(qubit_count, 'I');
+        for(int q=0; q<qubit_count; q++){
+            bool x = xBit(row, q), z = zBit(row, q);
+            if(x || z) pauli[qubit_count-1-q] = x ? (z ? 'Y' : 'X') : 'Z';
+        }
+        cout << (phases[row] ? '-' : '+') << pauli << "\n";
+    }
+}
+
+void QuantumCircuitStabilizer::printProbabilities(){
+    if(!sample_space.valid) buildSampleSpace();
+    size_t rank = sample_space.generators.size();
+
+    cout << fixed << setprecision(6);
+    cout << qubit_count << "-Qubit Measurement Results" << "\n";
+    //every reachable outcome is equally likely
+    double prob = ldexp(1.0, -(int)min<size_t>(rank, 1000));
+    if(prob >= QuantumVisualization::PROB_THRESHOLD){
+        for(size_t choice=0; choice < (1ULL<<rank); choice++){
+            vector<uint64_t> outcome = sample_space.base;
+            for(size_t j=0; j<rank; j++){
+                if((choice>>j) & 1){
+                    for(size_t w=0; w<words; w++) outcome[w] ^= sample_space.generators[j][w];
+                }
+            }
+            cout << "Probability of |" << outcomeString(outcome) << ">: " << prob << "\n";
+        }
+    }
+    cout << "----------------------------\n";
+}
+
+void QuantumCircuitStabilizer::saveState(const string &, QuantumSnapshot::Precision){
+    throw logic_error("The stabilizer backend has no amplitudes to save.");
+}
+
+void QuantumCircuitStabilizer::loadState(const string &){
+    throw logic_error("The stabilizer backend cannot load amplitudes.");
+}
+
+vector<complex<double>> QuantumCircuitStabilizer::exportState(){
+    throw logic_error("The stabilizer backend has no amplitudes to export.");
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitStabilizer::clone(){
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitStabilizer(*this));
+}
+
+void QuantumCircuitStabilizer::importState(const vector<complex<double>> &){
+    throw logic_error("The stabilizer backend cannot import amplitudes.");
+}
+
+void QuantumCircuitStabilizer::displayGraph(){
+    throw logic_error("displayGraph is not supported by the stabilizer backend, use printProbabilities.");
+}
+
+void QuantumCircuitStabilizer::displayHeatMap(){
+    throw logic_error("displayHeatMap is not supported by the stabilizer backend, use printProbabilities.");
+}
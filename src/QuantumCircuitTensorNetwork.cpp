@@ -0,0 +1,506 @@
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <MaQrel/QuantumCircuitTensorNetwork.h>
+#include <MaQrel/QuantumGates.h>
+#include <MaQrel/QuantumVisualization.h>
+using namespace std;
+
+namespace {
+
+    //value with bit k moved to bit positions[k]
+    size_t deposit(size_t value, const vector<int> &positions){
+        size_t result = 0;
+        for(size_t k=0; k<positions.size(); k++){
+            if((value >> k) & 1) result |= 1ULL << positions[k];
+        }
+        return result;
+    }
+
+    vector<size_t> offsets(const vector<int> &positions){
+        vector<size_t> result(1ULL << positions.size());
+        for(size_t v=0; v<result.size(); v++) result[v] = deposit(v, positions);
+        return result;
+    }
+
+    //legs of the contraction of a and b: the legs of a not in b, then those of b not in a
+    vector<int> resultLegs(const vector<int> &a, const vector<int> &b){
+        vector<int> legs;
+        for(int leg: a) if(find(b.begin(), b.end(), leg) == b.end()) legs.push_back(leg);
+        for(int leg: b) if(find(a.begin(), a.end(), leg) == a.end()) legs.push_back(leg);
+        return legs;
+    }
+
+    int sharedCount(const vector<int> &a, const vector<int> &b){
+        int count = 0;
+        for(int leg: a) count += find(b.begin(), b.end(), leg) != b.end();
+        return count;
+    }
+
+    //u applied to the leg at position, data indexed like the tensor
+    void applyToLeg(vector<complex<double>> &data, int position, const array<complex<double>,4> &u){
+        size_t bit = 1ULL << position;
+        for(size_t i=0; i<data.size(); i++){
+            if(i & bit) continue;
+            complex<double> a = data[i], b = data[i|bit];
+            data[i] = u[0]*a + u[1]*b;
+            data[i|bit] = u[2]*a + u[3]*b;
+        }
+    }
+
+    //u with index 2*bit(first)+bit(second) applied to the legs at the two positions
+    void applyToLegs(vector<complex<double>> &data, int first, int second, const array<complex<double>,16> &u){
+        size_t bit_1 = 1ULL << first, bit_2 = 1ULL << second;
+        for(size_t i=0; i<data.size(); i++){
+            if(i & (bit_1|bit_2)) continue;
+            size_t index[4] = {i, i|bit_2, i|bit_1, i|bit_1|bit_2};
+            complex<double> in[4] = {data[index[0]], data[index[1]], data[index[2]], data[index[3]]};
+            for(int r=0; r<4; r++){
+                data[index[r]] = u[r*4]*in[0] + u[r*4+1]*in[1] + u[r*4+2]*in[2] + u[r*4+3]*in[3];
+            }
+        }
+    }
+}
+
+QuantumCircuitTensorNetwork::QuantumCircuitTensorNetwork(int n, int max_tensor_qubits) :
+    QuantumCircuitBase(n, false),
+    max_tensor_qubits(max_tensor_qubits)
+{
+    if(n >= 64) throw invalid_argument("Number of qubits must be below 64.");
+    if(max_tensor_qubits < 4) throw invalid_argument("Tensors need room for at least 4 qubits.");
+    resetAll(0);
+}
+
+void QuantumCircuitTensorNetwork::checkQubit(int qubit) const {
+    if(qubit<0 || qubit>=qubit_count) throw out_of_range("Target qubit is out of range");
+}
+
+void QuantumCircuitTensorNetwork::checkDense() const {
+    if(qubit_count > MAX_DENSE_QUBITS) throw logic_error("The state of " + to_string(qubit_count) + " qubits is too large to expand into a state vector.");
+}
+
+//Recording gates
+
+void QuantumCircuitTensorNetwork::applySingleQubitOp(int target_qubit, function<void(complex<double>&,complex<double>&)> op){
+    if(dense_view) return QuantumCircuitBase::applySingleQubitOp(target_qubit, op);
+    checkQubit(target_qubit);
+    Tensor &tensor = tensors[wire_tensor[target_qubit]];
+    int position = find(tensor.legs.begin(), tensor.legs.end(), wire[target_qubit]) - tensor.legs.begin();
+    applyToLeg(tensor.data, position, QuantumGates::singleQubitMatrix(op));
+}
+
+void QuantumCircuitTensorNetwork::applyTwoQubitOp(int qubit_1, int qubit_2, function<void(complex<double>&,complex<double>&,complex<double>&,complex<double>&)> op){
+    if(dense_view) return QuantumCircuitBase::applyTwoQubitOp(qubit_1, qubit_2, op);
+    if(qubit_1 >= qubit_count || qubit_1 < 0 || qubit_2 >= qubit_count || qubit_2 <0) throw out_of_range("Qubits out of range.");
+    if(qubit_1 == qubit_2) throw invalid_argument("Qubits cannot be the same");
+    addTwoQubitTensor(qubit_1, qubit_2, QuantumGates::twoQubitMatrix(op));
+}
+
+void QuantumCircuitTensorNetwork::applyControlledQubitOp(int control_qubit, int target_qubit, function<void(complex<double>&, complex<double>&)> op){
+    if(dense_view) return QuantumCircuitBase::applyControlledQubitOp(control_qubit, target_qubit, op);
+    if(control_qubit >= qubit_count || control_qubit < 0 || target_qubit >= qubit_count || target_qubit <0) throw out_of_range("Qubits out of range.");
+    if(control_qubit == target_qubit) throw invalid_argument("Control and target qubits cannot be the same.");
+    array<complex<double>,4> m = QuantumGates::singleQubitMatrix(op);
+    addTwoQubitTensor(control_qubit, target_qubit, {1,0,0,0, 0,1,0,0, 0,0,m[0],m[1], 0,0,m[2],m[3]});
+}
+
+void QuantumCircuitTensorNetwork::addTwoQubitTensor(int qubit_1, int qubit_2, const array<complex<double>,16> &u){
+    //both wires end on the same tensor, e.g. a second gate on the same pair
+    if(wire_tensor[qubit_1] == wire_tensor[qubit_2]){
+        Tensor &tensor = tensors[wire_tensor[qubit_1]];
+        int first = find(tensor.legs.begin(), tensor.legs.end(), wire[qubit_1]) - tensor.legs.begin();
+        int second = find(tensor.legs.begin(), tensor.legs.end(), wire[qubit_2]) - tensor.legs.begin();
+        applyToLegs(tensor.data, first, second, u);
+        return;
+    }
+
+    //legs in_1, in_2, out_1, out_2
+    Tensor tensor;
+    tensor.legs = {wire[qubit_1], wire[qubit_2], leg_count, leg_count+1};
+    tensor.data.resize(16);
+    for(int in=0; in<4; in++){
+        for(int out=0; out<4; out++){
+            size_t index = (in>>1) | (in&1)<<1 | (out>>1)<<2 | (out&1)<<3;
+            tensor.data[index] = u[out*4+in];
+        }
+    }
+    wire[qubit_1] = leg_count++;
+    wire[qubit_2] = leg_count++;
+    wire_tensor[qubit_1] = wire_tensor[qubit_2] = tensors.size();
+    tensors.push_back(move(tensor));
+}
+
+void QuantumCircuitTensorNetwork::QFT(const vector<int> &qubits, bool inverse){
+    checkRegister(qubits);
+    applyQFTGates(qubits, inverse);
+}
+
+//Contraction
+
+QuantumCircuitTensorNetwork::Plan QuantumCircuitTensorNetwork::makePlan(const vector<bool> &fixed, int cap) const {
+    size_t count = tensors.size();
+    //legs with a tensor on both ends, the only ones worth slicing
+    vector<int> ends(leg_count, 0);
+    for(const Tensor &tensor: tensors) for(int leg: tensor.legs) ends[leg]++;
+
+    Plan plan;
+    vector<bool> removed = fixed;
+    while(true){
+        vector<vector<int>> legs(count);
+        for(size_t t=0; t<count; t++){
+            for(int leg: tensors[t].legs) if(!removed[leg]) legs[t].push_back(leg);
+        }
+        //the two tensors on every leg
+        vector<array<int,2>> owner(leg_count, {-1, -1});
+        for(size_t t=0; t<count; t++){
+            for(int leg: legs[t]) owner[leg][owner[leg][0] < 0 ? 0 : 1] = t;
+        }
+        vector<bool> alive(count, true);
+        plan.steps.clear();
+        plan.largest = 0;
+        for(auto &l: legs) plan.largest = max<int>(plan.largest, l.size());
+
+        auto merge = [&](int a, int b){
+            int k = legs.size();
+            for(int leg: legs[a]) for(int &o: owner[leg]) if(o == a) o = k;
+            for(int leg: legs[b]) for(int &o: owner[leg]) if(o == b) o = k;
+            //the shared legs are summed over
+            for(int leg: legs[a]) if(owner[leg][0] == k && owner[leg][1] == k) owner[leg] = {-1, -1};
+            legs.push_back(resultLegs(legs[a], legs[b]));
+            alive.push_back(true);
+            alive[a] = alive[b] = false;
+            plan.steps.push_back({a, b});
+            plan.largest = max<int>(plan.largest, legs[k].size());
+        };
+
+        //greedy: the pair of neighbours whose contraction grows the tensors the least
+        while(true){
+            int best_a = -1, best_b = -1;
+            double best_cost = 0;
+            int best_rank = 0;
+            for(int leg=0; leg<leg_count; leg++){
+                int a = owner[leg][0], b = owner[leg][1];
+                if(a < 0 || b < 0) continue;
+                int rank = legs[a].size() + legs[b].size() - 2*sharedCount(legs[a], legs[b]);
+                double cost = ldexp(1.0, rank) - ldexp(1.0, legs[a].size()) - ldexp(1.0, legs[b].size());
+                if(best_a < 0 || cost < best_cost || (cost == best_cost && rank < best_rank)){
+                    best_a = a; best_b = b; best_cost = cost; best_rank = rank;
+                }
+            }
+            if(best_a < 0) break;
+            merge(best_a, best_b);
+        }
+
+        //disconnected parts, outer products smallest first
+        vector<int> rest;
+        for(size_t t=0; t<legs.size(); t++) if(alive[t]) rest.push_back(t);
+        stable_sort(rest.begin(), rest.end(), [&](int a, int b){ return legs[a].size() < legs[b].size(); });
+        int current = rest[0];
+        for(size_t k=1; k<rest.size(); k++){
+            merge(current, rest[k]);
+            current = legs.size()-1;
+        }
+        plan.result_legs = legs[current];
+        if(plan.largest <= cap) return plan;
+
+        //slice the leg shared by the most tensors above the cap
+        vector<int> uses(leg_count, 0);
+        for(auto &l: legs){
+            if((int)l.size() <= cap) continue;
+            for(int leg: l) if(ends[leg] == 2) uses[leg]++;
+        }
+        int leg = max_element(uses.begin(), uses.end()) - uses.begin();
+        if(uses[leg] == 0) return plan;
+        removed[leg] = true;
+        plan.sliced.push_back(leg);
+    }
+}
+
+QuantumCircuitTensorNetwork::Tensor QuantumCircuitTensorNetwork::contractSlice(const Plan &plan, const vector<int> &value) const {
+    size_t count = tensors.size();
+    vector<Tensor> work(count + plan.steps.size());
+
+    //fixed legs projected out
+    for(size_t t=0; t<count; t++){
+        const Tensor &tensor = tensors[t];
+        size_t base = 0;
+        vector<int> kept;
+        for(size_t k=0; k<tensor.legs.size(); k++){
+            int v = value[tensor.legs[k]];
+            if(v < 0){
+                kept.push_back(k);
+                work[t].legs.push_back(tensor.legs[k]);
+            }else if(v){
+                base |= 1ULL << k;
+            }
+        }
+        vector<size_t> offset = offsets(kept);
+        work[t].data.resize(offset.size());
+        for(size_t i=0; i<offset.size(); i++) work[t].data[i] = tensor.data[base | offset[i]];
+    }
+
+    for(size_t s=0; s<plan.steps.size(); s++){
+        Tensor &a = work[plan.steps[s].first], &b = work[plan.steps[s].second];
+        vector<int> free_a, shared_a, free_b, shared_b;
+        for(size_t i=0; i<a.legs.size(); i++){
+            auto j = find(b.legs.begin(), b.legs.end(), a.legs[i]);
+            if(j == b.legs.end()) free_a.push_back(i);
+            else{
+                shared_a.push_back(i);
+                shared_b.push_back(j - b.legs.begin());
+            }
+        }
+        for(size_t j=0; j<b.legs.size(); j++){
+            if(find(a.legs.begin(), a.legs.end(), b.legs[j]) == a.legs.end()) free_b.push_back(j);
+        }
+        vector<size_t> a_free = offsets(free_a), a_shared = offsets(shared_a);
+        vector<size_t> b_free = offsets(free_b), b_shared = offsets(shared_b);
+
+        Tensor &result = work[count + s];
+        result.legs = resultLegs(a.legs, b.legs);
+        result.data.assign(a_free.size() * b_free.size(), 0.0);
+        vector<complex<double>> row(a_shared.size());
+        for(size_t ra=0; ra<a_free.size(); ra++){
+            for(size_t k=0; k<row.size(); k++) row[k] = a.data[a_free[ra] | a_shared[k]];
+            for(size_t rb=0; rb<b_free.size(); rb++){
+                const complex<double> *column = b.data.data() + b_free[rb];
+                complex<double> sum = 0.0;
+                for(size_t k=0; k<row.size(); k++) sum += row[k] * column[b_shared[k]];
+                result.data[ra + rb*a_free.size()] = sum;
+            }
+        }
+        //the inputs are not needed again
+        vector<complex<double>>().swap(a.data);
+        vector<complex<double>>().swap(b.data);
+    }
+    return move(work.back());
+}
+
+vector<complex<double>> QuantumCircuitTensorNetwork::amplitudes(const vector<size_t> &indices){
+    for(size_t index: indices){
+        if(index >> qubit_count) throw out_of_range("Basis state index out of range.");
+    }
+    vector<bool> fixed(leg_count, false);
+    for(int q=0; q<qubit_count; q++) fixed[wire[q]] = true;
+    Plan plan = makePlan(fixed, max_tensor_qubits);
+    size_t slices = 1ULL << plan.sliced.size();
+    last_slices = slices;
+    last_largest = plan.largest;
+
+    vector<complex<double>> result(indices.size(), 0.0);
+    //one task per bitstring and slice, the first failure is rethrown at the end
+    exception_ptr error;
+    #pragma omp parallel
+    {
+        vector<complex<double>> local(indices.size(), 0.0);
+        vector<int> value(leg_count, -1);
+        #pragma omp for schedule(dynamic)
+        for(size_t task=0; task<indices.size()*slices; task++){
+            size_t i = task / slices, slice = task % slices;
+            try{
+                for(int q=0; q<qubit_count; q++) value[wire[q]] = (indices[i] >> q) & 1;
+                for(size_t k=0; k<plan.sliced.size(); k++) value[plan.sliced[k]] = (slice >> k) & 1;
+                local[i] += contractSlice(plan, value).data[0];
+            }catch(...){
+                #pragma omp critical
+                if(!error) error = current_exception();
+            }
+        }
+        #pragma omp critical
+        for(size_t i=0; i<local.size(); i++) result[i] += local[i];
+    }
+    if(error) rethrow_exception(error);
+    return result;
+}
+
+complex<double> QuantumCircuitTensorNetwork::amplitude(size_t index){
+    return amplitudes({index})[0];
+}
+
+vector<complex<double>> QuantumCircuitTensorNetwork::exportState(){
+    if(dense_view) return state_vector;
+    checkDense();
+    //the result itself holds all n output legs
+    Plan plan = makePlan(vector<bool>(leg_count, false), max(max_tensor_qubits, qubit_count));
+    size_t slices = 1ULL << plan.sliced.size();
+    last_slices = slices;
+    last_largest = plan.largest;
+
+    vector<complex<double>> sum(1ULL << qubit_count, 0.0);
+    exception_ptr error;
+    #pragma omp parallel
+    {
+        vector<int> value(leg_count, -1);
+        #pragma omp for schedule(dynamic)
+        for(size_t slice=0; slice<slices; slice++){
+            try{
+                for(size_t k=0; k<plan.sliced.size(); k++) value[plan.sliced[k]] = (slice >> k) & 1;
+                Tensor tensor = contractSlice(plan, value);
+                #pragma omp critical
+                for(size_t i=0; i<sum.size(); i++) sum[i] += tensor.data[i];
+            }catch(...){
+                #pragma omp critical
+                if(!error) error = current_exception();
+            }
+        }
+    }
+    if(error) rethrow_exception(error);
+
+    //bit k of the result is the output leg of some qubit
+    vector<int> qubit_of(qubit_count);
+    for(int q=0; q<qubit_count; q++){
+        qubit_of[find(plan.result_legs.begin(), plan.result_legs.end(), wire[q]) - plan.result_legs.begin()] = q;
+    }
+    vector<complex<double>> state(sum.size());
+    for(size_t i=0; i<sum.size(); i++) state[deposit(i, qubit_of)] = sum[i];
+    return state;
+}
+
+void QuantumCircuitTensorNetwork::importState(const vector<complex<double>> &amplitudes){
+    if(dense_view){
+        QuantumCircuitBase::importState(amplitudes);
+        return;
+    }
+    checkStateSize(amplitudes.size());
+    tensors.assign(1, Tensor());
+    for(int q=0; q<qubit_count; q++){
+        tensors[0].legs.push_back(q);
+        wire[q] = q;
+        wire_tensor[q] = 0;
+    }
+    tensors[0].data = amplitudes;
+    leg_count = qubit_count;
+}
+
+void QuantumCircuitTensorNetwork::resetAll(int index){
+    if(dense_view){
+        QuantumCircuitBase::resetAll(index);
+        return;
+    }
+    if(index < 0 || (size_t)index >> qubit_count) throw out_of_range("Basis state index out of range.");
+    //one vector per qubit
+    tensors.assign(qubit_count, Tensor());
+    wire.resize(qubit_count);
+    wire_tensor.resize(qubit_count);
+    for(int q=0; q<qubit_count; q++){
+        bool one = (index >> q) & 1;
+        tensors[q].legs = {q};
+        tensors[q].data = {one ? 0.0 : 1.0, one ? 1.0 : 0.0};
+        wire[q] = q;
+        wire_tensor[q] = q;
+    }
+    leg_count = qubit_count;
+}
+
+unique_ptr<QuantumCircuitBase> QuantumCircuitTensorNetwork::clone(){
+    return unique_ptr<QuantumCircuitBase>(new QuantumCircuitTensorNetwork(*this));
+}
+
+//Everything that needs the whole state
+
+void QuantumCircuitTensorNetwork::withDenseState(const function<void()> &body, bool keep){
+    //already expanded, e.g. a measurement calling another one
+    if(dense_view){
+        body();
+        return;
+    }
+    checkDense();
+    state_vector = exportState();
+    dense_view = true;
+    try{
+        body();
+    }catch(...){
+        dense_view = false;
+        vector<complex<double>>().swap(state_vector);
+        throw;
+    }
+    dense_view = false;
+    vector<complex<double>> dense;
+    dense.swap(state_vector);
+    if(keep) importState(dense);
+}
+
+string QuantumCircuitTensorNetwork::collapse(){
+    string result;
+    withDenseState([&]{ result = QuantumCircuitBase::collapse(); }, true);
+    return result;
+}
+
+map<string,int> QuantumCircuitTensorNetwork::run(int num_shots){
+    map<string,int> result;
+    withDenseState([&]{ result = QuantumCircuitBase::run(num_shots); });
+    return result;
+}
+
+int QuantumCircuitTensorNetwork::measure_single_qubit(int qubit){
+    int result;
+    withDenseState([&]{ result = QuantumCircuitBase::measure_single_qubit(qubit); }, true);
+    return result;
+}
+
+string QuantumCircuitTensorNetwork::measure_range_of_qubits(const vector<int> &qubits){
+    string result;
+    withDenseState([&]{ result = QuantumCircuitBase::measure_range_of_qubits(qubits); }, true);
+    return result;
+}
+
+map<string,int> QuantumCircuitTensorNetwork::run_range_of_qubits(int num_shots, const vector<int> &qubits){
+    map<string,int> result;
+    withDenseState([&]{ result = QuantumCircuitBase::run_range_of_qubits(num_shots, qubits); });
+    return result;
+}
+
+double QuantumCircuitTensorNetwork::expectation(const Observable &observable){
+    double result;
+    withDenseState([&]{ result = QuantumCircuitBase::expectation(observable); });
+    return result;
+}
+
+vector<double> QuantumCircuitTensorNetwork::zParityExpectations(const vector<size_t> &z_masks){
+    if(dense_view) return QuantumCircuitBase::zParityExpectations(z_masks);
+    vector<double> result;
+    withDenseState([&]{ result = QuantumCircuitBase::zParityExpectations(z_masks); });
+    return result;
+}
+
+vector<double> QuantumCircuitTensorNetwork::maskedMarginal(size_t mask){
+    if(dense_view) return QuantumCircuitBase::maskedMarginal(mask);
+    vector<double> result;
+    withDenseState([&]{ result = QuantumCircuitBase::maskedMarginal(mask); });
+    return result;
+}
+
+void QuantumCircuitTensorNetwork::saveState(const string &path, QuantumSnapshot::Precision precision){
+    withDenseState([&]{ QuantumCircuitBase::saveState(path, precision); });
+}
+
+void QuantumCircuitTensorNetwork::loadState(const string &path){
+    checkDense();
+    QuantumSnapshot::MappedSnapshot snapshot(path);
+    if(snapshot.qubitCount() != qubit_count) throw invalid_argument("Snapshot has " + to_string(snapshot.qubitCount()) + " qubits, circuit has " + to_string(qubit_count) + ".");
+    vector<complex<double>> amplitudes;
+    snapshot.copyTo(amplitudes);
+    importState(amplitudes);
+
+    for(int i=0; i<qubit_count; i++){
+       circuit[i] += "[L]";
+    }
+}
+
+void QuantumCircuitTensorNetwork::printState(){
+    withDenseState([&]{ QuantumCircuitBase::printState(); });
+}
+
+void QuantumCircuitTensorNetwork::printProbabilities(){
+    withDenseState([&]{ QuantumCircuitBase::printProbabilities(); });
+}
+
+void QuantumCircuitTensorNetwork::displayGraph(){
+    withDenseState([&]{ QuantumCircuitBase::displayGraph(); });
+}
+
+void QuantumCircuitTensorNetwork::displayHeatMap(){
+    withDenseState([&]{ QuantumCircuitBase::displayHeatMap(); });
+}
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <MaQrel/QuantumFourier.h>
+#include <MaQrel/QuantumBits.h>
+using namespace std;
+
+namespace QuantumFourier {
+
+    Plan makePlan(const vector<int> &qubits, bool inverse){
+        Plan plan;
+        plan.qubits = qubits;
+        plan.bits = qubits.size();
+        size_t size = 1ULL<<plan.bits;
+
+        //offsets of the register values, built one bit at a time
+        plan.offsets.assign(size, 0);
+        for(int k=0; k<plan.bits; k++){
+            size_t bit = 1ULL<<qubits[k];
+            plan.register_mask |= bit;
+            size_t half = 1ULL<<k;
+            for(size_t y=0; y<half; y++) plan.offsets[half+y] = plan.offsets[y] | bit;
+        }
+        plan.reversed_offsets.resize(size);
+        for(size_t y=0; y<size; y++) plan.reversed_offsets[y] = plan.offsets[reverseBits(y, plan.bits)];
+
+        double sign = inverse ? -1.0 : 1.0;
+        plan.twiddles.resize(size/2);
+        for(size_t j=0; j<size/2; j++) plan.twiddles[j] = polar(1.0, sign * 2.0 * M_PI * j / size);
+        plan.scale = 1.0 / sqrt((double)size);
+        return plan;
+    }
+
+    size_t reverseBits(size_t value, int bits){
+        size_t result = 0;
+        for(int b=0; b<bits; b++){
+            result = (result<<1) | (value & 1);
+            value >>= 1;
+        }
+        return result;
+    }
+
+    size_t registerValue(size_t index, const Plan &plan){
+        size_t value = 0;
+        for(int k=0; k<plan.bits; k++) value |= ((index >> plan.qubits[k]) & 1ULL) << k;
+        return value;
+    }
+
+    void butterflyStage(complex<double> *data, const Plan &plan, size_t half, size_t first, size_t last){
+        //stage with blocks of 2*half uses every (size/(2*half))-th twiddle
+        size_t twiddle_step = (plan.twiddles.size()*2) / (2*half);
+        for(size_t j=first; j<last; j++){
+            size_t offset = j & (half-1);
+            size_t lo = ((j & ~(half-1))<<1) | offset;
+            complex<double> a = data[lo];
+            complex<double> b = data[lo+half] * plan.twiddles[offset*twiddle_step];
+            data[lo] = a + b;
+            data[lo+half] = a - b;
+        }
+    }
+
+    void transform(complex<double> *data, const Plan &plan){
+        size_t size = 1ULL<<plan.bits;
+        for(size_t half=1; half<size; half<<=1) butterflyStage(data, plan, half, 0, size/2);
+        for(size_t y=0; y<size; y++) data[y] *= plan.scale;
+    }
+
+    void transformSlice(complex<double> *state, size_t base, const Plan &plan, vector<complex<double>> &buffer){
+        size_t size = 1ULL<<plan.bits;
+        buffer.resize(size);
+        for(size_t y=0; y<size; y++) buffer[y] = state[base | plan.reversed_offsets[y]];
+        transform(buffer.data(), plan);
+        for(size_t y=0; y<size; y++) state[base | plan.offsets[y]] = buffer[y];
+    }
+
+    void apply(complex<double> *state, size_t size, const Plan &plan){
+        size_t free_mask = (size-1) & ~plan.register_mask;
+        size_t slices = size >> plan.bits;
+        vector<complex<double>> buffer;
+        for(size_t s=0; s<slices; s++){
+            transformSlice(state, QuantumBits::depositBits(s, free_mask), plan, buffer);
+        }
+    }
+}
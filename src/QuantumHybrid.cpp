@@ -0,0 +1,195 @@
+#include <omp.h>
+#include <exception>
+#include <stdexcept>
+#include <MaQrel/QuantumHybrid.h>
+#include <MaQrel/QuantumCircuitBase.h>
+using namespace std;
+
+//Serial state-vector circuit for one half, its state can be read and overwritten
+class QuantumHybridSimulator::HalfCircuit : public QuantumCircuitBase {
+public:
+    HalfCircuit(int n) : QuantumCircuitBase(n) { setDiagramEnabled(false); }
+    const vector<complex<double>>& state() const { return state_vector; }
+    void copyFrom(const HalfCircuit &other) { state_vector = other.state_vector; }
+};
+
+namespace {
+
+    //the dense state is never built above this
+    constexpr int MAX_DENSE_QUBITS = 30;
+
+    using Matrix2 = array<complex<double>,4>;
+    const complex<double> I(0.0, 1.0);
+    const Matrix2 IDENTITY = {1.0, 0.0, 0.0, 1.0};
+    const Matrix2 PROJECT_0 = {1.0, 0.0, 0.0, 0.0};
+    const Matrix2 PROJECT_1 = {0.0, 0.0, 0.0, 1.0};
+    const Matrix2 PAULI_X = {0.0, 1.0, 1.0, 0.0};
+    const Matrix2 PAULI_Y = {0.0, -I, I, 0.0};
+    const Matrix2 PAULI_Z = {1.0, 0.0, 0.0, -1.0};
+
+    //gate applied to the target of a controlled gate
+    GateKind targetKind(GateKind kind){
+        switch(kind){
+            case GateKind::CX: return GateKind::X;
+            case GateKind::CY: return GateKind::Y;
+            case GateKind::CZ: return GateKind::Z;
+            case GateKind::CH: return GateKind::H;
+            case GateKind::CS: return GateKind::S;
+            case GateKind::CSdg: return GateKind::Sdg;
+            case GateKind::CT: return GateKind::T;
+            case GateKind::CTdg: return GateKind::Tdg;
+            case GateKind::CP: return GateKind::P;
+            case GateKind::CRx: return GateKind::Rx;
+            case GateKind::CRy: return GateKind::Ry;
+            case GateKind::CRz: return GateKind::Rz;
+            default: throw invalid_argument(QuantumGateInfo::name(kind) + " is not a controlled gate.");
+        }
+    }
+}
+
+QuantumHybridSimulator::QuantumHybridSimulator(const QuantumProgram &program, const Options &options) :
+    qubit_count(program.qubitCount()),
+    split(options.split > 0 ? options.split : program.qubitCount() / 2),
+    threads(options.threads > 0 ? options.threads : omp_get_max_threads())
+{
+    if(qubit_count < 2) throw invalid_argument("The hybrid simulator needs at least two qubits.");
+    if(qubit_count >= 64) throw invalid_argument("Number of qubits must be below 64.");
+    if(split >= qubit_count) throw invalid_argument("Split " + to_string(split) + " leaves no qubits in the upper half.");
+
+    segments.emplace_back();
+    for(const GateOp &op: program.ops()){
+        bool two = QuantumGateInfo::arity(op.kind) == 2;
+        bool first_lower = op.qubit_1 < split;
+        if(!two || first_lower == (op.qubit_2 < split)){
+            GateOp local = op;
+            if(!first_lower){
+                local.qubit_1 -= split;
+                if(two) local.qubit_2 -= split;
+            }
+            (first_lower ? segments.back().lower : segments.back().upper).push_back(local);
+            continue;
+        }
+
+        Cut cut = cutOf(op, split);
+        if(path_count > options.max_paths / cut.terms.size())
+            throw invalid_argument("The program has more than " + to_string(options.max_paths) + " paths across the split at qubit " + to_string(split) + ".");
+        path_count *= cut.terms.size();
+        cuts.push_back(move(cut));
+        segments.emplace_back();
+    }
+}
+
+QuantumHybridSimulator::Cut QuantumHybridSimulator::cutOf(const GateOp &op, int split){
+    //terms as (matrix on qubit_1, matrix on qubit_2)
+    struct Pair { complex<double> coefficient; Matrix2 first, second; };
+    vector<Pair> pairs;
+    switch(op.kind){
+        case GateKind::SWAP:
+            pairs = {{0.5, IDENTITY, IDENTITY}, {0.5, PAULI_X, PAULI_X}, {0.5, PAULI_Y, PAULI_Y}, {0.5, PAULI_Z, PAULI_Z}};
+            break;
+        case GateKind::iSWAP:
+            pairs = {{0.5, IDENTITY, IDENTITY}, {0.5, PAULI_Z, PAULI_Z}, {0.5*I, PAULI_X, PAULI_X}, {0.5*I, PAULI_Y, PAULI_Y}};
+            break;
+        default:
+            //|0><0| on the control (x) I + |1><1| (x) U
+            pairs = {{1.0, PROJECT_0, IDENTITY}, {1.0, PROJECT_1, QuantumGateInfo::matrix({targetKind(op.kind), 0, -1, op.theta})}};
+    }
+
+    bool first_lower = op.qubit_1 < split;
+    Cut cut;
+    cut.lower_qubit = first_lower ? op.qubit_1 : op.qubit_2;
+    cut.upper_qubit = (first_lower ? op.qubit_2 : op.qubit_1) - split;
+    for(const Pair &pair: pairs){
+        Term term;
+        term.coefficient = pair.coefficient;
+        term.lower = first_lower ? pair.first : pair.second;
+        term.upper = first_lower ? pair.second : pair.first;
+        term.lower_identity = term.lower == IDENTITY;
+        term.upper_identity = term.upper == IDENTITY;
+        cut.terms.push_back(term);
+    }
+    return cut;
+}
+
+complex<double> QuantumHybridSimulator::runPath(size_t path, HalfCircuit &lower, HalfCircuit &upper, const HalfCircuit &lower_prefix, const HalfCircuit &upper_prefix) const {
+    lower.copyFrom(lower_prefix);
+    upper.copyFrom(upper_prefix);
+    complex<double> coefficient = 1.0;
+    //path is a mixed radix number, one digit per cut
+    for(size_t c=0; c<cuts.size(); c++){
+        const Cut &cut = cuts[c];
+        const Term &term = cut.terms[path % cut.terms.size()];
+        path /= cut.terms.size();
+        coefficient *= term.coefficient;
+        if(!term.lower_identity) lower.U(cut.lower_qubit, term.lower);
+        if(!term.upper_identity) upper.U(cut.upper_qubit, term.upper);
+        for(const GateOp &op: segments[c+1].lower) QuantumGateInfo::apply(lower, op);
+        for(const GateOp &op: segments[c+1].upper) QuantumGateInfo::apply(upper, op);
+    }
+    return coefficient;
+}
+
+template<class F>
+void QuantumHybridSimulator::forEachPath(F body){
+    //everything before the first cut is shared by all paths
+    HalfCircuit lower_prefix(split), upper_prefix(qubit_count - split);
+    for(const GateOp &op: segments[0].lower) QuantumGateInfo::apply(lower_prefix, op);
+    for(const GateOp &op: segments[0].upper) QuantumGateInfo::apply(upper_prefix, op);
+
+    //the first failure is rethrown once every thread is done
+    exception_ptr error;
+    #pragma omp parallel num_threads(threads)
+    {
+        HalfCircuit lower(split), upper(qubit_count - split);
+        #pragma omp for schedule(dynamic)
+        for(size_t path=0; path<path_count; path++){
+            try{
+                complex<double> coefficient = runPath(path, lower, upper, lower_prefix, upper_prefix);
+                body(coefficient, lower.state(), upper.state());
+            }catch(...){
+                #pragma omp critical
+                if(!error) error = current_exception();
+            }
+        }
+    }
+    if(error) rethrow_exception(error);
+}
+
+vector<complex<double>> QuantumHybridSimulator::amplitudes(const vector<size_t> &indices){
+    for(size_t index: indices){
+        if(index >> qubit_count) throw out_of_range("Basis state index out of range.");
+    }
+    size_t lower_mask = (1ULL << split) - 1;
+
+    //per thread sums, added up at the end
+    vector<vector<complex<double>>> partial(threads);
+    forEachPath([&](complex<double> coefficient, const vector<complex<double>> &lower, const vector<complex<double>> &upper){
+        vector<complex<double>> &sum = partial[omp_get_thread_num()];
+        if(sum.empty()) sum.assign(indices.size(), 0.0);
+        for(size_t k=0; k<indices.size(); k++){
+            sum[k] += coefficient * lower[indices[k] & lower_mask] * upper[indices[k] >> split];
+        }
+    });
+
+    vector<complex<double>> result(indices.size(), 0.0);
+    for(const auto &sum: partial){
+        for(size_t k=0; k<sum.size(); k++) result[k] += sum[k];
+    }
+    return result;
+}
+
+vector<complex<double>> QuantumHybridSimulator::state(){
+    if(qubit_count > MAX_DENSE_QUBITS) throw logic_error("The state of " + to_string(qubit_count) + " qubits is too large to expand into a state vector.");
+    vector<complex<double>> result(1ULL << qubit_count, 0.0);
+    forEachPath([&](complex<double> coefficient, const vector<complex<double>> &lower, const vector<complex<double>> &upper){
+        //one path at a time, each one touches the whole state
+        #pragma omp critical(hybrid_state)
+        for(size_t high=0; high<upper.size(); high++){
+            complex<double> factor = coefficient * upper[high];
+            if(factor == 0.0) continue;
+            complex<double> *row = result.data() + (high << split);
+            for(size_t low=0; low<lower.size(); low++) row[low] += factor * lower[low];
+        }
+    });
+    return result;
+}
@@ -0,0 +1,328 @@
+#include <omp.h>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+#include <MaQrel/QuantumNoise.h>
+#include <MaQrel/QuantumCircuitBase.h>
+#include <MaQrel/QuantumVisualization.h>
+using namespace std;
+
+namespace {
+
+    void checkProbability(double p){
+        if(p < 0.0 || p > 1.0) throw invalid_argument("Noise probabilities must be in [0, 1].");
+    }
+
+    void checkQubit(int qubit){
+        if(qubit < 0) throw out_of_range("Qubits out of range.");
+    }
+
+    //Serial state-vector circuit for one trajectory, the trajectories themselves are
+    //spread over the threads
+    class TrajectoryCircuit : public QuantumCircuitBase {
+    public:
+        TrajectoryCircuit(int n) : QuantumCircuitBase(n) { setDiagramEnabled(false); }
+
+        vector<complex<double>>& state() { return state_vector; }
+
+        //pauli holds 2 bits per qubit, 1 = X, 2 = Y, 3 = Z
+        void applyPauli(const vector<int> &qubits, int pauli){
+            for(size_t k=0; k<qubits.size(); k++){
+                switch((pauli >> (2*k)) & 3){
+                    case 1: X(qubits[k]); break;
+                    case 2: Y(qubits[k]); break;
+                    case 3: Z(qubits[k]); break;
+                }
+            }
+        }
+
+        //one Kraus operator drawn with its probability: the decay |1> -> |0> or the no-jump evolution
+        void amplitudeDamping(int qubit, double gamma, mt19937_64 &gen){
+            double prob_of_one = 0.0;
+            size_t bit = 1ULL<<qubit;
+            for(size_t i=0; i<state_vector.size(); i++){
+                if(i & bit) prob_of_one += norm(state_vector[i]);
+            }
+            double jump = gamma * prob_of_one;
+            if(uniform_real_distribution<double>(0.0, 1.0)(gen) < jump){
+                double scale = 1.0 / sqrt(prob_of_one);
+                applySingleQubitOp(qubit, [=](complex<double> &a, complex<double> &b){
+                    a = b * scale;
+                    b = 0.0;
+                });
+            }else{
+                double scale = 1.0 / sqrt(1.0 - jump);
+                double decay = sqrt(1.0 - gamma);
+                applySingleQubitOp(qubit, [=](complex<double> &a, complex<double> &b){
+                    a *= scale;
+                    b *= decay * scale;
+                });
+            }
+        }
+    };
+
+    struct DrawnError {
+        size_t op;
+        size_t site;
+        int pauli;
+    };
+
+    struct Plan {
+        int trajectory;
+        size_t branch; //ops applied before the first noise draw
+        bool noiseless;
+        vector<DrawnError> errors;
+    };
+
+    mt19937_64 streamFor(uint64_t seed, int trajectory, int stream){
+        seed_seq sequence{(uint32_t)seed, (uint32_t)(seed>>32), (uint32_t)trajectory, (uint32_t)stream};
+        return mt19937_64(sequence);
+    }
+
+    vector<double> cumulative(const vector<complex<double>> &state){
+        vector<double> cdf(state.size());
+        double sum = 0.0;
+        for(size_t i=0; i<state.size(); i++){
+            sum += norm(state[i]);
+            cdf[i] = sum;
+        }
+        return cdf;
+    }
+}
+
+//Noise model
+
+void NoiseModel::addDepolarizing(double p){
+    checkProbability(p);
+    all_gates.push_back({NoiseChannel::Type::Depolarizing, p});
+}
+
+void NoiseModel::addAmplitudeDamping(double gamma){
+    checkProbability(gamma);
+    all_gates.push_back({NoiseChannel::Type::AmplitudeDamping, gamma});
+}
+
+void NoiseModel::addDepolarizing(GateKind kind, double p){
+    checkProbability(p);
+    per_gate[kind].push_back({NoiseChannel::Type::Depolarizing, p});
+}
+
+void NoiseModel::addAmplitudeDamping(GateKind kind, double gamma){
+    checkProbability(gamma);
+    per_gate[kind].push_back({NoiseChannel::Type::AmplitudeDamping, gamma});
+}
+
+void NoiseModel::addQubitDepolarizing(int qubit, double p){
+    checkQubit(qubit);
+    checkProbability(p);
+    per_qubit[qubit].push_back({NoiseChannel::Type::Depolarizing, p});
+}
+
+void NoiseModel::addQubitAmplitudeDamping(int qubit, double gamma){
+    checkQubit(qubit);
+    checkProbability(gamma);
+    per_qubit[qubit].push_back({NoiseChannel::Type::AmplitudeDamping, gamma});
+}
+
+void NoiseModel::setReadoutError(double p01, double p10){
+    checkProbability(p01);
+    checkProbability(p10);
+    default_readout = {p01, p10};
+}
+
+void NoiseModel::setReadoutError(int qubit, double p01, double p10){
+    checkQubit(qubit);
+    checkProbability(p01);
+    checkProbability(p10);
+    readout[qubit] = {p01, p10};
+}
+
+vector<NoiseModel::Site> NoiseModel::sitesAfter(const GateOp &op) const {
+    vector<int> qubits = {op.qubit_1};
+    if(QuantumGateInfo::arity(op.kind) == 2) qubits.push_back(op.qubit_2);
+
+    vector<Site> sites;
+    auto attach = [&](const NoiseChannel &channel){
+        if(channel.probability == 0.0) return;
+        if(channel.type == NoiseChannel::Type::Depolarizing) sites.push_back({qubits, channel});
+        else for(int q: qubits) sites.push_back({{q}, channel});
+    };
+    for(auto &channel: all_gates) attach(channel);
+    auto found = per_gate.find(op.kind);
+    if(found != per_gate.end()){
+        for(auto &channel: found->second) attach(channel);
+    }
+    for(int q: qubits){
+        auto on_qubit = per_qubit.find(q);
+        if(on_qubit == per_qubit.end()) continue;
+        for(auto &channel: on_qubit->second){
+            if(channel.probability != 0.0) sites.push_back({{q}, channel});
+        }
+    }
+    return sites;
+}
+
+bool NoiseModel::hasReadoutError() const {
+    if(default_readout.first > 0 || default_readout.second > 0) return true;
+    for(auto &entry: readout){
+        if(entry.second.first > 0 || entry.second.second > 0) return true;
+    }
+    return false;
+}
+
+void NoiseModel::checkQubitCount(int qubit_count) const {
+    //the maps are ordered, so the last key is the largest qubit
+    if((!per_qubit.empty() && per_qubit.rbegin()->first >= qubit_count) ||
+       (!readout.empty() && readout.rbegin()->first >= qubit_count))
+        throw out_of_range("Qubits out of range.");
+}
+
+pair<double,double> NoiseModel::readoutError(int qubit) const {
+    auto found = readout.find(qubit);
+    return found == readout.end() ? default_readout : found->second;
+}
+
+//Trajectories
+
+TrajectorySimulator::TrajectorySimulator(const QuantumProgram &program, const NoiseModel &noise) :
+    program(program),
+    noise(noise)
+{
+    seed = random_device{}();
+    seed = (seed << 32) ^ random_device{}();
+
+    first_damping = program.size();
+    for(size_t j=0; j<program.size(); j++){
+        sites.push_back(noise.sitesAfter(program[j]));
+        for(auto &site: sites.back()){
+            if(site.channel.type == NoiseChannel::Type::AmplitudeDamping) first_damping = min(first_damping, j);
+        }
+    }
+}
+
+TrajectoryResult TrajectorySimulator::run(int num_trajectories, int shots_per_trajectory, const vector<Observable> &observables){
+    if(num_trajectories <= 0) throw invalid_argument("Number of trajectories must be positive.");
+    if(shots_per_trajectory < 0) throw invalid_argument("Number of shots cannot be negative.");
+    int n = program.qubitCount();
+    noise.checkQubitCount(n);
+    size_t num_ops = program.size();
+
+    //Depolarizing errors do not depend on the state, so they are drawn before simulating.
+    //Amplitude damping does, so every trajectory branches at the first damping site.
+    vector<Plan> plans(num_trajectories);
+    for(int t=0; t<num_trajectories; t++){
+        mt19937_64 gen = streamFor(seed, t, 0);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        Plan &plan = plans[t];
+        plan.trajectory = t;
+        for(size_t j=0; j<num_ops; j++){
+            for(size_t s=0; s<sites[j].size(); s++){
+                const NoiseModel::Site &site = sites[j][s];
+                if(site.channel.type != NoiseChannel::Type::Depolarizing) continue;
+                if(uniform(gen) >= site.channel.probability) continue;
+                int paulis = 1 << (2*site.qubits.size());
+                plan.errors.push_back({j, s, 1 + (int)(gen() % (paulis-1))});
+            }
+        }
+        size_t first_error = plan.errors.empty() ? num_ops : plan.errors[0].op;
+        plan.noiseless = plan.errors.empty() && first_damping == num_ops;
+        plan.branch = plan.noiseless ? num_ops : min(first_error, first_damping) + 1;
+    }
+
+    vector<int> noisy, noiseless;
+    for(auto &plan: plans) (plan.noiseless ? noiseless : noisy).push_back(plan.trajectory);
+    stable_sort(noisy.begin(), noisy.end(), [&](int a, int b){ return plans[a].branch < plans[b].branch; });
+
+    TrajectoryResult result;
+    result.trajectories = num_trajectories;
+    result.noiseless_trajectories = noiseless.size();
+    result.expectations.assign(observables.size(), 0.0);
+    bool readout_errors = noise.hasReadoutError();
+
+    //shots from one final state with the readout errors applied
+    auto sampleShots = [&](const vector<double> &cdf, mt19937_64 &gen, map<string,int> &counts){
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        for(int shot=0; shot<shots_per_trajectory; shot++){
+            double r = uniform(gen) * cdf.back();
+            size_t index = min<size_t>(upper_bound(cdf.begin(), cdf.end(), r) - cdf.begin(), cdf.size()-1);
+            if(readout_errors){
+                for(int q=0; q<n; q++){
+                    auto error = noise.readoutError(q);
+                    double flip = ((index>>q) & 1) ? error.second : error.first;
+                    if(flip > 0 && uniform(gen) < flip) index ^= 1ULL<<q;
+                }
+            }
+            counts[QuantumVisualization::basisString(index, n)]++;
+        }
+    };
+
+    //the noiseless prefix, advanced as far as the next batch needs it
+    TrajectoryCircuit prefix(n);
+    size_t prefix_ops = 0;
+
+    //each batch starts from the prefix at its earliest branch point and replays the
+    //few noiseless gates up to each trajectory's own branch point
+    size_t batch_size = 4 * omp_get_max_threads();
+    for(size_t start=0; start<noisy.size(); start+=batch_size){
+        size_t end = min(start+batch_size, noisy.size());
+        size_t batch_ops = plans[noisy[start]].branch - 1;
+        program.applyTo(prefix, prefix_ops, batch_ops);
+        prefix_ops = batch_ops;
+
+        #pragma omp parallel
+        {
+            TrajectoryCircuit circuit(n);
+            map<string,int> counts;
+            vector<double> sums(observables.size(), 0.0);
+
+            #pragma omp for schedule(dynamic)
+            for(size_t k=start; k<end; k++){
+                const Plan &plan = plans[noisy[k]];
+                mt19937_64 gen = streamFor(seed, plan.trajectory, 1);
+                circuit.state() = prefix.state();
+
+                size_t next_error = 0;
+                for(size_t j=batch_ops; j<num_ops; j++){
+                    QuantumGateInfo::apply(circuit, program[j]);
+                    for(size_t s=0; s<sites[j].size(); s++){
+                        const NoiseModel::Site &site = sites[j][s];
+                        if(site.channel.type == NoiseChannel::Type::AmplitudeDamping){
+                            circuit.amplitudeDamping(site.qubits[0], site.channel.probability, gen);
+                        }else if(next_error < plan.errors.size() && plan.errors[next_error].op == j && plan.errors[next_error].site == s){
+                            circuit.applyPauli(site.qubits, plan.errors[next_error].pauli);
+                            next_error++;
+                        }
+                    }
+                }
+
+                for(size_t o=0; o<observables.size(); o++) sums[o] += circuit.expectation(observables[o]);
+                if(shots_per_trajectory > 0) sampleShots(cumulative(circuit.state()), gen, counts);
+            }
+
+            #pragma omp critical
+            {
+                for(auto &entry: counts) result.counts[entry.first] += entry.second;
+                for(size_t o=0; o<observables.size(); o++) result.expectations[o] += sums[o];
+            }
+        }
+    }
+
+    //every noiseless trajectory ends in the same state, simulated once
+    if(!noiseless.empty()){
+        program.applyTo(prefix, prefix_ops, num_ops);
+        for(size_t o=0; o<observables.size(); o++){
+            result.expectations[o] += noiseless.size() * prefix.expectation(observables[o]);
+        }
+        if(shots_per_trajectory > 0){
+            vector<double> cdf = cumulative(prefix.state());
+            for(int t: noiseless){
+                mt19937_64 gen = streamFor(seed, t, 1);
+                sampleShots(cdf, gen, result.counts);
+            }
+        }
+    }
+
+    for(auto &value: result.expectations) value /= num_trajectories;
+    return result;
+}
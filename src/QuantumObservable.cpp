@@ -0,0 +1,101 @@
+#include <stdexcept>
+#include <MaQrel/QuantumObservable.h>
+#include <MaQrel/QuantumBits.h>
+using namespace std;
+
+void Observable::addTerm(double coefficient, const string &paulis, const vector<int> &qubits){
+    if(paulis.size() != qubits.size()) throw invalid_argument("Each Pauli needs exactly one qubit.");
+
+    size_t x_mask = 0, z_mask = 0;
+    for(size_t k=0; k<paulis.size(); k++){
+        int q = qubits[k];
+        if(q < 0 || q >= 64) throw out_of_range("Qubits out of range.");
+        size_t bit = 1ULL << q;
+        if((x_mask|z_mask) & bit) throw invalid_argument("Qubit repeated in a Pauli string.");
+
+        switch(paulis[k]){
+            case 'I': case 'i': break;
+            case 'X': case 'x': x_mask |= bit; break;
+            case 'Y': case 'y': x_mask |= bit; z_mask |= bit; break;
+            case 'Z': case 'z': z_mask |= bit; break;
+            default: throw invalid_argument("Pauli strings may only contain I, X, Y and Z.");
+        }
+    }
+
+    grouped = false;
+    if((x_mask|z_mask) == 0){
+        identity_coefficient += coefficient;
+        return;
+    }
+    //merge repeated strings so they are only evaluated once
+    auto found = term_index.find({x_mask, z_mask});
+    if(found != term_index.end()){
+        terms[found->second].coefficient += coefficient;
+        return;
+    }
+    term_index[{x_mask, z_mask}] = terms.size();
+    terms.push_back({coefficient, x_mask, z_mask});
+}
+
+void Observable::addTerm(double coefficient, const string &pauli_string){
+    vector<int> qubits(pauli_string.size());
+    for(size_t k=0; k<pauli_string.size(); k++) qubits[k] = pauli_string.size()-1-k;
+    addTerm(coefficient, pauli_string, qubits);
+}
+
+const vector<vector<int>>& Observable::qubitWiseGroups() const {
+    if(grouped) return groups;
+    groups.clear();
+
+    //per group: the X and Z parts of the basis it is measured in
+    vector<size_t> group_x, group_z;
+    for(int t=0; t<(int)terms.size(); t++){
+        const PauliTerm &term = terms[t];
+        size_t support = term.x_mask | term.z_mask;
+
+        size_t g = 0;
+        for(; g<groups.size(); g++){
+            size_t shared = support & (group_x[g] | group_z[g]);
+            if((((term.x_mask ^ group_x[g]) | (term.z_mask ^ group_z[g])) & shared) == 0) break;
+        }
+        if(g == groups.size()){
+            groups.emplace_back();
+            group_x.push_back(0);
+            group_z.push_back(0);
+        }
+        groups[g].push_back(t);
+        group_x[g] |= term.x_mask;
+        group_z[g] |= term.z_mask;
+    }
+    grouped = true;
+    return groups;
+}
+
+namespace PauliParity {
+
+    bool useHistogram(size_t num_masks, size_t support, int max_qubits){
+        int k = QuantumBits::popcount(support);
+        return num_masks > 1 && (k <= HISTOGRAM_MAX_QUBITS || ((int)num_masks > k && k <= max_qubits));
+    }
+
+    void walshHadamard(vector<double> &data){
+        size_t n = data.size();
+        for(size_t half=1; half<n; half<<=1){
+            for(size_t i=0; i<n; i+=half<<1){
+                for(size_t j=i; j<i+half; j++){
+                    double a = data[j], b = data[j+half];
+                    data[j] = a+b;
+                    data[j+half] = a-b;
+                }
+            }
+        }
+    }
+
+    vector<double> fromTransformed(const vector<double> &transformed, const vector<size_t> &z_masks, size_t support){
+        vector<double> values(z_masks.size());
+        for(size_t t=0; t<z_masks.size(); t++){
+            values[t] = transformed[QuantumBits::compactBits(z_masks[t], support)];
+        }
+        return values;
+    }
+}
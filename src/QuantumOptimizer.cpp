@@ -0,0 +1,197 @@
+#include <cmath>
+#include <vector>
+#include <MaQrel/QuantumOptimizer.h>
+using namespace std;
+
+namespace {
+
+    //how a gate acts on one of its qubits, two gates commute when they act through the
+    //same commuting family on every qubit they share
+    enum class Role { Z, X, Y, Other };
+
+    Role singleRole(GateKind kind){
+        switch(kind){
+            case GateKind::Z: case GateKind::S: case GateKind::Sdg: case GateKind::T: case GateKind::Tdg:
+            case GateKind::P: case GateKind::Rz:
+                return Role::Z;
+            case GateKind::X: case GateKind::Rx: return Role::X;
+            case GateKind::Y: case GateKind::Ry: return Role::Y;
+            default: return Role::Other;
+        }
+    }
+
+    Role roleOn(const GateOp &op, int qubit){
+        if(QuantumGateInfo::arity(op.kind) == 1) return singleRole(op.kind);
+        if(op.kind == GateKind::SWAP || op.kind == GateKind::iSWAP) return Role::Other;
+        //the control acts through the projectors |0><0| and |1><1|
+        if(qubit == op.qubit_1) return Role::Z;
+        switch(op.kind){
+            case GateKind::CX: case GateKind::CRx: return Role::X;
+            case GateKind::CY: case GateKind::CRy: return Role::Y;
+            case GateKind::CH: return Role::Other;
+            default: return Role::Z;
+        }
+    }
+
+    bool touches(const GateOp &op, int qubit){
+        return op.qubit_1 == qubit || (QuantumGateInfo::arity(op.kind) == 2 && op.qubit_2 == qubit);
+    }
+
+    bool commute(const GateOp &a, const GateOp &b){
+        for(int q: {a.qubit_1, QuantumGateInfo::arity(a.kind) == 2 ? a.qubit_2 : -1}){
+            if(q < 0 || !touches(b, q)) continue;
+            Role role = roleOn(a, q);
+            if(role == Role::Other || role != roleOn(b, q)) return false;
+        }
+        return true;
+    }
+
+    //angle of the single qubit phase gates, diag(1, e^{i angle})
+    bool phaseAngle(const GateOp &op, double &angle){
+        switch(op.kind){
+            case GateKind::Z: case GateKind::CZ: angle = M_PI; return true;
+            case GateKind::S: case GateKind::CS: angle = M_PI/2; return true;
+            case GateKind::Sdg: case GateKind::CSdg: angle = -M_PI/2; return true;
+            case GateKind::T: case GateKind::CT: angle = M_PI/4; return true;
+            case GateKind::Tdg: case GateKind::CTdg: angle = -M_PI/4; return true;
+            case GateKind::P: case GateKind::CP: angle = op.theta; return true;
+            default: return false;
+        }
+    }
+
+    bool selfInverse(GateKind kind){
+        switch(kind){
+            case GateKind::H: case GateKind::X: case GateKind::Y:
+            case GateKind::CX: case GateKind::CY: case GateKind::CH: case GateKind::SWAP:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool isRotation(GateKind kind){
+        switch(kind){
+            case GateKind::Rx: case GateKind::Ry: case GateKind::Rz:
+            case GateKind::CRx: case GateKind::CRy: case GateKind::CRz:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    //theta is a multiple of period
+    bool isMultiple(double theta, double period){
+        double r = remainder(theta, period);
+        return fabs(r) < 1e-12;
+    }
+
+    //true when op is the identity: phases repeat every 2 pi, rotations every 4 pi
+    bool isIdentity(const GateOp &op){
+        double angle;
+        if(phaseAngle(op, angle)) return isMultiple(angle, 2*M_PI);
+        if(isRotation(op.kind)) return isMultiple(op.theta, 4*M_PI);
+        return false;
+    }
+
+    bool sameQubits(const GateOp &a, const GateOp &b){
+        return a.qubit_1 == b.qubit_1 && (QuantumGateInfo::arity(a.kind) == 1 || a.qubit_2 == b.qubit_2);
+    }
+
+    bool samePair(const GateOp &a, const GateOp &b){
+        return (a.qubit_1 == b.qubit_1 && a.qubit_2 == b.qubit_2) || (a.qubit_1 == b.qubit_2 && a.qubit_2 == b.qubit_1);
+    }
+
+    enum class Combination { None, Cancel, Merge };
+
+    //folds later into earlier when the two gates are adjacent
+    Combination combine(GateOp &earlier, const GateOp &later){
+        if(QuantumGateInfo::arity(earlier.kind) != QuantumGateInfo::arity(later.kind)) return Combination::None;
+        bool two = QuantumGateInfo::arity(later.kind) == 2;
+
+        if(earlier.kind == later.kind && selfInverse(later.kind)){
+            bool same = later.kind == GateKind::SWAP ? samePair(earlier, later) : sameQubits(earlier, later);
+            return same ? Combination::Cancel : Combination::None;
+        }
+
+        //diag(1, e^{ia}) on one qubit or on |11> of a pair, symmetric in the pair
+        double a, b;
+        if(phaseAngle(earlier, a) && phaseAngle(later, b)){
+            if(two ? !samePair(earlier, later) : earlier.qubit_1 != later.qubit_1) return Combination::None;
+            earlier.kind = two ? GateKind::CP : GateKind::P;
+            earlier.theta = a + b;
+            return isIdentity(earlier) ? Combination::Cancel : Combination::Merge;
+        }
+
+        if(earlier.kind == later.kind && isRotation(later.kind) && sameQubits(earlier, later)){
+            earlier.theta += later.theta;
+            return isIdentity(earlier) ? Combination::Cancel : Combination::Merge;
+        }
+        return Combination::None;
+    }
+}
+
+namespace QuantumOptimizer {
+
+    QuantumProgram optimize(const QuantumProgram &program, Report *report, int window){
+        Report counts;
+        counts.input_gates = program.size();
+
+        vector<GateOp> ops;
+        vector<bool> alive;
+        //indices into ops of the gates on each qubit, oldest first
+        vector<vector<size_t>> on_qubit(program.qubitCount());
+
+        for(const GateOp &op: program.ops()){
+            if(isIdentity(op)){
+                counts.dropped++;
+                continue;
+            }
+
+            int qubits[2] = {op.qubit_1, QuantumGateInfo::arity(op.kind) == 2 ? op.qubit_2 : -1};
+            //walk back over the earlier gates on these qubits, newest first
+            size_t cursor[2] = {on_qubit[qubits[0]].size(), qubits[1] >= 0 ? on_qubit[qubits[1]].size() : 0};
+            bool placed = false;
+            for(int visited = 0; visited < window; ){
+                long best = -1;
+                for(int k=0; k<2; k++){
+                    if(qubits[k] < 0) continue;
+                    auto &list = on_qubit[qubits[k]];
+                    while(cursor[k] > 0 && !alive[list[cursor[k]-1]]) cursor[k]--;
+                    if(cursor[k] > 0) best = max<long>(best, list[cursor[k]-1]);
+                }
+                if(best < 0) break;
+                for(int k=0; k<2; k++){
+                    if(qubits[k] >= 0 && cursor[k] > 0 && on_qubit[qubits[k]][cursor[k]-1] == (size_t)best) cursor[k]--;
+                }
+                visited++;
+
+                GateOp &earlier = ops[best];
+                Combination result = combine(earlier, op);
+                if(result == Combination::Cancel){
+                    alive[best] = false;
+                    placed = true;
+                    break;
+                }
+                if(result == Combination::Merge){
+                    counts.merged++;
+                    placed = true;
+                    break;
+                }
+                if(!commute(earlier, op)) break;
+            }
+            if(placed) continue;
+
+            ops.push_back(op);
+            alive.push_back(true);
+            for(int q: qubits) if(q >= 0) on_qubit[q].push_back(ops.size()-1);
+        }
+
+        QuantumProgram optimized(program.qubitCount());
+        for(size_t i=0; i<ops.size(); i++) if(alive[i]) optimized.add(ops[i]);
+        counts.output_gates = optimized.size();
+        //a merged gate that turned into the identity counts as cancelled, not merged
+        counts.cancelled = counts.input_gates - counts.output_gates - counts.merged - counts.dropped;
+        if(report) *report = counts;
+        return optimized;
+    }
+}
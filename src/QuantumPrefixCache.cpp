@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstring>
+#include <MaQrel/QuantumPrefixCache.h>
+#include <MaQrel/QuantumCircuitBase.h>
+using namespace std;
+
+namespace {
+
+    uint64_t mix(uint64_t x){
+        //splitmix64 finaliser
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t angleBits(double theta){
+        uint64_t bits;
+        memcpy(&bits, &theta, sizeof(bits));
+        return bits;
+    }
+
+    //theta only counts for the gates that use it
+    bool sameOp(const GateOp &a, const GateOp &b){
+        if(a.kind != b.kind || a.qubit_1 != b.qubit_1 || a.qubit_2 != b.qubit_2) return false;
+        return !QuantumGateInfo::hasAngle(a.kind) || angleBits(a.theta) == angleBits(b.theta);
+    }
+
+    size_t commonPrefix(const vector<GateOp> &a, const vector<GateOp> &b){
+        size_t length = 0;
+        while(length < a.size() && length < b.size() && sameOp(a[length], b[length])) length++;
+        return length;
+    }
+}
+
+QuantumPrefixCache::QuantumPrefixCache(size_t memory_budget) : memory_budget(memory_budget) {}
+
+vector<uint64_t> QuantumPrefixCache::prefixKeys(const QuantumProgram &program){
+    vector<uint64_t> keys(program.size()+1);
+    keys[0] = mix(program.qubitCount());
+    for(size_t i=0; i<program.size(); i++){
+        const GateOp &op = program[i];
+        uint64_t word = (uint64_t)op.kind | (uint64_t)(uint32_t)op.qubit_1 << 8 | (uint64_t)(uint32_t)(op.qubit_2+1) << 36;
+        uint64_t key = mix(keys[i] ^ word);
+        if(QuantumGateInfo::hasAngle(op.kind)) key = mix(key ^ angleBits(op.theta));
+        keys[i+1] = key;
+    }
+    return keys;
+}
+
+pair<size_t, QuantumPrefixCache::State> QuantumPrefixCache::lookup(const QuantumProgram &program){
+    vector<uint64_t> keys = prefixKeys(program);
+    lock_guard<mutex> guard(lock);
+    for(size_t length=program.size(); length>0; length--){
+        auto found = index.find(keys[length]);
+        if(found == index.end()) continue;
+        const Entry &entry = *found->second;
+        //a fingerprint collision is a miss
+        if(entry.qubit_count != program.qubitCount() || entry.prefix.size() != length) continue;
+        if(commonPrefix(entry.prefix, program.ops()) != length) continue;
+
+        entries.splice(entries.begin(), entries, found->second);
+        counters.hits++;
+        counters.skipped_ops += length;
+        return {length, entry.state};
+    }
+    counters.misses++;
+    return {0, nullptr};
+}
+
+void QuantumPrefixCache::insert(const QuantumProgram &program, size_t length, vector<complex<double>> state){
+    length = min(length, program.size());
+    size_t bytes = state.size()*sizeof(complex<double>) + length*sizeof(GateOp);
+    if(bytes > memory_budget) return;
+    uint64_t key = prefixKeys(program)[length];
+
+    lock_guard<mutex> guard(lock);
+    auto found = index.find(key);
+    if(found != index.end()){
+        const Entry &entry = *found->second;
+        if(entry.qubit_count == program.qubitCount() && entry.prefix.size() == length &&
+           commonPrefix(entry.prefix, program.ops()) == length){
+            entries.splice(entries.begin(), entries, found->second);
+            return;
+        }
+        //collision, the newer prefix takes the slot
+        counters.bytes -= found->second->bytes;
+        entries.erase(found->second);
+        index.erase(found);
+    }
+    evictFor(bytes);
+
+    Entry entry;
+    entry.key = key;
+    entry.qubit_count = program.qubitCount();
+    entry.prefix.assign(program.ops().begin(), program.ops().begin()+length);
+    entry.state = make_shared<const vector<complex<double>>>(move(state));
+    entry.bytes = bytes;
+    entries.push_front(move(entry));
+    index[key] = entries.begin();
+    counters.bytes += bytes;
+}
+
+void QuantumPrefixCache::evictFor(size_t bytes){
+    while(!entries.empty() && counters.bytes + bytes > memory_budget){
+        counters.bytes -= entries.back().bytes;
+        index.erase(entries.back().key);
+        entries.pop_back();
+        counters.evictions++;
+    }
+}
+
+size_t QuantumPrefixCache::run(const QuantumProgram &program, QuantumCircuitBase &circuit){
+    auto [resumed, state] = lookup(program);
+    size_t diverged;
+    {
+        lock_guard<mutex> guard(lock);
+        diverged = commonPrefix(previous, program.ops());
+        previous = program.ops();
+    }
+    if(state) circuit.importState(*state);
+
+    //where to keep the state: the divergence point, likely shared with the next program,
+    //and every checkpoint_interval ops
+    vector<size_t> checkpoints;
+    if(diverged > resumed) checkpoints.push_back(diverged);
+    if(checkpoint_interval > 0){
+        for(size_t at=(resumed/checkpoint_interval+1)*checkpoint_interval; at<=program.size(); at+=checkpoint_interval){
+            checkpoints.push_back(at);
+        }
+    }
+    sort(checkpoints.begin(), checkpoints.end());
+    checkpoints.erase(unique(checkpoints.begin(), checkpoints.end()), checkpoints.end());
+
+    size_t position = resumed;
+    for(size_t at: checkpoints){
+        program.applyTo(circuit, position, at);
+        position = at;
+        insert(program, at, circuit.exportState());
+    }
+    program.applyTo(circuit, position);
+    return resumed;
+}
+
+void QuantumPrefixCache::clear(){
+    lock_guard<mutex> guard(lock);
+    entries.clear();
+    index.clear();
+    previous.clear();
+    counters.bytes = 0;
+}
+
+QuantumPrefixCache::Stats QuantumPrefixCache::stats() const {
+    lock_guard<mutex> guard(lock);
+    Stats current = counters;
+    current.entries = entries.size();
+    return current;
+}
@@ -0,0 +1,289 @@
+#include <MaQrel/QuantumProfiler.h>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+using namespace std;
+
+namespace QuantumProfiler {
+
+    namespace {
+
+        //trace events kept per thread, later ones are dropped
+        constexpr size_t MAX_TRACE_EVENTS = 1ULL<<20;
+
+        struct TraceEvent {
+            const char *name;
+            const char *category;
+            double start_us;
+            double duration_us;
+        };
+
+        //Everything a thread records, keyed by the string literal pointers so the hot
+        //path never builds a string. Merged by name when a report is taken.
+        struct ThreadStats {
+            int thread_id = 0;
+            unordered_map<const char*, uint64_t> gates;
+            unordered_map<const char*, KernelStats> kernels;
+            unordered_map<const char*, CommStats> comm;
+            vector<TraceEvent> trace;
+            bool counters_opened = false;
+            int cycles_fd = -1;
+            int misses_fd = -1;
+        };
+
+        struct Registry {
+            mutex lock;
+            vector<ThreadStats*> live;
+            //statistics of threads that already exited
+            Report retired;
+            vector<pair<int,TraceEvent>> retired_trace;
+            int next_thread_id = 0;
+            bool any_counters = false;
+        };
+
+        Registry& registry(){
+            static Registry instance;
+            return instance;
+        }
+
+        atomic<bool> tracing(false);
+        const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+        double microsecondsSinceEpoch(chrono::steady_clock::time_point t){
+            return chrono::duration<double, micro>(t - epoch).count();
+        }
+
+        void mergeInto(Report &report, const ThreadStats &stats){
+            for(auto &entry: stats.gates) report.gate_calls[entry.first] += entry.second;
+            for(auto &entry: stats.kernels){
+                KernelStats &target = report.kernels[entry.first];
+                target.calls += entry.second.calls;
+                target.seconds += entry.second.seconds;
+                target.bytes += entry.second.bytes;
+                target.cycles += entry.second.cycles;
+                target.llc_misses += entry.second.llc_misses;
+            }
+            for(auto &entry: stats.comm){
+                CommStats &target = report.communication[entry.first];
+                target.calls += entry.second.calls;
+                target.seconds += entry.second.seconds;
+                target.bytes += entry.second.bytes;
+            }
+        }
+
+    #ifdef __linux__
+        int openCounter(uint64_t config){
+            perf_event_attr attr = {};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            //this thread, any cpu
+            return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        uint64_t readCounter(int fd){
+            uint64_t value = 0;
+            if(fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+            return value;
+        }
+    #else
+        uint64_t readCounter(int){ return 0; }
+    #endif
+
+        void openCounters(ThreadStats &stats){
+            if(stats.counters_opened) return;
+            stats.counters_opened = true;
+        #ifdef __linux__
+            stats.cycles_fd = openCounter(PERF_COUNT_HW_CPU_CYCLES);
+            stats.misses_fd = openCounter(PERF_COUNT_HW_CACHE_MISSES);
+            if(stats.cycles_fd >= 0 || stats.misses_fd >= 0){
+                lock_guard<mutex> guard(registry().lock);
+                registry().any_counters = true;
+            }
+        #endif
+        }
+
+        struct Holder {
+            ThreadStats stats;
+            Holder(){
+                Registry &r = registry();
+                lock_guard<mutex> guard(r.lock);
+                stats.thread_id = r.next_thread_id++;
+                r.live.push_back(&stats);
+            }
+            ~Holder(){
+                Registry &r = registry();
+                lock_guard<mutex> guard(r.lock);
+                mergeInto(r.retired, stats);
+                for(auto &event: stats.trace) r.retired_trace.push_back({stats.thread_id, event});
+                r.live.erase(remove(r.live.begin(), r.live.end(), &stats), r.live.end());
+            #ifdef __linux__
+                if(stats.cycles_fd >= 0) close(stats.cycles_fd);
+                if(stats.misses_fd >= 0) close(stats.misses_fd);
+            #endif
+            }
+        };
+
+        ThreadStats& local(){
+            thread_local Holder holder;
+            return holder.stats;
+        }
+
+        void addTrace(ThreadStats &stats, const char *name, const char *category,
+                      chrono::steady_clock::time_point start, chrono::steady_clock::time_point end){
+            if(!tracing.load(memory_order_relaxed) || stats.trace.size() >= MAX_TRACE_EVENTS) return;
+            stats.trace.push_back({name, category, microsecondsSinceEpoch(start), chrono::duration<double, micro>(end - start).count()});
+        }
+    }
+
+    bool enabled(){
+    #ifdef MAQREL_PROFILE
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    bool hardwareCountersAvailable(){
+        ThreadStats &stats = local();
+        openCounters(stats);
+        return stats.cycles_fd >= 0 || stats.misses_fd >= 0;
+    }
+
+    void reset(){
+        Registry &r = registry();
+        lock_guard<mutex> guard(r.lock);
+        r.retired = Report();
+        r.retired_trace.clear();
+        for(ThreadStats *stats: r.live){
+            stats->gates.clear();
+            stats->kernels.clear();
+            stats->comm.clear();
+            stats->trace.clear();
+        }
+    }
+
+    Report report(){
+        Registry &r = registry();
+        lock_guard<mutex> guard(r.lock);
+        Report merged = r.retired;
+        for(ThreadStats *stats: r.live) mergeInto(merged, *stats);
+        merged.hardware_counters = r.any_counters;
+        return merged;
+    }
+
+    void printReport(ostream &out){
+        Report r = report();
+        ios_base::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+
+        out << "--- MaQrel Profile ---\n";
+        if(!enabled()) out << "(library built without MAQREL_PROFILE, nothing is recorded)\n";
+
+        out << "Gate calls\n";
+        for(auto &entry: r.gate_calls){
+            out << "  " << left << setw(10) << entry.first << right << setw(12) << entry.second << "\n";
+        }
+
+        out << "Kernels" << setw(31) << "calls" << setw(12) << "time[s]" << setw(12) << "GB" << setw(10) << "GB/s";
+        if(r.hardware_counters) out << setw(16) << "cycles" << setw(14) << "LLC misses";
+        out << "\n";
+        for(auto &entry: r.kernels){
+            const KernelStats &k = entry.second;
+            out << "  " << left << setw(28) << entry.first << right << setw(8) << k.calls
+                << fixed << setprecision(6) << setw(12) << k.seconds
+                << setprecision(3) << setw(12) << k.bytes / 1e9 << setw(10) << k.bandwidth();
+            if(r.hardware_counters) out << setw(16) << k.cycles << setw(14) << k.llc_misses;
+            out << "\n";
+        }
+
+        if(!r.communication.empty()){
+            out << "MPI communication" << setw(21) << "calls" << setw(12) << "time[s]" << setw(12) << "GB" << "\n";
+            for(auto &entry: r.communication){
+                const CommStats &c = entry.second;
+                out << "  " << left << setw(28) << entry.first << right << setw(8) << c.calls
+                    << fixed << setprecision(6) << setw(12) << c.seconds
+                    << setprecision(3) << setw(12) << c.bytes / 1e9 << "\n";
+            }
+        }
+        out << "----------------------\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    void setTracing(bool on){
+        tracing = on;
+    }
+
+    void writeTrace(const string &path){
+        ofstream out(path);
+        if(!out.is_open()) throw runtime_error("Could not open trace file " + path);
+
+        Registry &r = registry();
+        lock_guard<mutex> guard(r.lock);
+        vector<pair<int,TraceEvent>> events = r.retired_trace;
+        for(ThreadStats *stats: r.live){
+            for(auto &event: stats->trace) events.push_back({stats->thread_id, event});
+        }
+
+        out << fixed << setprecision(3);
+        out << "{\"traceEvents\":[\n";
+        for(size_t i=0; i<events.size(); i++){
+            const TraceEvent &e = events[i].second;
+            out << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"ts\":" << e.start_us
+                << ",\"dur\":" << e.duration_us << ",\"pid\":0,\"tid\":" << events[i].first << "}"
+                << (i+1 < events.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+    }
+
+    void countGate(const char *gate){
+        local().gates[gate]++;
+    }
+
+    KernelScope::KernelScope(const char *kernel, uint64_t bytes) : kernel(kernel), bytes(bytes) {
+        ThreadStats &stats = local();
+        openCounters(stats);
+        start_cycles = readCounter(stats.cycles_fd);
+        start_misses = readCounter(stats.misses_fd);
+        start = chrono::steady_clock::now();
+    }
+
+    KernelScope::~KernelScope(){
+        auto end = chrono::steady_clock::now();
+        ThreadStats &stats = local();
+        KernelStats &k = stats.kernels[kernel];
+        k.calls++;
+        k.seconds += chrono::duration<double>(end - start).count();
+        k.bytes += bytes;
+        k.cycles += readCounter(stats.cycles_fd) - start_cycles;
+        k.llc_misses += readCounter(stats.misses_fd) - start_misses;
+        addTrace(stats, kernel, "kernel", start, end);
+    }
+
+    CommScope::CommScope(const char *operation, uint64_t bytes) : operation(operation), bytes(bytes) {
+        start = chrono::steady_clock::now();
+    }
+
+    CommScope::~CommScope(){
+        auto end = chrono::steady_clock::now();
+        ThreadStats &stats = local();
+        CommStats &c = stats.comm[operation];
+        c.calls++;
+        c.seconds += chrono::duration<double>(end - start).count();
+        c.bytes += bytes;
+        addTrace(stats, operation, "mpi", start, end);
+    }
+}
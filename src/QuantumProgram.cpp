@@ -0,0 +1,109 @@
+#include <stdexcept>
+#include <algorithm>
+#include <MaQrel/QuantumProgram.h>
+#include <MaQrel/QuantumCircuitBase.h>
+#include <MaQrel/QuantumGates.h>
+using namespace std;
+
+namespace QuantumGateInfo {
+
+    int arity(GateKind kind){
+        return kind >= GateKind::CX ? 2 : 1;
+    }
+
+    bool hasAngle(GateKind kind){
+        switch(kind){
+            case GateKind::P: case GateKind::Rx: case GateKind::Ry: case GateKind::Rz:
+            case GateKind::CP: case GateKind::CRx: case GateKind::CRy: case GateKind::CRz:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    string name(GateKind kind){
+        static const char *names[] = {
+            "H", "X", "Y", "Z", "S", "Sdg", "T", "Tdg", "P", "Rx", "Ry", "Rz",
+            "CX", "CY", "CZ", "CH", "CS", "CSdg", "CT", "CTdg", "CP", "CRx", "CRy", "CRz",
+            "SWAP", "iSWAP"
+        };
+        return names[static_cast<int>(kind)];
+    }
+
+    void check(const GateOp &op, int qubit_count){
+        if(op.qubit_1 < 0 || op.qubit_1 >= qubit_count) throw out_of_range("Qubits out of range.");
+        if(arity(op.kind) == 2){
+            if(op.qubit_2 < 0 || op.qubit_2 >= qubit_count) throw out_of_range("Qubits out of range.");
+            if(op.qubit_1 == op.qubit_2) throw invalid_argument("Qubits cannot be the same");
+        }
+    }
+
+    array<complex<double>,4> matrix(const GateOp &op){
+        using namespace QuantumGates;
+        double theta = op.theta;
+        switch(op.kind){
+            case GateKind::H: return singleQubitMatrix(H_Function());
+            case GateKind::X: return singleQubitMatrix(X_Function());
+            case GateKind::Y: return singleQubitMatrix(Y_Function());
+            case GateKind::Z: return singleQubitMatrix(Z_Function());
+            case GateKind::S: return singleQubitMatrix(Phase_Function(I));
+            case GateKind::Sdg: return singleQubitMatrix(Phase_Function(-1.0 * I));
+            case GateKind::T: return singleQubitMatrix(Phase_Function(polar(1.0, M_PI / 4.0)));
+            case GateKind::Tdg: return singleQubitMatrix(Phase_Function(polar(1.0, -M_PI / 4.0)));
+            case GateKind::P: return singleQubitMatrix(Phase_Function(polar(1.0, theta)));
+            case GateKind::Rx: return singleQubitMatrix(Rx_Function(theta));
+            case GateKind::Ry: return singleQubitMatrix(Ry_Function(theta));
+            case GateKind::Rz: return singleQubitMatrix(Rz_Function(theta));
+            default: throw invalid_argument(name(op.kind) + " is not a single qubit gate.");
+        }
+    }
+
+    void apply(QuantumCircuitBase &circuit, const GateOp &op){
+        int a = op.qubit_1, b = op.qubit_2;
+        double theta = op.theta;
+        switch(op.kind){
+            case GateKind::H: circuit.H(a); break;
+            case GateKind::X: circuit.X(a); break;
+            case GateKind::Y: circuit.Y(a); break;
+            case GateKind::Z: circuit.Z(a); break;
+            case GateKind::S: circuit.S(a); break;
+            case GateKind::Sdg: circuit.Sdg(a); break;
+            case GateKind::T: circuit.T(a); break;
+            case GateKind::Tdg: circuit.Tdg(a); break;
+            case GateKind::P: circuit.P(a, theta); break;
+            case GateKind::Rx: circuit.Rx(a, theta); break;
+            case GateKind::Ry: circuit.Ry(a, theta); break;
+            case GateKind::Rz: circuit.Rz(a, theta); break;
+            case GateKind::CX: circuit.CX(a, b); break;
+            case GateKind::CY: circuit.CY(a, b); break;
+            case GateKind::CZ: circuit.CZ(a, b); break;
+            case GateKind::CH: circuit.CH(a, b); break;
+            case GateKind::CS: circuit.CS(a, b); break;
+            case GateKind::CSdg: circuit.CSdg(a, b); break;
+            case GateKind::CT: circuit.CT(a, b); break;
+            case GateKind::CTdg: circuit.CTdg(a, b); break;
+            case GateKind::CP: circuit.CP(a, b, theta); break;
+            case GateKind::CRx: circuit.CRx(a, b, theta); break;
+            case GateKind::CRy: circuit.CRy(a, b, theta); break;
+            case GateKind::CRz: circuit.CRz(a, b, theta); break;
+            case GateKind::SWAP: circuit.SWAP(a, b); break;
+            case GateKind::iSWAP: circuit.iSWAP(a, b); break;
+        }
+    }
+}
+
+QuantumProgram::QuantumProgram(int n) : qubit_count(n) {
+    if(n<=0) throw invalid_argument("Number of qubits must be positive.");
+}
+
+QuantumProgram& QuantumProgram::add(const GateOp &op){
+    QuantumGateInfo::check(op, qubit_count);
+    gate_ops.push_back(op);
+    if(QuantumGateInfo::arity(op.kind) == 1) gate_ops.back().qubit_2 = -1;
+    return *this;
+}
+
+void QuantumProgram::applyTo(QuantumCircuitBase &circuit, size_t first, size_t last) const {
+    last = min(last, gate_ops.size());
+    for(size_t i=first; i<last; i++) QuantumGateInfo::apply(circuit, gate_ops[i]);
+}
@@ -0,0 +1,738 @@
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cctype>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <MaQrel/QuantumQasm.h>
+#include <MaQrel/QuantumCircuitBase.h>
+using namespace std;
+
+namespace {
+
+    enum class TokenType { Identifier, Real, Integer, String, Symbol, End };
+
+    struct Token {
+        TokenType type = TokenType::End;
+        string text;
+        int line = 0;
+    };
+
+    //gate definitions of qelib1.inc without a backend method of their own
+    const char *QELIB1_DEFINITIONS = R"(
+gate cu3(theta,phi,lambda) c, t { u1((lambda+phi)/2) c; u1((lambda-phi)/2) t; cx c,t; u3(-theta/2,0,-(phi+lambda)/2) t; cx c,t; u3(theta/2,phi,0) t; }
+gate cu(theta,phi,lambda,gamma) c, t { p(gamma) c; p((lambda+phi)/2) c; p((lambda-phi)/2) t; cx c,t; u(-theta/2,0,-(phi+lambda)/2) t; cx c,t; u(theta/2,phi,0) t; }
+gate ccx a,b,c { h c; cx b,c; tdg c; cx a,c; t c; cx b,c; tdg c; cx a,c; t b; t c; h c; cx a,b; t a; tdg b; cx a,b; }
+gate cswap a,b,c { cx c,b; ccx a,b,c; cx c,b; }
+gate csx a,b { h b; cu1(pi/2) a,b; h b; }
+gate rxx(theta) a,b { u3(pi/2, theta, 0) a; h b; cx a,b; u1(-theta) b; cx a,b; h b; u2(-pi, pi-theta) a; }
+gate rzz(theta) a,b { cx a,b; u1(theta) b; cx a,b; }
+gate rccx a,b,c { u2(0,pi) c; u1(pi/4) c; cx b, c; u1(-pi/4) c; cx a, c; u1(pi/4) c; cx b, c; u1(-pi/4) c; u2(0,pi) c; }
+)";
+
+    array<complex<double>,4> u3Matrix(double theta, double phi, double lambda){
+        double c = cos(theta/2), s = sin(theta/2);
+        return {complex<double>(c, 0.0), -polar(s, lambda), polar(s, phi), polar(c, phi + lambda)};
+    }
+
+    const array<complex<double>,4> SX = {complex<double>(0.5, 0.5), complex<double>(0.5, -0.5), complex<double>(0.5, -0.5), complex<double>(0.5, 0.5)};
+    const array<complex<double>,4> SXDG = {complex<double>(0.5, -0.5), complex<double>(0.5, 0.5), complex<double>(0.5, 0.5), complex<double>(0.5, -0.5)};
+
+    //qelib1 gates that map onto a backend method, apply is null for the identities
+    struct NativeGate {
+        int params;
+        int qubits;
+        void (*apply)(QuantumCircuitBase &circuit, const double *p, const int *q);
+    };
+
+    const map<string, NativeGate>& nativeGates(){
+        static const map<string, NativeGate> gates = {
+            {"U",    {3, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.U(q[0], u3Matrix(p[0], p[1], p[2])); }}},
+            {"u3",   {3, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.U(q[0], u3Matrix(p[0], p[1], p[2])); }}},
+            {"u",    {3, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.U(q[0], u3Matrix(p[0], p[1], p[2])); }}},
+            {"u2",   {2, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.U(q[0], u3Matrix(M_PI/2, p[0], p[1])); }}},
+            {"u1",   {1, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.P(q[0], p[0]); }}},
+            {"p",    {1, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.P(q[0], p[0]); }}},
+            {"id",   {0, 1, nullptr}},
+            {"u0",   {1, 1, nullptr}},
+            {"x",    {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.X(q[0]); }}},
+            {"y",    {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.Y(q[0]); }}},
+            {"z",    {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.Z(q[0]); }}},
+            {"h",    {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.H(q[0]); }}},
+            {"s",    {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.S(q[0]); }}},
+            {"sdg",  {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.Sdg(q[0]); }}},
+            {"t",    {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.T(q[0]); }}},
+            {"tdg",  {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.Tdg(q[0]); }}},
+            {"sx",   {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.U(q[0], SX); }}},
+            {"sxdg", {0, 1, [](QuantumCircuitBase &c, const double *, const int *q){ c.U(q[0], SXDG); }}},
+            {"rx",   {1, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.Rx(q[0], p[0]); }}},
+            {"ry",   {1, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.Ry(q[0], p[0]); }}},
+            {"rz",   {1, 1, [](QuantumCircuitBase &c, const double *p, const int *q){ c.Rz(q[0], p[0]); }}},
+            {"CX",   {0, 2, [](QuantumCircuitBase &c, const double *, const int *q){ c.CX(q[0], q[1]); }}},
+            {"cx",   {0, 2, [](QuantumCircuitBase &c, const double *, const int *q){ c.CX(q[0], q[1]); }}},
+            {"cy",   {0, 2, [](QuantumCircuitBase &c, const double *, const int *q){ c.CY(q[0], q[1]); }}},
+            {"cz",   {0, 2, [](QuantumCircuitBase &c, const double *, const int *q){ c.CZ(q[0], q[1]); }}},
+            {"ch",   {0, 2, [](QuantumCircuitBase &c, const double *, const int *q){ c.CH(q[0], q[1]); }}},
+            {"cu1",  {1, 2, [](QuantumCircuitBase &c, const double *p, const int *q){ c.CP(q[0], q[1], p[0]); }}},
+            {"cp",   {1, 2, [](QuantumCircuitBase &c, const double *p, const int *q){ c.CP(q[0], q[1], p[0]); }}},
+            {"crx",  {1, 2, [](QuantumCircuitBase &c, const double *p, const int *q){ c.CRx(q[0], q[1], p[0]); }}},
+            {"cry",  {1, 2, [](QuantumCircuitBase &c, const double *p, const int *q){ c.CRy(q[0], q[1], p[0]); }}},
+            {"crz",  {1, 2, [](QuantumCircuitBase &c, const double *p, const int *q){ c.CRz(q[0], q[1], p[0]); }}},
+            {"swap", {0, 2, [](QuantumCircuitBase &c, const double *, const int *q){ c.SWAP(q[0], q[1]); }}},
+        };
+        return gates;
+    }
+
+    //Tokens of one source, read through a fixed buffer
+    class Lexer {
+        unique_ptr<istream> owned;
+        istream &in;
+        vector<char> buffer = vector<char>(1 << 16);
+        size_t position = 0;
+        size_t filled = 0;
+        int line = 1;
+
+        int peek(){
+            if(position == filled){
+                in.read(buffer.data(), buffer.size());
+                filled = in.gcount();
+                position = 0;
+                if(filled == 0) return EOF;
+            }
+            return (unsigned char)buffer[position];
+        }
+
+        int get(){
+            int c = peek();
+            if(c != EOF){
+                position++;
+                if(c == '\n') line++;
+            }
+            return c;
+        }
+
+    public:
+        string name;
+
+        Lexer(istream &in, const string &name) : in(in), name(name) {}
+        Lexer(unique_ptr<istream> stream, const string &name) : owned(move(stream)), in(*owned), name(name) {}
+
+        Token next(){
+            while(true){
+                int c = peek();
+                if(c == EOF) return {TokenType::End, "", line};
+                if(isspace(c)){
+                    get();
+                    continue;
+                }
+                if(c == '/'){
+                    get();
+                    if(peek() != '/') return {TokenType::Symbol, "/", line};
+                    while(peek() != EOF && peek() != '\n') get();
+                    continue;
+                }
+                break;
+            }
+
+            Token token{TokenType::Symbol, "", line};
+            int c = get();
+            if(isalpha(c) || c == '_'){
+                token.type = TokenType::Identifier;
+                token.text += (char)c;
+                while(isalnum(peek()) || peek() == '_') token.text += (char)get();
+            }else if(isdigit(c) || (c == '.' && isdigit(peek()))){
+                token.type = TokenType::Integer;
+                token.text += (char)c;
+                while(isdigit(peek()) || peek() == '.'){
+                    if(peek() == '.') token.type = TokenType::Real;
+                    token.text += (char)get();
+                }
+                if(c == '.') token.type = TokenType::Real;
+                if(peek() == 'e' || peek() == 'E'){
+                    token.type = TokenType::Real;
+                    token.text += (char)get();
+                    if(peek() == '+' || peek() == '-') token.text += (char)get();
+                    while(isdigit(peek())) token.text += (char)get();
+                }
+            }else if(c == '"'){
+                token.type = TokenType::String;
+                while(peek() != EOF && peek() != '"') token.text += (char)get();
+                if(get() != '"') throw runtime_error("QASM " + name + ":" + to_string(token.line) + ": unterminated string");
+            }else if(c == '-' && peek() == '>'){
+                get();
+                token.text = "->";
+            }else if(c == '=' && peek() == '='){
+                get();
+                token.text = "==";
+            }else if(string(";,()[]{}+-*/^").find((char)c) != string::npos){
+                token.text = string(1, (char)c);
+            }else{
+                throw runtime_error("QASM " + name + ":" + to_string(token.line) + ": unexpected character '" + string(1, (char)c) + "'");
+            }
+            return token;
+        }
+    };
+
+    struct Register {
+        string name;
+        int offset;
+        int size;
+    };
+
+    //a register or one of its bits
+    struct Operand {
+        int offset;
+        int size;
+        bool whole;
+    };
+
+    struct BodyOp {
+        string name;
+        vector<vector<Token>> params;
+        vector<string> args;
+        int line;
+    };
+
+    struct GateDefinition {
+        vector<string> params;
+        vector<string> args;
+        vector<BodyOp> body;
+        bool opaque = false;
+    };
+
+    using Clock = chrono::steady_clock;
+}
+
+struct QasmReader::State {
+    vector<unique_ptr<Lexer>> lexers;
+    Token lookahead;
+    bool has_lookahead = false;
+
+    vector<Register> qregs;
+    vector<Register> cregs;
+    int qubit_count = 0;
+    map<string, GateDefinition> definitions;
+    bool qelib1_included = false;
+    bool started = false;
+
+    vector<int> clbits;
+    vector<int> pending; //classical bit of the held back measurement per qubit, -1 for none
+    QuantumCircuitBase *circuit = nullptr;
+    Stats *stats = nullptr;
+
+    [[noreturn]] void fail(int line, const string &message){
+        throw runtime_error("QASM " + lexers.back()->name + ":" + to_string(line) + ": " + message);
+    }
+
+    Token fetch(){
+        while(true){
+            Token token = lexers.back()->next();
+            if(token.type == TokenType::End && lexers.size() > 1){
+                lexers.pop_back();
+                continue;
+            }
+            return token;
+        }
+    }
+
+    const Token& peek(){
+        if(!has_lookahead){
+            lookahead = fetch();
+            has_lookahead = true;
+        }
+        return lookahead;
+    }
+
+    Token take(){
+        peek();
+        has_lookahead = false;
+        return lookahead;
+    }
+
+    bool accept(const string &symbol){
+        if(peek().type == TokenType::Symbol && peek().text == symbol){
+            take();
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const string &symbol){
+        Token token = take();
+        if(token.type != TokenType::Symbol || token.text != symbol) fail(token.line, "expected '" + symbol + "' before '" + token.text + "'");
+    }
+
+    Token expectIdentifier(){
+        Token token = take();
+        if(token.type != TokenType::Identifier) fail(token.line, "expected an identifier before '" + token.text + "'");
+        return token;
+    }
+
+    int expectInteger(){
+        Token token = take();
+        if(token.type != TokenType::Integer) fail(token.line, "expected an integer before '" + token.text + "'");
+        try{
+            return stoi(token.text);
+        }catch(const out_of_range &){
+            fail(token.line, "integer " + token.text + " is too large");
+        }
+    }
+
+    //Expressions, recursive descent over the tokens of one parameter
+    struct Expression {
+        State &state;
+        const vector<Token> &tokens;
+        const map<string,double> &bindings;
+        size_t i = 0;
+
+        const Token* current() const { return i < tokens.size() ? &tokens[i] : nullptr; }
+        bool symbol(const string &s) const { return current() && current()->type == TokenType::Symbol && current()->text == s; }
+
+        double sum(){
+            double value = product();
+            while(symbol("+") || symbol("-")){
+                bool plus = tokens[i++].text == "+";
+                double rhs = product();
+                value = plus ? value + rhs : value - rhs;
+            }
+            return value;
+        }
+
+        double product(){
+            double value = unary();
+            while(symbol("*") || symbol("/")){
+                bool times = tokens[i++].text == "*";
+                double rhs = unary();
+                value = times ? value * rhs : value / rhs;
+            }
+            return value;
+        }
+
+        double unary(){
+            if(symbol("-")){
+                i++;
+                return -unary();
+            }
+            if(symbol("+")){
+                i++;
+                return unary();
+            }
+            double base = primary();
+            if(symbol("^")){
+                i++;
+                return pow(base, unary());
+            }
+            return base;
+        }
+
+        double primary(){
+            const Token *token = current();
+            if(!token) state.fail(tokens.empty() ? 0 : tokens.back().line, "incomplete expression");
+            i++;
+            if(token->type == TokenType::Integer || token->type == TokenType::Real){
+                try{
+                    return stod(token->text);
+                }catch(const out_of_range &){
+                    state.fail(token->line, "number " + token->text + " is out of range");
+                }
+            }
+            if(token->type == TokenType::Symbol && token->text == "("){
+                double value = sum();
+                if(!symbol(")")) state.fail(token->line, "expected ')' in expression");
+                i++;
+                return value;
+            }
+            if(token->type == TokenType::Identifier){
+                if(token->text == "pi") return M_PI;
+                auto bound = bindings.find(token->text);
+                if(bound != bindings.end()) return bound->second;
+                static const map<string, double(*)(double)> functions = {
+                    {"sin", [](double x){ return sin(x); }}, {"cos", [](double x){ return cos(x); }},
+                    {"tan", [](double x){ return tan(x); }}, {"exp", [](double x){ return exp(x); }},
+                    {"ln", [](double x){ return log(x); }}, {"sqrt", [](double x){ return sqrt(x); }}
+                };
+                auto function = functions.find(token->text);
+                if(function == functions.end() || !symbol("(")) state.fail(token->line, "unknown parameter '" + token->text + "'");
+                return function->second(primary());
+            }
+            state.fail(token->line, "unexpected '" + token->text + "' in expression");
+        }
+    };
+
+    double evaluate(const vector<Token> &tokens, const map<string,double> &bindings){
+        Expression expression{*this, tokens, bindings};
+        double value = expression.sum();
+        if(expression.current()) fail(expression.current()->line, "unexpected '" + expression.current()->text + "' in expression");
+        return value;
+    }
+
+    //'(' p, p, ... ')' as token lists, nothing when there is no '('
+    vector<vector<Token>> parameterTokens(){
+        vector<vector<Token>> params;
+        if(!accept("(")) return params;
+        if(accept(")")) return params;
+        params.emplace_back();
+        for(int depth = 0;;){
+            Token token = take();
+            if(token.type == TokenType::End) fail(token.line, "unterminated parameter list");
+            if(token.type == TokenType::Symbol){
+                if(token.text == "(") depth++;
+                else if(token.text == ")" && depth-- == 0) break;
+                else if(token.text == "," && depth == 0){
+                    params.emplace_back();
+                    continue;
+                }
+            }
+            params.back().push_back(token);
+        }
+        return params;
+    }
+
+    const Register* findRegister(const vector<Register> &registers, const string &name){
+        for(const Register &r: registers) if(r.name == name) return &r;
+        return nullptr;
+    }
+
+    Operand operand(const vector<Register> &registers, const char *kind){
+        Token name = expectIdentifier();
+        const Register *r = findRegister(registers, name.text);
+        if(!r) fail(name.line, string("unknown ") + kind + " '" + name.text + "'");
+        if(!accept("[")) return {r->offset, r->size, true};
+        int index = expectInteger();
+        expect("]");
+        if(index < 0 || index >= r->size) fail(name.line, name.text + "[" + to_string(index) + "] is out of range");
+        return {r->offset + index, 1, false};
+    }
+
+    //common width of the whole registers of a broadcast statement
+    int broadcastWidth(const vector<Operand> &operands, int line){
+        int width = 1;
+        bool seen = false;
+        for(const Operand &op: operands){
+            if(!op.whole) continue;
+            if(seen && op.size != width) fail(line, "registers of different sizes");
+            width = op.size;
+            seen = true;
+        }
+        return width;
+    }
+
+    //performs the held back measurement of qubit
+    void resolveQubit(int qubit, int line){
+        if(pending[qubit] < 0) return;
+        auto begin = Clock::now();
+        try{
+            clbits[pending[qubit]] = circuit->measure_single_qubit(qubit);
+        }catch(const exception &e){
+            fail(line, e.what());
+        }
+        stats->simulate_seconds += chrono::duration<double>(Clock::now() - begin).count();
+        pending[qubit] = -1;
+    }
+
+    void resolveClbit(int clbit, int line){
+        for(int q=0; q<qubit_count; q++) if(pending[q] == clbit) resolveQubit(q, line);
+    }
+
+    void callGate(const string &name, const vector<double> &params, const vector<int> &qubits, int line){
+        auto native = nativeGates().find(name);
+        if(native != nativeGates().end()){
+            if(!native->second.apply) return;
+            auto begin = Clock::now();
+            try{
+                native->second.apply(*circuit, params.data(), qubits.data());
+            }catch(const exception &e){
+                fail(line, e.what());
+            }
+            stats->simulate_seconds += chrono::duration<double>(Clock::now() - begin).count();
+            stats->gates++;
+            return;
+        }
+
+        const GateDefinition &definition = definitions.at(name);
+        if(definition.opaque) fail(line, "opaque gate '" + name + "' has no definition");
+        map<string,double> bindings;
+        for(size_t k=0; k<params.size(); k++) bindings[definition.params[k]] = params[k];
+        map<string,int> args;
+        for(size_t k=0; k<qubits.size(); k++) args[definition.args[k]] = qubits[k];
+        for(const BodyOp &op: definition.body){
+            vector<double> values;
+            for(const auto &tokens: op.params) values.push_back(evaluate(tokens, bindings));
+            vector<int> operands;
+            for(const string &arg: op.args) operands.push_back(args.at(arg));
+            callGate(op.name, values, operands, line);
+        }
+    }
+
+    //operand and parameter counts of a known gate
+    void checkGate(const Token &name, size_t params, size_t qubits){
+        auto native = nativeGates().find(name.text);
+        auto defined = definitions.find(name.text);
+        if(native == nativeGates().end() && defined == definitions.end()) fail(name.line, "unknown gate '" + name.text + "'");
+        size_t want_params = native != nativeGates().end() ? native->second.params : defined->second.params.size();
+        size_t want_qubits = native != nativeGates().end() ? native->second.qubits : defined->second.args.size();
+        if(params != want_params) fail(name.line, "'" + name.text + "' takes " + to_string(want_params) + " parameters");
+        if(qubits != want_qubits) fail(name.line, "'" + name.text + "' acts on " + to_string(want_qubits) + " qubits");
+    }
+
+    void include(const Token &file){
+        if(file.text == "qelib1.inc"){
+            if(qelib1_included) return;
+            qelib1_included = true;
+            lexers.push_back(make_unique<Lexer>(make_unique<istringstream>(QELIB1_DEFINITIONS), "qelib1.inc"));
+            return;
+        }
+        auto stream = make_unique<ifstream>(file.text);
+        if(!stream->is_open()) fail(file.line, "cannot open include file " + file.text);
+        lexers.push_back(make_unique<Lexer>(move(stream), file.text));
+    }
+
+    void registerDeclaration(bool quantum){
+        Token name = expectIdentifier();
+        expect("[");
+        int size = expectInteger();
+        expect("]");
+        expect(";");
+        if(size <= 0) fail(name.line, "register '" + name.text + "' needs at least one bit");
+        if(findRegister(qregs, name.text) || findRegister(cregs, name.text)) fail(name.line, "register '" + name.text + "' is already declared");
+        if(quantum){
+            if(started) fail(name.line, "qreg declared after the first operation, the circuit size is already fixed");
+            qregs.push_back({name.text, qubit_count, size});
+            qubit_count += size;
+        }else{
+            cregs.push_back({name.text, (int)clbits.size(), size});
+            clbits.resize(clbits.size() + size, 0);
+        }
+    }
+
+    void gateDefinition(bool opaque){
+        Token name = expectIdentifier();
+        GateDefinition definition;
+        definition.opaque = opaque;
+        for(const auto &tokens: parameterTokens()){
+            if(tokens.size() != 1 || tokens[0].type != TokenType::Identifier) fail(name.line, "gate parameters must be identifiers");
+            definition.params.push_back(tokens[0].text);
+        }
+        do definition.args.push_back(expectIdentifier().text); while(accept(","));
+        if(opaque){
+            expect(";");
+            definitions[name.text] = move(definition);
+            return;
+        }
+
+        expect("{");
+        while(!accept("}")){
+            Token op = expectIdentifier();
+            BodyOp body{op.text, {}, {}, op.line};
+            if(op.text != "barrier") body.params = parameterTokens();
+            do{
+                Token arg = expectIdentifier();
+                if(find(definition.args.begin(), definition.args.end(), arg.text) == definition.args.end()) fail(arg.line, "'" + arg.text + "' is not an argument of '" + name.text + "'");
+                body.args.push_back(arg.text);
+            }while(accept(","));
+            expect(";");
+            if(op.text == "barrier") continue;
+            checkGate(op, body.params.size(), body.args.size());
+            //parameters are checked now, evaluate() only sees the bound names later
+            map<string,double> probe;
+            for(const string &p: definition.params) probe[p] = 0.0;
+            for(const auto &tokens: body.params) evaluate(tokens, probe);
+            definition.body.push_back(move(body));
+        }
+        //gates of qelib1 with a backend method keep it
+        if(nativeGates().count(name.text)) return;
+        definitions[name.text] = move(definition);
+    }
+
+    //gate call, measure or reset, skipped when apply is false
+    void operation(const Token &first, bool apply){
+        if(first.text == "measure"){
+            Operand qubit = operand(qregs, "qreg");
+            expect("->");
+            Operand clbit = operand(cregs, "creg");
+            expect(";");
+            if(qubit.whole != clbit.whole || qubit.size != clbit.size) fail(first.line, "measure needs operands of the same size");
+            if(!apply) return;
+            for(int i=0; i<qubit.size; i++){
+                resolveQubit(qubit.offset + i, first.line);
+                resolveClbit(clbit.offset + i, first.line);
+                pending[qubit.offset + i] = clbit.offset + i;
+                stats->measurements++;
+            }
+            return;
+        }
+        if(first.text == "reset"){
+            Operand qubit = operand(qregs, "qreg");
+            expect(";");
+            if(!apply) return;
+            for(int i=0; i<qubit.size; i++){
+                resolveQubit(qubit.offset + i, first.line);
+                auto begin = Clock::now();
+                circuit->reset(qubit.offset + i);
+                stats->simulate_seconds += chrono::duration<double>(Clock::now() - begin).count();
+            }
+            return;
+        }
+
+        vector<double> params;
+        for(const auto &tokens: parameterTokens()) params.push_back(evaluate(tokens, {}));
+        vector<Operand> operands;
+        do operands.push_back(operand(qregs, "qreg")); while(accept(","));
+        expect(";");
+        checkGate(first, params.size(), operands.size());
+        if(!apply) return;
+        int width = broadcastWidth(operands, first.line);
+        vector<int> qubits(operands.size());
+        for(int i=0; i<width; i++){
+            for(size_t k=0; k<operands.size(); k++){
+                qubits[k] = operands[k].whole ? operands[k].offset + i : operands[k].offset;
+                resolveQubit(qubits[k], first.line);
+            }
+            callGate(first.text, params, qubits, first.line);
+        }
+    }
+
+    bool isDeclaration(const Token &token) const {
+        static const vector<string> keywords = {"OPENQASM", "include", "qreg", "creg", "gate", "opaque"};
+        return token.type == TokenType::Identifier && find(keywords.begin(), keywords.end(), token.text) != keywords.end();
+    }
+
+    //one statement, false at the end of the input
+    bool statement(){
+        Token first = take();
+        if(first.type == TokenType::End) return false;
+        if(first.type != TokenType::Identifier) fail(first.line, "unexpected '" + first.text + "'");
+        stats->statements++;
+
+        if(first.text == "OPENQASM"){
+            Token version = take();
+            if(version.text != "2.0" && version.text != "2") fail(first.line, "only OpenQASM 2.0 is supported");
+            expect(";");
+        }else if(first.text == "include"){
+            Token file = take();
+            if(file.type != TokenType::String) fail(file.line, "expected a file name");
+            expect(";");
+            include(file);
+        }else if(first.text == "qreg" || first.text == "creg"){
+            registerDeclaration(first.text == "qreg");
+        }else if(first.text == "gate" || first.text == "opaque"){
+            gateDefinition(first.text == "opaque");
+        }else{
+            started = true;
+            if(!circuit) fail(first.line, "operation before the circuit was attached");
+            if(first.text == "barrier"){
+                do operand(qregs, "qreg"); while(accept(","));
+                expect(";");
+            }else if(first.text == "if"){
+                expect("(");
+                Token name = expectIdentifier();
+                const Register *r = findRegister(cregs, name.text);
+                if(!r) fail(name.line, "unknown creg '" + name.text + "'");
+                //the register is read into a long long below
+                if(r->size > 63) fail(name.line, "if() only compares cregs of up to 63 bits");
+                expect("==");
+                long long value = expectInteger();
+                expect(")");
+                long long current = 0;
+                for(int i=0; i<r->size; i++){
+                    resolveClbit(r->offset + i, first.line);
+                    current |= (long long)clbits[r->offset + i] << i;
+                }
+                operation(expectIdentifier(), current == value);
+            }else{
+                operation(first, true);
+            }
+        }
+        return true;
+    }
+};
+
+QasmReader::QasmReader(istream &in) : state(make_unique<State>()) {
+    state->lexers.push_back(make_unique<Lexer>(in, "input"));
+    state->stats = &run_stats;
+}
+
+QasmReader::~QasmReader() = default;
+
+int QasmReader::qubitCount(){
+    auto begin = Clock::now();
+    while(!state->started && state->isDeclaration(state->peek())) state->statement();
+    run_stats.parse_seconds += chrono::duration<double>(Clock::now() - begin).count();
+    return state->qubit_count;
+}
+
+void QasmReader::run(QuantumCircuitBase &circuit){
+    int n = qubitCount();
+    if(n == 0) throw runtime_error("QASM input declares no qreg");
+    if(circuit.getQubitCount() != n) throw invalid_argument("The circuit has " + to_string(circuit.getQubitCount()) + " qubits, the program declares " + to_string(n) + ".");
+    state->circuit = &circuit;
+    state->pending.assign(n, -1);
+
+    auto begin = Clock::now();
+    double simulated = run_stats.simulate_seconds;
+    while(state->statement());
+    auto flushed = Clock::now();
+    circuit.flush();
+    run_stats.simulate_seconds += chrono::duration<double>(Clock::now() - flushed).count();
+    run_stats.parse_seconds += chrono::duration<double>(Clock::now() - begin).count() - (run_stats.simulate_seconds - simulated);
+}
+
+vector<pair<int,int>> QasmReader::finalMeasurements() const {
+    vector<pair<int,int>> measurements;
+    for(size_t q=0; q<state->pending.size(); q++) if(state->pending[q] >= 0) measurements.push_back({(int)q, state->pending[q]});
+    return measurements;
+}
+
+void QasmReader::measureFinal(QuantumCircuitBase &circuit){
+    for(auto &m: finalMeasurements()){
+        state->clbits[m.second] = circuit.measure_single_qubit(m.first);
+        state->pending[m.first] = -1;
+    }
+}
+
+namespace {
+    string formatBits(const vector<Register> &cregs, const vector<int> &bits){
+        string text;
+        for(auto r = cregs.rbegin(); r != cregs.rend(); ++r){
+            if(!text.empty()) text += ' ';
+            for(int i=r->size-1; i>=0; i--) text += bits[r->offset + i] ? '1' : '0';
+        }
+        return text;
+    }
+}
+
+string QasmReader::classicalBits() const {
+    return formatBits(state->cregs, state->clbits);
+}
+
+map<string,int> QasmReader::sampleFinal(QuantumCircuitBase &circuit, int shots, uint64_t seed){
+    if(shots < 0) throw invalid_argument("Number of shots cannot be negative.");
+    map<string,int> counts;
+    if(shots == 0) return counts;
+    vector<pair<int,int>> measurements = finalMeasurements();
+    if(measurements.empty()){
+        counts[classicalBits()] = shots;
+        return counts;
+    }
+
+    vector<int> qubits;
+    for(auto &m: measurements) qubits.push_back(m.first);
+    vector<double> cdf = circuit.marginalProbabilities(qubits);
+    for(size_t i=1; i<cdf.size(); i++) cdf[i] += cdf[i-1];
+    mt19937_64 gen(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    map<size_t,int> outcomes;
+    for(int shot=0; shot<shots; shot++){
+        size_t outcome = upper_bound(cdf.begin(), cdf.end(), uniform(gen) * cdf.back()) - cdf.begin();
+        outcomes[min(outcome, cdf.size()-1)]++;
+    }
+
+    vector<int> bits = state->clbits;
+    for(auto &outcome: outcomes){
+        for(size_t j=0; j<measurements.size(); j++) bits[measurements[j].second] = (outcome.first >> j) & 1;
+        counts[formatBits(state->cregs, bits)] += outcome.second;
+    }
+    return counts;
+}
@@ -0,0 +1,238 @@
+#include <MaQrel/QuantumSnapshot.h>
+#include <stdexcept>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+namespace QuantumSnapshot {
+
+    //size of each sequential write
+    constexpr size_t WRITE_CHUNK_BYTES = 64ULL << 20;
+
+    namespace {
+
+        class OutputFile {
+        #ifdef _WIN32
+            ofstream out;
+        #else
+            int fd;
+        #endif
+        public:
+            explicit OutputFile(const string &path){
+            #ifdef _WIN32
+                out.open(path, ios::binary | ios::trunc);
+                if(!out.is_open()) throw runtime_error("Could not open snapshot file " + path);
+            #else
+                fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if(fd < 0) throw runtime_error("Could not open snapshot file " + path);
+            #endif
+            }
+            ~OutputFile(){
+            #ifndef _WIN32
+                close(fd);
+            #endif
+            }
+            void writeAll(const void *buffer, size_t bytes){
+            #ifdef _WIN32
+                out.write(static_cast<const char*>(buffer), bytes);
+                if(!out) throw runtime_error("Failed writing snapshot");
+            #else
+                const char *ptr = static_cast<const char*>(buffer);
+                while(bytes > 0){
+                    ssize_t written = ::write(fd, ptr, min(bytes, WRITE_CHUNK_BYTES));
+                    if(written < 0) throw runtime_error("Failed writing snapshot");
+                    ptr += written;
+                    bytes -= written;
+                }
+            #endif
+            }
+        };
+    }
+
+    vector<unsigned char> encodeHeader(int qubit_count, const vector<int> &qubit_map, Precision precision){
+        Header header = {};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.qubit_count = qubit_count;
+        header.precision = static_cast<uint32_t>(precision);
+        header.amplitude_count = 1ULL<<qubit_count;
+        size_t prefix = sizeof(Header) + qubit_count*sizeof(int32_t);
+        header.amplitude_offset = (prefix + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT * PAGE_ALIGNMENT;
+
+        vector<unsigned char> head(header.amplitude_offset, 0);
+        memcpy(head.data(), &header, sizeof(Header));
+        for(int q=0; q<qubit_count; q++){
+            int32_t entry = qubit_map[q];
+            memcpy(head.data() + sizeof(Header) + q*sizeof(int32_t), &entry, sizeof(int32_t));
+        }
+        return head;
+    }
+
+    void write(const string &path, const vector<complex<double>> &state_vector, int qubit_count, Precision precision){
+        vector<int> identity(qubit_count);
+        for(int q=0; q<qubit_count; q++) identity[q] = q;
+        write(path, state_vector, qubit_count, identity, precision);
+    }
+
+    void write(const string &path, const vector<complex<double>> &state_vector, int qubit_count,
+               const vector<int> &qubit_map, Precision precision){
+        if((int)qubit_map.size() != qubit_count) throw invalid_argument("Qubit map must have one entry per qubit.");
+        if(state_vector.size() != (1ULL<<qubit_count)) throw invalid_argument("State vector size != 2^qubit_count");
+
+        vector<unsigned char> head = encodeHeader(qubit_count, qubit_map, precision);
+
+        OutputFile file(path);
+        file.writeAll(head.data(), head.size());
+
+        if(precision == Precision::Double){
+            file.writeAll(state_vector.data(), state_vector.size()*sizeof(complex<double>));
+            return;
+        }
+
+        //narrow through a staging buffer so the writes stay large
+        size_t per_chunk = WRITE_CHUNK_BYTES / sizeof(complex<float>);
+        vector<complex<float>> staging(min(per_chunk, state_vector.size()));
+        for(size_t start=0; start<state_vector.size(); start+=per_chunk){
+            size_t count = min(per_chunk, state_vector.size()-start);
+            for(size_t i=0; i<count; i++) staging[i] = complex<float>(state_vector[start+i]);
+            file.writeAll(staging.data(), count*sizeof(complex<float>));
+        }
+    }
+
+    MappedSnapshot::MappedSnapshot(const string &path){
+    #ifdef _WIN32
+        ifstream in(path, ios::binary | ios::ate);
+        if(!in.is_open()) throw runtime_error("Could not open snapshot file " + path);
+        fallback.resize(in.tellg());
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(fallback.data()), fallback.size());
+        data = fallback.data();
+        length = fallback.size();
+    #else
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw runtime_error("Could not open snapshot file " + path);
+        struct stat info;
+        if(fstat(fd, &info) != 0){
+            close(fd);
+            throw runtime_error("Could not stat snapshot file " + path);
+        }
+        length = info.st_size;
+        void *mapped = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if(mapped == MAP_FAILED) throw runtime_error("Could not map snapshot file " + path);
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        data = static_cast<const unsigned char*>(mapped);
+    #endif
+
+        //the destructor does not run when the constructor throws
+        try{
+            readHeader();
+        }catch(...){
+        #ifndef _WIN32
+            munmap(const_cast<unsigned char*>(data), length);
+        #endif
+            throw;
+        }
+    }
+
+    void MappedSnapshot::readHeader(){
+        if(length < sizeof(Header)) throw runtime_error("Snapshot file is truncated.");
+        memcpy(&header, data, sizeof(Header));
+        if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw runtime_error("Not a MaQrel snapshot file.");
+        if(header.version != VERSION) throw runtime_error("Unsupported snapshot version " + to_string(header.version));
+        if(header.precision != static_cast<uint32_t>(Precision::Single) && header.precision != static_cast<uint32_t>(Precision::Double))
+            throw runtime_error("Unsupported snapshot precision.");
+        if(header.qubit_count == 0 || header.qubit_count >= 64 || header.amplitude_count != (1ULL<<header.qubit_count))
+            throw runtime_error("Snapshot header is inconsistent.");
+        //divided rather than multiplied, so a crafted header cannot wrap around
+        if(header.amplitude_offset < sizeof(Header) + header.qubit_count*sizeof(int32_t) || header.amplitude_offset > length ||
+           header.amplitude_count > (length - header.amplitude_offset) / (2*header.precision))
+            throw runtime_error("Snapshot file is truncated.");
+
+        qubit_map.resize(header.qubit_count);
+        for(size_t q=0; q<qubit_map.size(); q++){
+            int32_t entry;
+            memcpy(&entry, data + sizeof(Header) + q*sizeof(int32_t), sizeof(int32_t));
+            qubit_map[q] = entry;
+        }
+        vector<int> sorted = qubit_map;
+        sort(sorted.begin(), sorted.end());
+        for(size_t q=0; q<sorted.size(); q++){
+            if(sorted[q] != (int)q) throw runtime_error("Snapshot qubit map is not a permutation.");
+        }
+    }
+
+    MappedSnapshot::~MappedSnapshot(){
+    #ifndef _WIN32
+        if(data) munmap(const_cast<unsigned char*>(data), length);
+    #endif
+    }
+
+    bool MappedSnapshot::hasIdentityMap() const {
+        for(size_t q=0; q<qubit_map.size(); q++){
+            if(qubit_map[q] != (int)q) return false;
+        }
+        return true;
+    }
+
+    const complex<double>* MappedSnapshot::amplitudes() const {
+        if(precision() != Precision::Double) throw logic_error("Only double precision snapshots can be viewed without conversion.");
+        return reinterpret_cast<const complex<double>*>(data + header.amplitude_offset);
+    }
+
+    void MappedSnapshot::copyRange(size_t first, size_t count, complex<double> *out) const {
+        if(!hasIdentityMap()) throw logic_error("Ranges can only be copied from snapshots with an identity qubit map.");
+        if(first > header.amplitude_count || count > header.amplitude_count - first) throw out_of_range("Amplitude range is out of range.");
+        const unsigned char *raw = data + header.amplitude_offset;
+        if(precision() == Precision::Double){
+            memcpy(out, reinterpret_cast<const complex<double>*>(raw) + first, count*sizeof(complex<double>));
+        }else{
+            const complex<float> *source = reinterpret_cast<const complex<float>*>(raw) + first;
+            for(size_t i=0; i<count; i++) out[i] = complex<double>(source[i]);
+        }
+    }
+
+    void MappedSnapshot::copyTo(vector<complex<double>> &state_vector) const {
+        size_t count = header.amplitude_count;
+        state_vector.resize(count);
+        const unsigned char *raw = data + header.amplitude_offset;
+        bool identity = hasIdentityMap();
+
+        //stored bit k -> logical bit qubit_map[k]
+        auto logical = [&](size_t stored){
+            size_t index = 0;
+            for(size_t k=0; k<qubit_map.size(); k++){
+                if((stored>>k) & 1) index |= 1ULL<<qubit_map[k];
+            }
+            return index;
+        };
+
+        if(precision() == Precision::Double){
+            const complex<double> *source = reinterpret_cast<const complex<double>*>(raw);
+            if(identity){
+                //touching the pages from every thread keeps several reads in flight
+                const size_t block = 1ULL<<16;
+                #pragma omp parallel for schedule(static)
+                for(size_t start=0; start<count; start+=block){
+                    memcpy(state_vector.data()+start, source+start, min(block, count-start)*sizeof(complex<double>));
+                }
+            }else{
+                #pragma omp parallel for schedule(static)
+                for(size_t i=0; i<count; i++) state_vector[logical(i)] = source[i];
+            }
+        }else{
+            const complex<float> *source = reinterpret_cast<const complex<float>*>(raw);
+            #pragma omp parallel for schedule(static)
+            for(size_t i=0; i<count; i++){
+                state_vector[identity ? i : logical(i)] = complex<double>(source[i]);
+            }
+        }
+    }
+}
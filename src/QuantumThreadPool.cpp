@@ -0,0 +1,146 @@
+#include <omp.h>
+#include <memory>
+#include <stdexcept>
+#include <MaQrel/QuantumThreadPool.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+using namespace std;
+
+namespace {
+
+    //set on pool workers and on callers inside a loop, nested loops run inline
+    thread_local bool inside_pool = false;
+
+    inline void cpuRelax(){
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+    #endif
+    }
+
+    mutex shared_lock;
+    QuantumThreadPool::Options shared_options;
+    unique_ptr<QuantumThreadPool> shared_pool;
+}
+
+QuantumThreadPool::QuantumThreadPool(const Options &options) :
+    participants(options.threads > 0 ? options.threads : omp_get_max_threads()),
+    spin_iterations(options.spin_iterations),
+    shares(participants)
+{
+    for(int id=1; id<participants; id++){
+        int cpu = options.cpus.empty() ? -1 : options.cpus[id % options.cpus.size()];
+        workers.emplace_back([this, id, cpu]{ workerLoop(id, cpu); });
+    }
+}
+
+QuantumThreadPool::~QuantumThreadPool(){
+    {
+        lock_guard<mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto &worker: workers) worker.join();
+}
+
+QuantumThreadPool& QuantumThreadPool::shared(){
+    lock_guard<mutex> guard(shared_lock);
+    if(!shared_pool) shared_pool = make_unique<QuantumThreadPool>(shared_options);
+    return *shared_pool;
+}
+
+void QuantumThreadPool::configureShared(const Options &options){
+    lock_guard<mutex> guard(shared_lock);
+    if(shared_pool) throw logic_error("The shared thread pool is already running.");
+    shared_options = options;
+}
+
+void QuantumThreadPool::parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)> &body){
+    if(count == 0) return;
+    grain = max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if(chunks == 1 || participants == 1 || inside_pool){
+        body(0, count);
+        return;
+    }
+
+    lock_guard<mutex> dispatch(dispatch_lock);
+    this->body = &body;
+    this->count = count;
+    this->grain = grain;
+    error = nullptr;
+    for(int id=0; id<participants; id++){
+        shares[id].next.store(chunks * id / participants, memory_order_relaxed);
+        shares[id].end = chunks * (id+1) / participants;
+    }
+    active.store(participants, memory_order_relaxed);
+    //publishes the loop to the spinning workers
+    epoch.fetch_add(1, memory_order_seq_cst);
+    if(sleepers.load(memory_order_seq_cst) > 0){
+        lock_guard<mutex> guard(sleep_lock);
+        wake.notify_all();
+    }
+
+    inside_pool = true;
+    participate(0);
+    inside_pool = false;
+    //a preempted worker may still hold chunks, stop burning its core after a while
+    for(size_t spins=0; active.load(memory_order_acquire) > 0; spins++){
+        if(spins < spin_iterations) cpuRelax();
+        else this_thread::yield();
+    }
+
+    this->body = nullptr;
+    if(error) rethrow_exception(error);
+}
+
+void QuantumThreadPool::participate(int id){
+    auto drain = [&](Share &share){
+        while(true){
+            size_t chunk = share.next.fetch_add(1, memory_order_relaxed);
+            if(chunk >= share.end) return;
+            size_t begin = chunk * grain;
+            try{
+                (*body)(begin, min(count, begin + grain));
+            }catch(...){
+                lock_guard<mutex> guard(error_lock);
+                if(!error) error = current_exception();
+            }
+        }
+    };
+    drain(shares[id]);
+    for(int step=1; step<participants; step++) drain(shares[(id + step) % participants]);
+    active.fetch_sub(1, memory_order_release);
+}
+
+void QuantumThreadPool::workerLoop(int id, int cpu){
+#ifdef __linux__
+    if(cpu >= 0){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)cpu;
+#endif
+    inside_pool = true;
+    size_t seen = 0;
+    while(true){
+        size_t spins = 0;
+        while(epoch.load(memory_order_acquire) == seen && !stopping.load(memory_order_relaxed) && spins < spin_iterations){
+            cpuRelax();
+            spins++;
+        }
+        if(epoch.load(memory_order_acquire) == seen){
+            unique_lock<mutex> guard(sleep_lock);
+            sleepers.fetch_add(1, memory_order_seq_cst);
+            wake.wait(guard, [&]{ return epoch.load(memory_order_seq_cst) != seen || stopping.load(); });
+            sleepers.fetch_sub(1, memory_order_relaxed);
+        }
+        if(epoch.load(memory_order_acquire) == seen && stopping.load()) return;
+        seen = epoch.load(memory_order_acquire);
+        participate(id);
+    }
+}
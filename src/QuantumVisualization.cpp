@@ -3,9 +3,63 @@
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <algorithm>
+#include <queue>
 
 namespace QuantumVisualization{
 
+    std::vector<std::pair<size_t,double>> topK(const std::vector<std::complex<double>>& state_vector, size_t k, double min_probability){
+        //most likely first, the lower index first on ties
+        auto more_likely = [](const std::pair<size_t,double> &a, const std::pair<size_t,double> &b){
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        };
+        std::vector<std::pair<size_t,double>> selected;
+        if(k == 0) return selected;
+
+        #pragma omp parallel
+        {
+            //min-heap on likelihood, the top is the first one to drop
+            std::priority_queue<std::pair<size_t,double>, std::vector<std::pair<size_t,double>>, decltype(more_likely)> heap(more_likely);
+            #pragma omp for nowait
+            for(size_t i=0; i<state_vector.size(); i++){
+                double prob = norm(state_vector[i]);
+                if(prob < min_probability) continue;
+                if(heap.size() < k) heap.push({i, prob});
+                else if(more_likely({i, prob}, heap.top())){
+                    heap.pop();
+                    heap.push({i, prob});
+                }
+            }
+            #pragma omp critical
+            while(!heap.empty()){
+                selected.push_back(heap.top());
+                heap.pop();
+            }
+        }
+
+        size_t count = std::min(k, selected.size());
+        std::partial_sort(selected.begin(), selected.begin()+count, selected.end(), more_likely);
+        selected.resize(count);
+        return selected;
+    }
+
+    std::vector<double> probabilityHistogram(const std::vector<std::complex<double>>& state_vector, int bins_log2){
+        int n = __builtin_ctzll(state_vector.size());
+        bins_log2 = std::max(0, std::min(bins_log2, n));
+        int shift = n - bins_log2;
+        std::vector<double> hist(1ULL<<bins_log2, 0.0);
+
+        #pragma omp parallel
+        {
+            std::vector<double> local(hist.size(), 0.0);
+            #pragma omp for nowait
+            for(size_t i=0; i<state_vector.size(); i++) local[i>>shift] += norm(state_vector[i]);
+            #pragma omp critical
+            for(size_t b=0; b<hist.size(); b++) hist[b] += local[b];
+        }
+        return hist;
+    }
+
     std::vector<std::string> generateBasisStates(int n){
         std::vector<std::string> basis_states;
         size_t num_states = 1<<n;
@@ -18,11 +72,18 @@ namespace QuantumVisualization{
         }
         return basis_states;
     }
+    std::string basisString(size_t index, int qubit_count){
+        std::string basis(qubit_count, '0');
+        for(int i=0; i<qubit_count; i++){
+            if((index>>i) & 1) basis[qubit_count-1-i] = '1';
+        }
+        return basis;
+    }
+
     void printState(const std::vector<std::complex<double>>& state_vector, int qubit_count){
         std::cout << "Current State Vector" << "\n";
-        std::vector<std::string>basis_states = generateBasisStates(qubit_count);
         for(size_t i=0; i<state_vector.size(); i++){
-            std::cout << "|" << basis_states[i] << "> :" << state_vector[i] << "\n";
+            std::cout << "|" << basisString(i, qubit_count) << "> :" << state_vector[i] << "\n";
         }
     }
 
@@ -35,14 +96,15 @@ namespace QuantumVisualization{
     }
 
     void printProbabilities(const std::vector<std::complex<double>>& state_vector, int qubit_count){
-        std::vector<std::string> basis_states = generateBasisStates(qubit_count);
+        std::vector<std::pair<size_t,double>> top = topK(state_vector, MAX_LISTED_STATES, PROB_THRESHOLD);
+        std::sort(top.begin(), top.end());
 
         std::cout << std::fixed << std::setprecision(6);
         std::cout << qubit_count << "-Qubit Measurement Results" << "\n";
-        for(size_t i = 0; i<state_vector.size(); ++i) {
-            double prob = norm(state_vector[i]);
-            if(prob >= PROB_THRESHOLD) std::cout << "Probability of |" << basis_states[i] << ">: " << prob << "\n";
+        for(auto &state: top) {
+            std::cout << "Probability of |" << basisString(state.first, qubit_count) << ">: " << state.second << "\n";
         }
+        if(top.size() == MAX_LISTED_STATES) std::cout << "(only the " << MAX_LISTED_STATES << " most likely states are listed)\n";
         std::cout << "----------------------------\n";
         // displayGraph();
     }
@@ -55,13 +117,11 @@ namespace QuantumVisualization{
             return;
         }
 
-        std::vector<std::string> basis_states = generateBasisStates(qubit_count);
-        for (size_t i = 0; i < state_vector.size(); ++i) {
+        std::vector<std::pair<size_t,double>> top = topK(state_vector, MAX_LISTED_STATES, PROB_THRESHOLD);
+        std::sort(top.begin(), top.end());
+        for (auto &state: top) {
             // Gnuplot format: "Label" Value
-            double prob = norm(state_vector[i]);
-            if(prob>=PROB_THRESHOLD){
-                dataFile << "\"" << basis_states[i] << "\" " << prob << "\n";
-            }
+            dataFile << "\"" << basisString(state.first, qubit_count) << "\" " << state.second << "\n";
         }
         dataFile.close();
 
@@ -95,17 +155,20 @@ namespace QuantumVisualization{
     void displayHeatMap(const std::vector<std::complex<double>>& state_vector, int qubit_count){
         std::ofstream dataFile("prob_data.dat");
 
-        int grid_size = 1 << (qubit_count/2);
+        //large states are grouped by their top qubits, the rows take the extra bit when odd
+        int cell_bits = std::min(qubit_count, MAX_HEATMAP_QUBITS);
+        std::vector<double> cells = probabilityHistogram(state_vector, cell_bits);
+        size_t rows = 1ULL << ((cell_bits+1)/2);
+        size_t cols = 1ULL << (cell_bits/2);
 
         if (!dataFile.is_open()) {
             std::cerr << "Error: Could not open data file for gnuplot." << std::endl;
             return;
         }
 
-        for(int row=0; row<grid_size; ++row){
-            for(int col=0; col < grid_size; ++col){
-                size_t index = row * grid_size + col;
-                dataFile << norm(state_vector[index]) << " ";
+        for(size_t row=0; row<rows; ++row){
+            for(size_t col=0; col < cols; ++col){
+                dataFile << cells[row * cols + col] << " ";
             }
             dataFile << "\n"; 
         }